@@ -80,7 +80,9 @@ if __name__ == "__main__":
     con = sqlite3.connect('Crypto.db')
     nameQuery = "SELECT * FROM Currencies;"
     configQuery = "SELECT CurrencyID,minimumData,timeWindow FROM Configs WHERE CurrencyID = "
-    priceQuery = "SELECT * FROM Prices;"
+    # Prices older than the raw horizon only remain as the closes of the minute rollups (rollup.cpp)
+    priceQuery = "SELECT CurrencyID,time,datetime(time,'unixepoch','localtime') AS date,price FROM (SELECT CurrencyID,bucket AS time,close AS price FROM PricesMinute " \
+                 "WHERE bucket < (SELECT CAST(value AS REAL) FROM Settings WHERE name = 'compactedUntil') UNION ALL SELECT CurrencyID,time,price FROM Prices) ORDER BY CurrencyID,time;"
     thresholdQuery = "SELECT gain,longGain,movingAvg,anomaly FROM Configs WHERE CurrencyID = "
 
     names = pd.read_sql(nameQuery,con)
@@ -6,6 +6,9 @@
     Description:  This script controls the program's GUI. Its tasks are to show the current currencies
                   being followed, add or delete them, and change every configuration in the program like the thresholds.
                   Clearly, user inputs are checked. Empty inputs leave configs as they are.
+                  While the C++ core runs, changes are sent to it through the socket in CRYPTO_SOCKET (ipc.cpp),
+                  which saves and applies them right away and pushes every new price back. Without it the
+                  database is used directly.
                   
     Version:  1.0 Changes:
     Created:  01/28/2025
@@ -19,13 +22,155 @@
 import tkinter as tk
 import pandas as pd
 import sqlite3
+import socket
+import select
+import json
+import time
+import os
 
 widgets = []
+core = None        # connection to the C++ core, None while it can't be reached
+received = b""     # incomplete line sent by the core
+live = {}          # Currencies.ID -> currency with its last price, kept up to date by the core
+showing = False    # the currencies are on screen and follow the prices
+ticks = 0
+
+def connect():
+    '''
+    Connect to the socket of the core and ask for the currencies being followed.
+    '''
+    global core, received
+    path = os.environ.get("CRYPTO_SOCKET", "")
+    if path == "":
+        return
+    try:
+        core = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        core.connect(path)
+        core.setblocking(False)
+    except OSError:
+        core = None
+        return
+    received = b""
+    snapshot()
+
+def snapshot():
+    '''
+    Ask the core again for the currencies, after one was added or deleted.
+    '''
+    live.clear()
+    send(["snapshot"])
+
+def send(fields):
+    '''
+    Send one command, its fields separated by tabs. Returns False if the core can't be reached anymore.
+    '''
+    global core
+    try:
+        core.setblocking(True)
+        core.sendall(("\t".join(fields) + "\n").encode())
+        core.setblocking(False)
+    except (OSError, AttributeError):
+        core = None
+        return False
+    return True
+
+def receive():
+    '''
+    Read what the core sent so far. Prices and currencies update live, the replies to commands are returned.
+    '''
+    global core, received
+    replies = []
+    while core is not None:
+        try:
+            chunk = core.recv(65536)
+        except BlockingIOError:
+            break
+        except OSError:
+            chunk = b""
+        if chunk == b"":
+            core.close()
+            core = None
+            break
+        received += chunk
+    lines = received.split(b"\n")
+    received = lines.pop()
+    for line in lines:
+        message = json.loads(line)
+        if message["type"] == "currency":
+            live[message["id"]] = message
+        elif message["type"] == "price":
+            if message["id"] in live:
+                live[message["id"]].update(time=message["time"], price=message["price"], cv=message["cv"])
+        elif message["type"] != "alert":
+            replies.append(message)
+    return replies
+
+def request(fields):
+    '''
+    Send a change to the core, which writes it and applies it right away.
+    Returns None if the core can't be reached, so the database is written directly,
+    otherwise the error of the core or "" if the change was saved.
+    '''
+    if core is None:
+        connect()
+    if any("\t" in field or "\n" in field for field in fields):
+        return "Fields cannot contain tabs or line breaks"
+    if core is None or not send(fields):
+        return None
+    deadline = time.time() + 5
+    while core is not None and time.time() < deadline:
+        select.select([core], [], [], 0.2)
+        for reply in receive():
+            if reply["type"] == "ok":
+                return ""
+            if reply["type"] == "error" and reply.get("command") == fields[0]:
+                return reply["message"]
+    return "The program didn't answer, the change may not have been saved"
+
+def render():
+    '''
+    Show the currencies and their last price as received from the core.
+    '''
+    txt = f"Currencies being followed:\n"
+    for ID in sorted(live):
+        currency = live[ID]
+        if currency.get("time") is None:
+            date = " A price hasn't been saved \n"
+        else:
+            date = " Latest price retrieved is from " + time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(currency["time"]))
+            if currency.get("price") is not None:
+                date = date + f", {currency['price']:g} USD"
+            date = date + "\n"
+        txt = txt + f"{currency['name']}:" + f" API name: {currency['gecko']}." + date
+    data.config(text=txt)
+
+def poll():
+    '''
+    Read the prices pushed by the core every 250 ms, reconnecting every 2 s if it isn't reachable.
+    '''
+    global ticks
+    ticks += 1
+    if core is None and ticks % 8 == 0:
+        connect()
+    if core is not None:
+        receive()
+        if showing:
+            render()
+    window.after(250, poll)
 
 def showData():
     '''
     Function to show which crypto currencies are requested to the API, and to print when was the last price saved.
+    The prices are followed live while the core is reachable, otherwise they are read once from the database.
     '''
+    global showing
+    if core is None:
+        connect()
+    if core is not None:
+        showing = True
+        receive()
+        render()
+        return
     con = sqlite3.connect('Crypto.db')
     nameQuery = "SELECT * FROM Currencies;"
     try:
@@ -35,11 +180,17 @@ def showData():
         return
     names.set_index(names.ID,inplace=True)
     txt = f"Currencies being followed:\n"
+    # Old prices are compacted into the rollups (rollup.cpp), the latest one comes from there if Prices has none left
     for i in names.index:
-        dateQuery = "SELECT date FROM Prices WHERE CurrencyID = " + str(i) + " ORDER BY date DESC LIMIT 1; "
+        dateQuery = "SELECT datetime(MAX(time),'unixepoch','localtime') FROM Prices WHERE CurrencyID = " + str(i) + ";"
+        rollupQuery = "SELECT datetime(MAX(bucket),'unixepoch','localtime') FROM (SELECT MAX(bucket) AS bucket FROM PricesMinute WHERE CurrencyID = " + str(i) + \
+                      " UNION ALL SELECT MAX(bucket) FROM PricesHour WHERE CurrencyID = " + str(i) + " UNION ALL SELECT MAX(bucket) FROM PricesDay WHERE CurrencyID = " + str(i) + ");"
         try:
-            date = " Latest price retrieved is from " + pd.read_sql(dateQuery,con).values[0][0] +"\n"
-        except (IndexError,pd.errors.DatabaseError):
+            latest = pd.read_sql(dateQuery,con).values[0][0]
+            if latest is None:
+                latest = pd.read_sql(rollupQuery,con).values[0][0]
+            date = " Latest price retrieved is from " + latest +"\n"
+        except (IndexError,TypeError,pd.errors.DatabaseError):
             date = " A price hasn't been saved \n"
         txt = txt + f"{names.loc[i,'name']}:" + f" API name: {names.loc[i,'GeckoID']}." + date
     
@@ -129,8 +280,13 @@ def updateFields(entry, var='Add a new currency',index='1',mode='w'):
         label7.pack(pady=5)
         entry[6] = tk.Entry(window)
         entry[6].pack(pady=5)
+
+        label8 = tk.Label(window, text = "Threshold to alert for decoupling, if the correlation of the returns with the reference coins (bitcoin by default) or the market falls by this much from the whole correlation window to its last quarter (0-2). Suggested 0.5. Use 0 to deactive this alert",**styleText)
+        label8.pack(pady=5)
+        entry[7] = tk.Entry(window)
+        entry[7].pack(pady=5)
         
-        widgets.extend([label0, label1, entry[1],label2,entry[2],label3,entry[3],label4, entry[4],label5, entry[5],label6, entry[6],label7, entry[0]])
+        widgets.extend([label0, label1, entry[1],label2,entry[2],label3,entry[3],label4, entry[4],label5, entry[5],label6, entry[6],label7, entry[7],label8, entry[0]])
         #entries.extend([entry[1],entry[2],entry[3],entry[4],entry5,entry6,entry7])
         return
     
@@ -200,6 +356,8 @@ def showError(code, error = ''):
         error_label.config(text= f"Invalid e-mail", fg = "red")
     elif code == 14:
         error_label.config(text= f"Must enter the password too", fg = "red")
+    elif code == 15:
+        error_label.config(text="Invalid decoupling threshold (0-2)", fg="red")
     elif code == -1:
         error_label.config(text="Changes saved succesfully", fg="green")
     
@@ -215,7 +373,7 @@ def save(val):
     findID = "SELECT ID FROM Currencies WHERE name = ? "
     try:
         names = pd.read_sql("SELECT * FROM Currencies;",con)
-        pd.read_sql("SELECT * FROM Prices;",con)
+        pd.read_sql("SELECT * FROM Prices LIMIT 1;",con)
         pd.read_sql("SELECT * FROM Mode;",con)
         pd.read_sql("SELECT * FROM Configs;",con)
     except (sqlite3.Error, pd.errors.DatabaseError) as e:
@@ -233,15 +391,22 @@ def save(val):
         elif entry[0].get() in names["GeckoID"].values or entry[1].get() in names["name"].values:
            showError(2)
         else:
-            try:
-                cursor.execute(statement, (entry[0].get(),entry[1].get()))
-                ID = int(pd.read_sql(findID ,con, params = (entry[1].get(),)).values[0][0])
-                cursor.execute(alertDefault, (ID,))                
-                con.commit()
-            except sqlite3.Error as err:
-                con.rollback()
-                showError(3,error = err); con.close()
+            reply = request(["add", entry[0].get(), entry[1].get()])
+            if reply is None:
+                try:
+                    cursor.execute(statement, (entry[0].get(),entry[1].get()))
+                    ID = int(pd.read_sql(findID ,con, params = (entry[1].get(),)).values[0][0])
+                    cursor.execute(alertDefault, (ID,))                
+                    con.commit()
+                except sqlite3.Error as err:
+                    con.rollback()
+                    showError(3,error = err); con.close()
+                    return
+            elif reply != "":
+                showError(3,error = reply); con.close()
                 return
+            else:
+                snapshot()
             showError(-1)
             
     elif val == "Delete a currency":
@@ -253,20 +418,27 @@ def save(val):
         elif entry[0].get() not in names["name"].values:
            showError(4)
         else:
-            try:
-                cursor.execute(statement, (entry[0].get(),))
-                con.commit()
-            except sqlite3.Error as err:
-                con.rollback()
-                showError(3,error = err); con.close()
+            reply = request(["remove", entry[0].get()])
+            if reply is None:
+                try:
+                    cursor.execute(statement, (entry[0].get(),))
+                    con.commit()
+                except sqlite3.Error as err:
+                    con.rollback()
+                    showError(3,error = err); con.close()
+                    return
+            elif reply != "":
+                showError(3,error = reply); con.close()
                 return
+            else:
+                snapshot()
             showError(-1)
 
     elif val == "Change alert thresholds":
 
         cursor = sqlite3.Cursor(con)
-        statement = "INSERT INTO Configs (CurrencyID,minimumData,timeWindow,gain, longGain, movingAvg, anomaly) VALUES (?,?,?,?,?,?,?);"
-        getAlert = "SELECT minimumData,timeWindow,gain, longGain, movingAvg, anomaly FROM Configs WHERE CurrencyID = ? ORDER BY alertID DESC LIMIT 1;"
+        statement = "INSERT INTO Configs (CurrencyID,minimumData,timeWindow,gain, longGain, movingAvg, anomaly, decoupling) VALUES (?,?,?,?,?,?,?,?);"
+        getAlert = "SELECT minimumData,timeWindow,gain, longGain, movingAvg, anomaly, decoupling FROM Configs WHERE CurrencyID = ? ORDER BY alertID DESC LIMIT 1;"
         if entry[0].get() in names["name"].values and entry[0].get() != "":
             ID = int(pd.read_sql(findID ,con, params = (entry[0].get(),)).values[0][0])
             cursor = sqlite3.Cursor(con)
@@ -301,17 +473,26 @@ def save(val):
                     showError(8)
                     con.close()
                     return
+                elif val > 2 and i == 6:
+                    showError(15)
+                    con.close()
+                    return
                 else:
                     values[i] = val
 
             # poner con.close en show err
 
-            try:
-                cursor.execute(statement, (ID,values[0],values[1],values[2],values[3],values[4],values[5]))
-                con.commit()
-            except sqlite3.Error as err:
-                con.rollback()
-                showError(3,error = err); con.close()
+            reply = request(["thresholds", entry[0].get()] + [str(value) for value in values])
+            if reply is None:
+                try:
+                    cursor.execute(statement, (ID,values[0],values[1],values[2],values[3],values[4],values[5],values[6]))
+                    con.commit()
+                except sqlite3.Error as err:
+                    con.rollback()
+                    showError(3,error = err); con.close()
+                    return
+            elif reply != "":
+                showError(3,error = reply); con.close()
                 return
             showError(-1)
             
@@ -371,12 +552,18 @@ def save(val):
         if entry[3].get() != '':
             Vals[3] = entry[3].get()
 
-        try:
-            cursor.execute(statement,(Vals[0],Vals[1],Vals[2],Vals[3]))
-            con.commit()
-        except sqlite3.Error as e:
-            con.rollback()
-            showError(3,e)
+        reply = request(["mode"] + [str(value) for value in Vals])
+        if reply is None:
+            try:
+                cursor.execute(statement,(Vals[0],Vals[1],Vals[2],Vals[3]))
+                con.commit()
+            except sqlite3.Error as e:
+                con.rollback()
+                showError(3,e)
+                con.close()
+                return
+        elif reply != "":
+            showError(3,reply)
             con.close()
             return
         showError(-1)
@@ -419,6 +606,8 @@ option_var.trace("w", lambda a,b,mode: updateFields(entry,mode=mode))
 
 entry = [tk.Entry(window),tk.Entry(window),tk.Entry(window),tk.Entry(window),tk.Entry(window),tk.Entry(window),tk.Entry(window),tk.Entry(window)]
 updateFields(entry)
+connect()
+window.after(250, poll)
 
 
 window.mainloop()
@@ -0,0 +1,644 @@
+/** ========================================================================================
+
+    Filename:  analytics.cpp
+
+    Description:  Statistical analyses for each currency defined by the user, computed in
+                  process instead of launching Analysis.py on every update. Each currency
+                  follows its prices inside "timeWindow" in the PriceStore (pricestore.cpp)
+                  with rolling sums and sums of squares (mean, volatility, coefficient of
+                  variation, moving averages) and a sliding order statistic skip list
+                  (percentile anomaly, quantiles.cpp), so every new price costs O(log n), the
+                  anomaly check costs O(1) and the Prices table is never read again. Every few
+                  passes the rolling sums are recomputed from the rings with the SIMD kernels
+                  (kernels.cpp) in one batch, so the rounding errors of adding and removing
+                  prices do not accumulate. The whole state is saved to a snapshot now and then
+                  (snapshot.cpp) and mapped back at startup instead of being rebuilt. The
+                  alerts are rules (rules.cpp) compiled once per currency and run on the
+                  metrics of every pass.
+
+                  The metrics and thresholds are the same ones used by Analysis.py, which is
+                  kept as the reference implementation.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "analytics.h"
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include "kernels.h"
+#include "snapshot.h"
+#include "trace.h"
+
+static std::string number(double value);
+
+// Include the next position of the ring
+void RollingWindow::push(const PriceRing &ring)
+{
+    double price = ring.price(end);
+    if (count() == 0)
+    {
+        shift = price;
+        sum = 0;
+        sumSq = 0;
+    }
+    sum += price - shift;
+    sumSq += (price - shift)*(price - shift);
+    end++;
+}
+
+// Remove the oldest price
+void RollingWindow::pop(const PriceRing &ring)
+{
+    double price = ring.price(begin);
+    sum -= price - shift;
+    sumSq -= (price - shift)*(price - shift);
+    begin++;
+}
+
+// Remove every price saved at or before "since"
+void RollingWindow::evict(const PriceRing &ring, double since)
+{
+    while (count() > 0 && ring.time(begin) <= since)
+    {
+        pop(ring);
+    }
+}
+
+double RollingWindow::mean() const
+{
+    if (count() == 0)
+    {
+        return 0;
+    }
+    return shift + sum/count();
+}
+
+// Sample standard deviation, same as pandas std()
+double RollingWindow::std() const
+{
+    size_t n = count();
+    if (n < 2)
+    {
+        return 0;
+    }
+    double variance = (sumSq - sum*sum/n)/(n - 1);
+    return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+// Start following a ring, including the prices it already holds, or before them if not "held"
+// so push() includes them one by one
+void Series::attach(PriceRing &prices, bool held)
+{
+    ring = &prices;
+    window = recent = longer = RollingWindow();
+    window.begin = window.end = recent.begin = recent.end = longer.begin = longer.end = ring->first();
+    ordered.clear();
+    if (held)
+    {
+        follow();
+    }
+}
+
+// Thresholds of the currency. The anomaly percentiles tracked are the ones of "anomaly" followed
+// by those of "anomalies", so several thresholds can be compared on one window.
+void Series::thresholds(const Thresholds &values, const std::vector<double> &anomalies)
+{
+    std::vector<double> quantiles;
+    limits = values;
+    for (double anomaly : limits.anomaly != 0 ? std::vector<double>{limits.anomaly} : std::vector<double>())
+    {
+        quantiles.insert(quantiles.end(), {anomaly/100, 1 - anomaly/100});
+    }
+    for (double anomaly : anomalies)
+    {
+        quantiles.insert(quantiles.end(), {anomaly/100, 1 - anomaly/100});
+    }
+    ordered.track(quantiles);
+}
+
+// Include the prices of the ring that came after the last one pushed, like the prices read after
+// a snapshot was restored
+void Series::follow()
+{
+    while (window.end < ring->end())
+    {
+        push();
+    }
+}
+
+// Include the newest price of the ring
+void Series::push()
+{
+    ordered.insert(ring->price(window.end), window.end);
+    window.push(*ring);
+    recent.push(*ring);
+    longer.push(*ring);
+}
+
+// Drop the prices that left the windows at "now", the ring keeps them
+void Series::slide(double now)
+{
+    double winBegin = now - 3600*limits.timeWindow;
+    while (window.count() > 0 && ring->time(window.begin) <= winBegin)
+    {
+        ordered.erase(ring->price(window.begin), window.begin);
+        window.pop(*ring);
+    }
+    recent.evict(*ring, std::max(winBegin, now - 20*60));
+    longer.evict(*ring, std::max(winBegin, now - 70*60));
+}
+
+// Drop the prices that left the windows at "now", from the ring too
+void Series::evict(double now)
+{
+    slide(now);
+    ring->discard(window.begin);
+}
+
+Reading Series::read() const
+{
+    Reading values;
+    values.count = window.count();
+    if (values.count == 0)
+    {
+        return values;
+    }
+    values.first = ring->price(window.begin);
+    values.last = ring->price(window.end - 1);
+    values.instant = values.count > 1 ? (values.last - ring->price(window.end - 2))/ring->price(window.end - 2) : 0;
+    values.longer = (values.last - values.first)/values.first;
+    values.mean = window.mean();
+    values.volatility = window.std();
+    values.recentCount = recent.count();
+    values.recent = recent.mean();
+    values.hour = longer.mean();
+    return values;
+}
+
+// Values of the metrics the rules read (rules.cpp), "high" and "low" are the anomaly percentiles
+// of the window
+void Reading::metrics(double high, double low, double* out) const
+{
+    out[Count] = static_cast<double>(count);
+    out[First] = first;
+    out[Last] = last;
+    out[Instant] = 100*instant;
+    out[Return] = 100*longer;
+    out[Mean] = mean;
+    out[Volatility] = volatility;
+    out[Coefficient] = volatility > 0 ? mean/volatility : 0;
+    out[Recent] = recent;
+    out[Hour] = hour;
+    out[High] = high;
+    out[Low] = low;
+}
+
+// Linearly interpolated percentile (0 <= q <= 1) of the window, same as pandas describe()
+double Series::percentile(double q) const
+{
+    return ordered.percentile(q);
+}
+
+// Windows and order statistics, the ring is saved by the store (snapshot.cpp)
+void Series::save(SnapshotWriter &out) const
+{
+    out.put(limits.timeWindow);
+    out.put(window);
+    out.put(recent);
+    out.put(longer);
+    ordered.save(out);
+}
+
+bool Series::restore(SnapshotReader &in)
+{
+    return in.get(limits.timeWindow) && in.get(window) && in.get(recent) && in.get(longer) && ordered.restore(in);
+}
+
+Analytics::Analytics(PriceStore &prices, size_t threads) : store(prices)
+{
+    parallel(threads);
+}
+
+// Threads of the pool (0 for every hardware thread), the currencies are split again between
+// ShardsPerThread shards per thread so threads that finish early can steal work
+void Analytics::parallel(size_t threads)
+{
+    pool.reset(new WorkPool(threads));
+    std::vector<Shard> previous = std::move(shards);
+    shards = std::vector<Shard>(pool->size() == 1 ? 1 : ShardsPerThread*pool->size());
+    for (Shard &shard : previous)
+    {
+        for (auto &entry : shard.series)
+        {
+            shards[index(entry.first)].series.emplace(entry.first, std::move(entry.second));
+        }
+    }
+}
+
+// Correlations of the returns of every currency with the "references" (GeckoIDs), or with the
+// market if it is {"all"}, over "samples" samples taken every "minutes". Empty disables them.
+void Analytics::correlate(const std::vector<std::string> &currencies, size_t samples, double minutes)
+{
+    correlating = !currencies.empty();
+    references = currencies == std::vector<std::string>{"all"} ? std::vector<std::string>() : currencies;
+    correlationSamples = samples;
+    correlationMinutes = minutes;
+    if (!correlating)
+    {
+        correlated = Correlations();
+    }
+}
+
+// Follow the currencies of the configuration with their thresholds. Currencies deleted by the
+// user are dropped and new ones start from their ring in the store.
+void Analytics::configure(const Config &config)
+{
+    std::vector<std::map<int, Series>> current(shards.size());
+
+    const std::vector<RuleConfig> rules = validate(config.rules);
+    for (const CurrencyConfig &currency : config.currencies)
+    {
+        std::map<int, Series> &series = shards[index(currency.id)].series;
+        auto found = series.find(currency.id);
+        Series &entry = current[index(currency.id)][currency.id];
+        bool existing = found != series.end();
+        if (existing)
+        {
+            entry = std::move(found->second);
+            series.erase(found);
+        }
+        entry.name = currency.name;
+        entry.thresholds(currency.limits);
+        entry.plan.compile(currency.limits, rules, currency.id);
+        if (!existing)
+        {
+            entry.attach(store.ring(currency.id, currency.limits.timeWindow));
+        }
+        else
+        {
+            entry.follow();
+        }
+    }
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        for (auto &removed : shards[i].series)
+        {
+            store.erase(removed.first);
+        }
+        shards[i].series = std::move(current[i]);
+    }
+
+    if (correlating)
+    {
+        std::vector<int> ids;
+        std::vector<int> followed;
+        for (const CurrencyConfig &currency : config.currencies)
+        {
+            ids.push_back(currency.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        for (const std::string &reference : references)
+        {
+            for (const CurrencyConfig &currency : config.currencies)
+            {
+                if (currency.gecko == reference)
+                {
+                    followed.push_back(currency.id);
+                }
+            }
+        }
+        // References that aren't followed are skipped until they are
+        if (!references.empty() && followed.empty())
+        {
+            followed.push_back(-1);
+        }
+        correlated.configure(ids, followed, correlationSamples, 60*correlationMinutes);
+    }
+}
+
+Series* Analytics::find(int id)
+{
+    std::map<int, Series> &series = shards[index(id)].series;
+    auto found = series.find(id);
+    return found == series.end() ? nullptr : &found->second;
+}
+
+// Called for every price pushed to the store
+void Analytics::add(int id)
+{
+    std::map<int, Series> &series = shards[index(id)].series;
+    auto found = series.find(id);
+    if (found != series.end())
+    {
+        found->second.push();
+    }
+}
+
+// Coefficient of variation (volatility/mean) of the window of a currency, 0 without enough data
+double Analytics::cv(int id) const
+{
+    const std::map<int, Series> &series = shards[index(id)].series;
+    auto found = series.find(id);
+    if (found == series.end() || found->second.window.count() < 2 || found->second.window.mean() == 0)
+    {
+        return 0;
+    }
+    return found->second.window.std()/std::abs(found->second.window.mean());
+}
+
+// Coefficient of variation of every currency, by ID
+std::vector<std::pair<int, double>> Analytics::cvs() const
+{
+    std::vector<std::pair<int, double>> values;
+    for (const Shard &shard : shards)
+    {
+        for (const auto &entry : shard.series)
+        {
+            values.emplace_back(entry.first, cv(entry.first));
+        }
+    }
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+// Perform calculations and check thresholds for each currency with enough data in its time window.
+// Returns the alerts triggered, "analysed" is set to the number of currencies with enough data.
+std::vector<std::string> Analytics::run(double now, int &analysed)
+{
+    if (++passes % ResyncPasses == 0)
+    {
+        resync();
+    }
+    pool->run(shards.size(), [&](size_t i) { analyse(shards[i], now); });
+
+    // Alerts of every shard by Currencies.ID, stable so the lines of a currency keep their order
+    std::vector<std::pair<int, std::string>> merged;
+    analysed = 0;
+    for (Shard &shard : shards)
+    {
+        analysed += shard.analysed;
+        std::move(shard.alerts.begin(), shard.alerts.end(), std::back_inserter(merged));
+    }
+    decoupling(now, merged);
+    std::stable_sort(merged.begin(), merged.end(), [](const std::pair<int, std::string> &a, const std::pair<int, std::string> &b) { return a.first < b.first; });
+    std::vector<std::string> alerts;
+    alerts.reserve(merged.size());
+    for (auto &alert : merged)
+    {
+        alerts.push_back(std::move(alert.second));
+    }
+    return alerts;
+}
+
+// Analyses of the currencies of one shard, run by a thread of the pool
+void Analytics::analyse(Shard &shard, double now)
+{
+    Trace span(Task);
+    std::vector<std::pair<int, std::string>> &alerts = shard.alerts;
+    std::vector<const Rule*> fired;
+    alerts.clear();
+    shard.analysed = 0;
+
+    for (auto &entry : shard.series)
+    {
+        Series &data = entry.second;
+        const Thresholds &limits = data.limits;
+        data.evict(now);
+        Reading values = data.read();
+        if (!values.ready(limits))
+        {
+            continue;
+        }
+        shard.analysed++;
+
+        const std::string since = UNIX(std::to_string(static_cast<long long>(data.ring->time(data.window.begin))));
+        const std::string count = std::to_string(values.count);
+        double high = limits.anomaly != 0 ? data.ordered.tracked(0) : 0;   // percentile(anomaly/100)
+        double low = limits.anomaly != 0 ? data.ordered.tracked(1) : 0;    // percentile(1 - anomaly/100)
+        double metrics[Measures];
+        values.metrics(high, low, metrics);
+        fired.clear();
+        data.plan.evaluate(metrics, now, rearm, fired);
+
+        for (const Rule *rule : fired)
+        {
+            switch (rule->signal)
+            {
+                case InstantGain:
+                    alerts.emplace_back(entry.first, "The instant return value of " + data.name + " has surpassed the " + number(limits.gain) + "% threshold, this may be a significant instant " + (values.instant > 0 ? "increase." : "decrease."));
+                    break;
+                case LongGain:
+                    alerts.emplace_back(entry.first, "The return value of " + data.name + " has surpassed the " + number(limits.longGain) + "% threshold with " + count + " data since " + since + ". This may be a significant " + (values.longer > 0 ? "increase" : "decrease"));
+                    break;
+                case MovingAverage:
+                    alerts.emplace_back(entry.first, "The average value of " + data.name + " in the last 20 minutes (" + number(values.recent) + ") has surpassed the average in 70 minutes (" + number(values.hour) + "), so change could be developing fast ");
+                    break;
+                case Anomaly:
+                    alerts.emplace_back(entry.first, "The latest price retrieved for " + data.name + " (" + number(values.last) + ") is " + (values.last > high ? "higher" : "lower") + " than " + number(limits.anomaly) + "% from a total of " + count + " data since " + since);
+                    break;
+                case Variation:
+                    alerts.emplace_back(entry.first, "The coefficient of variation for " + data.name + " is at " + number(values.mean/values.volatility) + ". Consider the volatility at this moment is " + number(values.volatility) + ", calculated with " + count + " data since " + since);
+                    break;
+                default:
+                    alerts.emplace_back(entry.first, "The rule " + rule->name + " (" + rule->expression + ") is met by " + data.name + ", with " + count + " data since " + since);
+                    break;
+            }
+        }
+    }
+}
+
+// Sample the correlations when they are due and alert for the currencies whose correlation with a
+// partner fell by more than their "decoupling" threshold from the whole window to its last quarter
+void Analytics::decoupling(double now, std::vector<std::pair<int, std::string>> &alerts)
+{
+    const std::vector<int> &ids = correlated.ids();
+    std::vector<double> prices(ids.size(), 0);
+    for (size_t column = 0; correlating && column < ids.size(); column++)
+    {
+        Series *data = find(ids[column]);
+        prices[column] = data != nullptr && data->ring->seen() ? data->ring->last() : 0;
+    }
+    if (!correlating || !correlated.sample(now, prices))
+    {
+        return;
+    }
+    const std::string whole = number(correlated.window()*correlated.seconds()/3600);
+    const std::string last = number(correlated.window()/4*correlated.seconds()/3600);
+    for (size_t column = 0; column < ids.size(); column++)
+    {
+        Series *data = find(ids[column]);
+        if (data == nullptr || data->limits.decoupling == 0)
+        {
+            continue;
+        }
+        for (size_t p = 0; p < correlated.partners(); p++)
+        {
+            double before = correlated.longer(column, p);
+            double after = correlated.recent(column, p);
+            if (std::isnan(before) || std::isnan(after) || before - after <= data->limits.decoupling)
+            {
+                continue;
+            }
+            Series *partner = correlated.partner(p) < 0 ? nullptr : find(correlated.partner(p));
+            const std::string with = partner == nullptr ? "the market" : partner->name;
+            char values[64];
+            std::snprintf(values, sizeof(values), "%.2f to %.2f", before, after);
+            alerts.emplace_back(ids[column], "The correlation of " + data->name + " with " + with + " fell from " + std::string(values) + " between the last "
+                                             + whole + " hours and the last " + last + " hours, " + data->name + " may be decoupling from " + with);
+        }
+    }
+}
+
+// Recompute the sums of every window of the series from its ring, shifted by its current first price
+void resync(const std::vector<Series*> &series)
+{
+    std::vector<RollingWindow*> windows;
+    std::vector<Window> batch;
+    for (Series *data : series)
+    {
+        for (RollingWindow *rolling : {&data->window, &data->recent, &data->longer})
+        {
+            if (rolling->count() == 0)
+            {
+                continue;
+            }
+            Window spans = data->ring->window(rolling->begin, rolling->end);
+            spans.shift = data->ring->price(rolling->begin);
+            windows.push_back(rolling);
+            batch.push_back(spans);
+        }
+    }
+
+    std::vector<Moments> moments;
+    summarize(batch, moments);
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        windows[i]->shift = batch[i].shift;
+        windows[i]->sum = moments[i].sum;
+        windows[i]->sumSq = moments[i].sumSq;
+    }
+}
+
+void Analytics::resync()
+{
+    std::vector<Series*> series;
+    for (Shard &shard : shards)
+    {
+        for (auto &entry : shard.series)
+        {
+            series.push_back(&entry.second);
+        }
+    }
+    ::resync(series);
+}
+
+// Layout of the structures of a snapshot, the rest are plain values
+static uint32_t structures()
+{
+    return layout({sizeof(RollingWindow), SlidingQuantiles::layout()});
+}
+
+// Snapshot of the store and of every currency, only called by the thread running the analyses
+int Analytics::save(const std::string &path) const
+{
+    Trace span(Snapshot);
+    SnapshotWriter out;
+    uint64_t count = 0;
+    store.save(out);
+    for (const Shard &shard : shards)
+    {
+        count += shard.series.size();
+    }
+    out.put(count);
+    for (const Shard &shard : shards)
+    {
+        for (const auto &entry : shard.series)
+        {
+            out.put(entry.first);
+            entry.second.save(out);
+        }
+    }
+    correlated.save(out);
+    return out.save(path, structures());
+}
+
+// State of a snapshot for the currencies of the configuration whose time window didn't change,
+// before PriceStore::load() and configure(). The rings of the others are dropped so load() reads
+// their windows again. Returns 0, 1 without a snapshot or -1 if it can't be used; in both cases
+// the store and the engine are left empty.
+int Analytics::restore(const std::string &path, const Config &config, sqlite3 *db)
+{
+    SnapshotReader in;
+    int opened = in.open(path, structures());
+    if (opened != 0)
+    {
+        return opened;
+    }
+    if (store.restore(in, db) != 0)
+    {
+        return -1;
+    }
+    std::map<int, const CurrencyConfig*> followed;
+    for (const CurrencyConfig &currency : config.currencies)
+    {
+        followed[currency.id] = &currency;
+    }
+    for (Shard &shard : shards)
+    {
+        shard.series.clear();
+    }
+
+    uint64_t count = 0;
+    bool read = in.get(count);
+    for (uint64_t i = 0; read && i < count; i++)
+    {
+        int id = 0;
+        Series data;
+        read = in.get(id) && data.restore(in);
+        auto found = followed.find(id);
+        PriceRing &ring = store.ring(id);
+        if (read && found != followed.end() && data.limits.timeWindow == found->second->limits.timeWindow
+            && ring.first() <= data.window.begin && data.window.end <= ring.end())
+        {
+            data.name = found->second->name;
+            data.limits = found->second->limits;
+            data.ring = &ring;
+            shards[index(id)].series.emplace(id, std::move(data));
+        }
+        else
+        {
+            store.erase(id);
+        }
+    }
+    read = read && correlated.restore(in);
+    if (!read || !in.done())
+    {
+        Alert(std::vector<std::string> (1,"The snapshot " + path + " can't be read, it is ignored"),"error");
+        for (Shard &shard : shards)
+        {
+            shard.series.clear();
+        }
+        store.clear();
+        return -1;
+    }
+    return 0;
+}
+
+// Print doubles the way python does, without trailing zeros
+static std::string number(double value)
+{
+    std::ostringstream out;
+    out.precision(10);
+    out << value;
+    return out.str();
+}
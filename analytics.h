@@ -0,0 +1,134 @@
+#ifndef analytics_h
+#define analytics_h
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <memory>
+#include "pricestore.h"
+#include "quantiles.h"
+#include "pool.h"
+#include "config.h"
+#include "correlation.h"
+#include "rules.h"
+
+// Running sums over the positions [begin, end) of a price ring, so mean and std are O(1).
+// Sums are shifted by the first price seen to avoid cancellation in the variance.
+struct RollingWindow
+{
+    size_t begin = 0;
+    size_t end = 0;
+    double shift = 0;
+    double sum = 0;
+    double sumSq = 0;
+
+    void push(const PriceRing &ring);
+    void pop(const PriceRing &ring);
+    void evict(const PriceRing &ring, double since);
+    size_t count() const { return end - begin; }
+    double mean() const;
+    double std() const;
+};
+
+// What one pass of the analyses reads from the windows of a currency
+struct Reading
+{
+    size_t count = 0;
+    double first = 0;
+    double last = 0;
+    double instant = 0;      // Returns(data)
+    double longer = 0;       // Returns(data, count)
+    double mean = 0;
+    double volatility = 0;
+    size_t recentCount = 0;
+    double recent = 0;       // mean of the last 20 minutes
+    double hour = 0;         // mean of the last 70 minutes
+
+    bool ready(const Thresholds &limits) const { return count > 0 && count >= static_cast<size_t>(limits.minimumData); }
+    void metrics(double high, double low, double* out) const;
+};
+
+// Incremental state of a single currency, over its ring in the PriceStore
+struct Series
+{
+    std::string name;
+    Thresholds limits;
+    PriceRing *ring = nullptr;
+    RollingWindow window;          // the whole "timeWindow"
+    RollingWindow recent;          // last 20 minutes
+    RollingWindow longer;          // last 70 minutes
+    SlidingQuantiles ordered;      // tracks the two percentiles of "anomaly"
+    Plan plan;                     // alert rules of the thresholds and of the Rules table
+
+    void attach(PriceRing &prices, bool held = true);
+    void thresholds(const Thresholds &values, const std::vector<double> &anomalies = {});
+    void follow();
+    void push();
+    void slide(double now);
+    void evict(double now);
+    Reading read() const;
+    double percentile(double q) const;
+    void save(SnapshotWriter &out) const;
+    bool restore(SnapshotReader &in);
+};
+
+// Rolling sums of the series recomputed from their rings with the SIMD kernels
+void resync(const std::vector<Series*> &series);
+
+// Currencies analysed by one task of the pool. Every shard owns its series and its alerts and
+// starts on its own cache line, so threads never write to the same memory.
+struct alignas(64) Shard
+{
+    std::map<int, Series> series;
+    std::vector<std::pair<int, std::string>> alerts;  // Currencies.ID of each alert, for the merge
+    int analysed = 0;
+};
+
+// In process replacement of Analysis.py. It is told about every price pushed to the PriceStore
+// by update() and keeps the metrics Returns, movingAverage, anomaly and variation up to date
+// without reading Prices again. Currencies are split in shards by ID and run() analyses the
+// shards in parallel; the alerts come out in the order of a serial pass. The correlations between
+// currencies (correlation.cpp) are sampled by run() too, after the shards. save() writes the state
+// of every currency and of the store to a snapshot (snapshot.cpp) that restore() maps back at
+// startup, before PriceStore::load() and configure().
+class Analytics
+{
+public:
+    explicit Analytics(PriceStore &prices, size_t threads = 0);
+    void parallel(size_t threads);
+    size_t threads() const { return pool->size(); }
+    void correlate(const std::vector<std::string> &references, size_t samples, double minutes);
+    const Correlations& correlations() const { return correlated; }
+    void hysteresis(const Hysteresis &values) { rearm = values; }
+    void configure(const Config &config);
+    void add(int id);
+    double cv(int id) const;
+    std::vector<std::pair<int, double>> cvs() const;
+    std::vector<std::string> run(double now, int &analysed);
+    void resync();
+    int save(const std::string &path) const;
+    int restore(const std::string &path, const Config &config, sqlite3 *db);
+
+    static constexpr int ResyncPasses = 64;  // passes between two resyncs
+
+private:
+    static constexpr int ShardsPerThread = 4;
+
+    size_t index(int id) const { return static_cast<size_t>(id) % shards.size(); }
+    Series* find(int id);
+    void analyse(Shard &shard, double now);
+    void decoupling(double now, std::vector<std::pair<int, std::string>> &alerts);
+
+    PriceStore &store;
+    std::vector<Shard> shards;
+    std::unique_ptr<WorkPool> pool;
+    int passes = 0;
+    Correlations correlated;
+    std::vector<std::string> references;  // GeckoIDs, empty for the market
+    bool correlating = false;
+    size_t correlationSamples = 48;
+    double correlationMinutes = 5;
+    Hysteresis rearm;
+};
+
+#endif
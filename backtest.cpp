@@ -0,0 +1,377 @@
+/** ========================================================================================
+
+    Filename:  backtest.cpp
+
+    Description:  Offline backtest of the thresholds of Configs (--backtest). The stored
+                  history of every currency (the closes of the rollups, Prices and the
+                  journal) is read once into one ring per currency, then replayed through the
+                  analyses of analytics.cpp in simulated time: one pass per price, at the time
+                  of that price, with the same windows, order statistics and alert rules
+                  (rules.cpp) as the live program. Every rule keeps its state through the
+                  replay, so the alerts counted are the ones that would have been sent.
+
+                  Every combination of the grid of thresholds is evaluated for every currency.
+                  The combinations with the same "timeWindow" share one series, so each price
+                  is pushed once for all of them and only the comparisons are repeated; the
+                  anomaly percentiles of every combination are tracked by the same skip list.
+                  The series of all currencies and time windows are replayed in parallel by a
+                  work stealing pool (pool.cpp) over the shared, read only rings.
+
+                  Usage: CryptoAnalysis --backtest [days=N] [minimumData=a,b,..] [timeWindow=..]
+                                        [gain=..] [longGain=..] [movingAvg=0,1] [anomaly=..]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "backtest.h"
+#include "persistence.h"
+#include "storage.h"
+#include "config.h"
+#include "pool.h"
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Series of one currency replayed for the combinations with one time window
+struct Replay
+{
+    size_t currency;
+    double timeWindow;
+    std::vector<size_t> combinations;
+};
+
+// Reads "name=value,value,..." arguments, returns -1 with an unknown name or an invalid value
+int Grid::parse(const std::vector<std::string> &arguments)
+{
+    const std::map<std::string, std::vector<double>*> lists = {{"minimumData", &minimumData}, {"timeWindow", &timeWindow},
+        {"gain", &gain}, {"longGain", &longGain}, {"movingAvg", &movingAvg}, {"anomaly", &anomaly}};
+    for (const std::string &argument : arguments)
+    {
+        size_t equal = argument.find('=');
+        std::string name = argument.substr(0, equal);
+        std::vector<double> values;
+        try
+        {
+            for (size_t begin = equal + 1, comma = 0; equal != std::string::npos && comma != std::string::npos; begin = comma + 1)
+            {
+                comma = argument.find(',', begin);
+                values.push_back(std::stod(argument.substr(begin, comma - begin)));
+            }
+        }
+        catch (const std::exception &)
+        {
+            values.clear();
+        }
+        if (name == "days" && values.size() == 1 && values[0] >= 0)
+        {
+            days = values[0];
+        }
+        else if (lists.count(name) > 0 && !values.empty() && *std::min_element(values.begin(), values.end()) >= 0)
+        {
+            *lists.at(name) = values;
+        }
+        else
+        {
+            Alert(std::vector<std::string> (1,"Invalid backtest argument " + argument),"error");
+            return -1;
+        }
+    }
+    if (std::find(timeWindow.begin(), timeWindow.end(), 0) != timeWindow.end())
+    {
+        Alert(std::vector<std::string> (1,"The backtest timeWindow must be more than 0 hours"),"error");
+        return -1;
+    }
+    return 0;
+}
+
+size_t Grid::size() const
+{
+    size_t combinations = 1;
+    for (const std::vector<double>* values : {&minimumData, &timeWindow, &gain, &longGain, &movingAvg, &anomaly})
+    {
+        combinations *= std::max<size_t>(1, values->size());
+    }
+    return combinations;
+}
+
+// Thresholds of a combination, 0 <= combination < size(), the lists are counted like digits
+Thresholds Grid::at(size_t combination, const Thresholds &current) const
+{
+    Thresholds limits = current;
+    auto pick = [&combination](const std::vector<double> &values, double kept)
+    {
+        if (values.empty())
+        {
+            return kept;
+        }
+        double value = values[combination % values.size()];
+        combination /= values.size();
+        return value;
+    };
+    limits.minimumData = static_cast<int>(pick(minimumData, limits.minimumData));
+    limits.timeWindow = pick(timeWindow, limits.timeWindow);
+    limits.gain = pick(gain, limits.gain);
+    limits.longGain = pick(longGain, limits.longGain);
+    limits.movingAvg = pick(movingAvg, limits.movingAvg) != 0;
+    limits.anomaly = pick(anomaly, limits.anomaly);
+    return limits;
+}
+
+// Whole history of every currency, as PriceStore::load() reads a window: the closes of the hour
+// buckets before the minute buckets, the minute buckets, then Prices and the other storage.
+static int load(sqlite3 *db, Storage *history, const Config &current, double since, std::vector<PriceRing> &rings)
+{
+    const char* compactedQuery = "SELECT CAST(value AS REAL) FROM Settings WHERE name = 'compactedUntil';";
+    const char* rollupQuery = "SELECT bucket,close FROM PricesHour WHERE CurrencyID = ?1 AND bucket >= ?2 AND bucket < ?3 "
+                              "AND bucket + 3600 <= (SELECT COALESCE(MIN(bucket),?3) FROM PricesMinute WHERE CurrencyID = ?1) "
+                              "UNION ALL SELECT bucket,close FROM PricesMinute WHERE CurrencyID = ?1 AND bucket >= ?2 AND bucket < ?3 ORDER BY 1;";
+    const char* priceQuery = "SELECT time,price FROM Prices WHERE CurrencyID = ?1 AND time >= ?2 ORDER BY time;";
+    sqlite3_stmt* compacted = nullptr;
+    sqlite3_stmt* rollups = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    double until = 0;
+
+    if (sqlite3_prepare_v2(db,compactedQuery,-1,&compacted,nullptr) != SQLITE_OK || sqlite3_prepare_v2(db,rollupQuery,-1,&rollups,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,priceQuery,-1,&stmt,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error reading the history for the backtest: " + std::string(sqlite3_errmsg(db))),"error");
+        sqlite3_finalize(compacted);
+        sqlite3_finalize(rollups);
+        return -1;
+    }
+    if (sqlite3_step(compacted) == SQLITE_ROW)
+    {
+        until = sqlite3_column_double(compacted,0);
+    }
+    rings.assign(current.currencies.size(), PriceRing());
+    for (size_t c = 0; c < current.currencies.size(); c++)
+    {
+        int id = current.currencies[c].id;
+        if (since < until)
+        {
+            sqlite3_bind_int(rollups,1,id);
+            sqlite3_bind_double(rollups,2,since);
+            sqlite3_bind_double(rollups,3,until);
+            while (sqlite3_step(rollups) == SQLITE_ROW)
+            {
+                rings[c].push(sqlite3_column_double(rollups,0),sqlite3_column_double(rollups,1));
+            }
+            sqlite3_reset(rollups);
+        }
+        sqlite3_bind_int(stmt,1,id);
+        sqlite3_bind_double(stmt,2,since);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            rings[c].push(sqlite3_column_double(stmt,0),sqlite3_column_double(stmt,1));
+        }
+        sqlite3_reset(stmt);
+        if (history != nullptr)
+        {
+            history->replay(id, since, rings[c]);
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(rollups);
+    sqlite3_finalize(compacted);
+    return 0;
+}
+
+// Passes of one series over its whole ring, for the combinations of "task" and the user rules of
+// its currency "id"
+static void replay(const Replay &task, PriceRing &ring, const std::vector<Thresholds> &limits, const std::vector<RuleConfig> &rules, int id,
+                   const Hysteresis &rearm, std::vector<Outcome> &outcomes)
+{
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<double> anomalies;
+    std::vector<size_t> markers;
+    for (size_t combination : task.combinations)
+    {
+        double anomaly = limits[combination].anomaly;
+        auto found = std::find(anomalies.begin(), anomalies.end(), anomaly);
+        markers.push_back(2*(found - anomalies.begin()));
+        if (found == anomalies.end() && anomaly != 0)
+        {
+            anomalies.push_back(anomaly);
+        }
+    }
+    Series data;
+    Thresholds window;
+    window.timeWindow = task.timeWindow;
+    window.anomaly = 0;
+    data.thresholds(window, anomalies);
+    data.attach(ring, false);
+
+    std::vector<Outcome> local(task.combinations.size());
+    std::vector<Plan> plans(task.combinations.size());
+    for (size_t i = 0; i < plans.size(); i++)
+    {
+        plans[i].compile(limits[task.combinations[i]], rules, id);
+    }
+    std::vector<const Rule*> fired;
+    double metrics[Measures];
+    for (size_t position = ring.first(), passes = 1; position < ring.end(); position++, passes++)
+    {
+        double now = ring.time(position);
+        data.push();
+        data.slide(now);
+        if (passes % Analytics::ResyncPasses == 0)
+        {
+            resync({&data});
+        }
+        Reading values = data.read();
+        values.metrics(0, 0, metrics);
+        for (size_t i = 0; i < local.size(); i++)
+        {
+            const Thresholds &thresholds = limits[task.combinations[i]];
+            Outcome &outcome = local[i];
+            outcome.passes++;
+            if (!values.ready(thresholds))
+            {
+                continue;
+            }
+            outcome.analysed++;
+            bool anomaly = thresholds.anomaly != 0;
+            metrics[High] = anomaly ? data.ordered.tracked(markers[i]) : 0;
+            metrics[Low] = anomaly ? data.ordered.tracked(markers[i] + 1) : 0;
+            fired.clear();
+            plans[i].evaluate(metrics, now, rearm, fired);
+            for (const Rule *rule : fired)
+            {
+                (rule->signal >= 0 ? outcome.alerts[rule->signal] : outcome.rules)++;
+            }
+            if (!fired.empty() && outcome.first == 0)
+            {
+                outcome.first = now;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    for (size_t i = 0; i < local.size(); i++)
+    {
+        local[i].seconds = seconds/local.size();
+        outcomes[task.combinations[i]] = local[i];
+    }
+}
+
+// Report lines of the combinations, "days" of history. The outcome of every currency is added
+// to "total" for the summary.
+static void report(std::ostream &out, const std::vector<Thresholds> &limits, const Outcome* outcomes, double days, std::vector<Outcome> &total)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "  %7s %6s %6s %8s %6s %7s %9s %8s %8s %8s %8s %9s %6s %9s %19s %9s\n", "minData", "window", "gain",
+                  "longGain", "movAvg", "anomaly", "analysed", "instant", "return", "average", "anomaly", "variation", "rules", "alerts/d", "first alert", "CPU ms");
+    out << line;
+    for (size_t i = 0; i < limits.size(); i++)
+    {
+        const Outcome &outcome = outcomes[i];
+        long long alerts = outcome.rules;
+        for (int signal = 0; signal < Signals; signal++)
+        {
+            alerts += outcome.alerts[signal];
+            total[i].alerts[signal] += outcome.alerts[signal];
+        }
+        total[i].rules += outcome.rules;
+        total[i].passes += outcome.passes;
+        total[i].analysed += outcome.analysed;
+        total[i].seconds += outcome.seconds;
+        total[i].first = outcome.first != 0 && (total[i].first == 0 || outcome.first < total[i].first) ? outcome.first : total[i].first;
+        std::snprintf(line, sizeof(line), "  %7d %6g %6g %8g %6d %7g %9lld %8lld %8lld %8lld %8lld %9lld %6lld %9.1f %19s %9.1f\n", limits[i].minimumData,
+                      limits[i].timeWindow, limits[i].gain, limits[i].longGain, limits[i].movingAvg ? 1 : 0, limits[i].anomaly, outcome.analysed,
+                      outcome.alerts[InstantGain], outcome.alerts[LongGain], outcome.alerts[MovingAverage], outcome.alerts[Anomaly], outcome.alerts[Variation],
+                      outcome.rules, days > 0 ? alerts/days : 0, outcome.first != 0 ? UNIX(std::to_string(static_cast<long long>(outcome.first))).c_str() : "-", 1e3*outcome.seconds);
+        out << line;
+    }
+}
+
+int backtest(Persistence &db, Storage *history, const Grid &grid, const Hysteresis &rearm, size_t threads, std::ostream &out, std::vector<Outcome> *results)
+{
+    if (config.refresh(db) < 0)
+    {
+        return -1;
+    }
+    std::shared_ptr<const Config> current = config.get();
+    if (current->currencies.empty())
+    {
+        Alert(std::vector<std::string> (1,"You haven't defined any cryptos to backtest"),"local");
+        return -1;
+    }
+    double now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<PriceRing> rings;
+    if (load(db.handle(), history, *current, grid.days > 0 ? now - 86400*grid.days : 0, rings) != 0)
+    {
+        return -1;
+    }
+    double loading = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    // One series per currency and time window, the outcomes of currency c are at c*combinations
+    const size_t combinations = grid.size();
+    std::vector<Thresholds> limits;
+    std::vector<Replay> tasks;
+    size_t prices = 0, passes = 0;
+    for (size_t c = 0; c < current->currencies.size(); c++)
+    {
+        std::map<double, std::vector<size_t>> windows;
+        for (size_t k = 0; k < combinations; k++)
+        {
+            limits.push_back(grid.at(k, current->currencies[c].limits));
+            windows[limits.back().timeWindow].push_back(c*combinations + k);
+        }
+        for (auto &window : windows)
+        {
+            tasks.push_back({c, window.first, std::move(window.second)});
+            passes += rings[c].size();
+        }
+        prices += rings[c].size();
+    }
+    std::vector<Outcome> outcomes(limits.size());
+    const std::vector<RuleConfig> rules = validate(current->rules);
+    WorkPool pool(threads);
+    begin = std::chrono::steady_clock::now();
+    pool.run(tasks.size(), [&](size_t t) { replay(tasks[t], rings[tasks[t].currency], limits, rules, current->currencies[tasks[t].currency].id, rearm, outcomes); });
+    double replaying = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "Backtest of %zu currencies, %zu prices, %zu combinations on %zu threads\n"
+                  "History read in %.0f ms, replayed in %.0f ms (%.0f passes/s, %.0f checks/s)\n",
+                  current->currencies.size(), prices, combinations, pool.size(), 1e3*loading, 1e3*replaying,
+                  passes/std::max(1e-9, replaying), combinations*prices/std::max(1e-9, replaying));
+    out << line;
+    std::vector<Outcome> total(combinations);
+    double span = 0;
+    for (size_t c = 0; c < current->currencies.size(); c++)
+    {
+        const PriceRing &ring = rings[c];
+        double days = ring.size() > 1 ? (ring.time(ring.end() - 1) - ring.time(ring.first()))/86400 : 0;
+        span = std::max(span, days);
+        out << std::endl << current->currencies[c].name << ": " << ring.size() << " prices";
+        if (ring.size() > 0)
+        {
+            out << " from " << UNIX(std::to_string(static_cast<long long>(ring.time(ring.first())))) << " to " << UNIX(std::to_string(static_cast<long long>(ring.time(ring.end() - 1))));
+        }
+        out << std::endl;
+        report(out, std::vector<Thresholds>(limits.begin() + c*combinations, limits.begin() + (c + 1)*combinations), &outcomes[c*combinations], days, total);
+    }
+    if (current->currencies.size() > 1)
+    {
+        // Thresholds the grid doesn't set vary by currency, the summary shows those of the first one
+        std::vector<Outcome> ignored(combinations);
+        out << std::endl << "All currencies" << std::endl;
+        report(out, std::vector<Thresholds>(limits.begin(), limits.begin() + combinations), total.data(), span, ignored);
+    }
+    if (results != nullptr)
+    {
+        *results = std::move(outcomes);
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef backtest_h
+#define backtest_h
+#include <vector>
+#include <string>
+#include <ostream>
+#include "analytics.h"
+
+class Persistence;
+class Storage;
+
+// Values tried for each threshold of Configs, given as "name=value,value,..." arguments. A
+// threshold without values keeps the one of each currency, the combinations are the product
+// of the lists.
+struct Grid
+{
+    std::vector<double> minimumData;
+    std::vector<double> timeWindow;
+    std::vector<double> gain;
+    std::vector<double> longGain;
+    std::vector<double> movingAvg;
+    std::vector<double> anomaly;
+    double days = 0;   // history replayed, 0 for all of it
+
+    int parse(const std::vector<std::string> &arguments);
+    size_t size() const;
+    Thresholds at(size_t combination, const Thresholds &current) const;
+};
+
+// Alerts of one combination of thresholds for one currency
+struct Outcome
+{
+    long long passes = 0;
+    long long analysed = 0;        // passes with "minimumData" prices in the window
+    long long alerts[Signals] = {};
+    long long rules = 0;           // alerts of the rules of the Rules table
+    double first = 0;              // time of the first alert, 0 without alerts
+    double seconds = 0;            // share of the replay of its time window
+};
+
+// Replays the stored prices of every currency through the analyses, one pass per price in the
+// time of that price, for every combination of the grid, with the rules re-armed as "rearm" says.
+// Writes the report to "out" and, if given, the outcomes to "results", those of the c-th currency
+// of Configs at c*grid.size(). Returns 0, or -1 with errors.
+int backtest(Persistence &db, Storage *history, const Grid &grid, const Hysteresis &rearm, size_t threads, std::ostream &out, std::vector<Outcome> *results = nullptr);
+
+#endif
@@ -0,0 +1,179 @@
+/** ========================================================================================
+
+    Filename:  backtest_bench.cpp
+
+    Description:  Parameter sweep of --backtest over months of history. A scratch database
+                  gets one price per minute for every currency over "days" days, then:
+                    - check: the current thresholds alone, compared with the live Analytics
+                      run after every minute over the same prices for a few currencies; the
+                      alerts of every kind must be the same
+                    - sweep: a grid of 3 time windows, 3 gains, 3 long gains, 2 moving
+                      averages and 3 anomalies (162 combinations) on 1 thread and on every
+                      hardware thread
+
+                  Usage: bench/backtest_bench [currencies] [days]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../headers.h"
+#include "../persistence.h"
+#include "../pricestore.h"
+#include "../analytics.h"
+#include "../backtest.h"
+#include "../config.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+const char* path = "backtest.db";
+const size_t Checked = 5;   // currencies compared with the live engine
+
+// Scratch database with the tables of the GUI and "days" of prices for every currency, every
+// currency followed with the default thresholds
+void create(size_t currencies, int days, double until)
+{
+    sqlite3* db;
+    for (const std::string &name : {std::string(path), std::string(path) + "-wal", std::string(path) + "-shm"})
+    {
+        std::remove(name.c_str());
+    }
+    sqlite3_open(path,&db);
+    sqlite3_exec(db,"CREATE TABLE Currencies (ID INTEGER PRIMARY KEY AUTOINCREMENT, GeckoID TEXT NOT NULL, name TEXT NOT NULL);"
+                    "CREATE TABLE Prices (priceID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, time DOUBLE NOT NULL, date TEXT NOT NULL, price REAL NOT NULL);"
+                    "CREATE TABLE Configs(alertID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, minimumData INTEGER NOT NULL, timeWindow REAL NOT NULL, gain REAL NOT NULL, longGain REAL NOT NULL, movingAvg TEXT NOT NULL, anomaly REAL NOT NULL);"
+                    "CREATE TABLE Mode(key INTEGER PRIMARY KEY AUTOINCREMENT, updateFreq REAL NOT NULL, mode TEXT NOT NULL, mail TEXT NOT NULL, password TEXT NOT NULL);"
+                    "CREATE TABLE Settings(name TEXT PRIMARY KEY, value TEXT NOT NULL);"
+                    "INSERT INTO Mode (updateFreq,mode,mail,password) VALUES (1,'local','','');"
+                    "BEGIN;",nullptr,nullptr,nullptr);
+    for (size_t c = 0; c < currencies; c++)
+    {
+        const std::string row = "INSERT INTO Currencies (GeckoID,name) VALUES ('coin-" + std::to_string(c) + "','coin-" + std::to_string(c) + "');";
+        sqlite3_exec(db,row.c_str(),nullptr,nullptr,nullptr);
+    }
+    sqlite3_exec(db,"COMMIT;",nullptr,nullptr,nullptr);
+    sqlite3_close(db);
+
+    Persistence prices;
+    prices.open(path);
+    std::vector<double> walks(currencies, 100);
+    std::mt19937_64 random(9);
+    std::normal_distribution<double> step(0, 0.004);
+    prices.begin();
+    for (int m = 1440*days - 1; m >= 0; m--)
+    {
+        for (size_t c = 0; c < currencies; c++)
+        {
+            walks[c] *= 1 + step(random);
+            prices.insert(static_cast<int>(c + 1), until - 60*m, walks[c]);
+        }
+    }
+    prices.commit();
+}
+
+// Alerts of the live engine run after every minute of prices, for the first "count" currencies
+long long live(Persistence &db, size_t count, int days, double until)
+{
+    Config followed = *config.get();
+    followed.currencies.resize(std::min(count, followed.currencies.size()));
+    PriceStore store;
+    Analytics engine(store, 1);
+    engine.configure(followed);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db.handle(),"SELECT CurrencyID,time,price FROM Prices WHERE CurrencyID <= ?1 ORDER BY time,CurrencyID;",-1,&stmt,nullptr);
+    sqlite3_bind_int(stmt,1,static_cast<int>(count));
+    long long alerts = 0;
+    double time = until - 60*(1440*days - 1);
+    bool pending = false;
+    while (true)
+    {
+        bool row = sqlite3_step(stmt) == SQLITE_ROW;
+        if (pending && (!row || sqlite3_column_double(stmt,1) != time))
+        {
+            int analysed;
+            alerts += engine.run(time, analysed).size();
+        }
+        if (!row)
+        {
+            break;
+        }
+        int id = sqlite3_column_int(stmt,0);
+        time = sqlite3_column_double(stmt,1);
+        store.push(id, time, sqlite3_column_double(stmt,2));
+        engine.add(id);
+        pending = true;
+    }
+    sqlite3_finalize(stmt);
+    return alerts;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 100;
+    int days = argc > 2 ? std::atoi(argv[2]) : 30;
+    if (currencies == 0 || days <= 0)
+    {
+        std::cerr << "Usage: backtest_bench [currencies] [days]" << std::endl;
+        return 1;
+    }
+
+    double now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto begin = std::chrono::steady_clock::now();
+    create(currencies, days, now);
+    Persistence db;
+    if (db.open(path) != 0)
+    {
+        std::cerr << "Couldn't open " << path << std::endl;
+        return 1;
+    }
+    double creating = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << currencies << " currencies, " << days << " days of prices every minute (" << currencies*1440*days << " rows, created in "
+              << std::fixed << std::setprecision(1) << creating << " s)" << std::endl;
+
+    std::ostringstream ignored;
+    std::vector<Outcome> outcomes;
+    Grid current;
+    if (backtest(db, nullptr, current, Hysteresis(), 0, ignored, &outcomes) != 0)
+    {
+        return 1;
+    }
+    long long swept = 0;
+    for (size_t c = 0; c < std::min(Checked, currencies); c++)
+    {
+        for (int signal = 0; signal < Signals; signal++)
+        {
+            swept += outcomes[c].alerts[signal];
+        }
+    }
+    long long reference = live(db, Checked, days, now);
+    bool same = swept == reference;
+    std::cout << "  check    " << std::min(Checked, currencies) << " currencies, backtest " << swept << " alerts, live engine " << reference
+              << " alerts: " << (same ? "same" : "ALERTS DIFFER") << std::endl;
+
+    Grid grid;
+    grid.parse({"timeWindow=2,5,24", "gain=1,2,5", "longGain=2,5,10", "movingAvg=0,1", "anomaly=90,95,99"});
+    double single = 0;
+    for (size_t threads : {static_cast<size_t>(1), static_cast<size_t>(0)})
+    {
+        begin = std::chrono::steady_clock::now();
+        std::ostringstream report;
+        backtest(db, nullptr, grid, Hysteresis(), threads, report);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        single = threads == 1 ? seconds : single;
+        std::string lines = report.str();
+        std::cout << "  sweep    " << std::setw(2) << (threads == 0 ? std::thread::hardware_concurrency() : threads) << " threads " << std::setw(7)
+                  << seconds << " s   speedup " << single/seconds << "   " << lines.substr(lines.find('\n') + 1, lines.find('\n', lines.find('\n') + 1) - lines.find('\n') - 1) << std::endl;
+    }
+    return same ? 0 : 1;
+}
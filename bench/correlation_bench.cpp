@@ -0,0 +1,268 @@
+/** ========================================================================================
+
+    Filename:  correlation_bench.cpp
+
+    Description:  Rolling correlations (correlation.cpp) of synthetic currencies driven by a
+                  market factor: the return of each one is beta times the return of the
+                  market plus noise of its own. One of them stops following the market in
+                  the last quarter of the window. Then:
+                    - time: one sample against one reference currency, one sample of the
+                      whole market in tiles, and the same means recomputed over the window
+                      for every pair
+                    - check: the correlations of both modes against the recomputed ones and
+                      a two pass recompute in long double
+                    - alert: Analytics fed one price per minute must say that the currency
+                      is decoupling, and nothing about the others
+
+                  Usage: bench/correlation_bench [currencies] [samples]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../analytics.h"
+#include "../kernels.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+const double Start = 1738000000;
+const size_t Decoupled = 7;   // column of the currency that stops following the market
+
+// Prices of every currency at every sample, the last quarter of the last window of "Decoupled"
+// is noise of its own
+std::vector<std::vector<double>> walks(size_t currencies, size_t ticks, size_t samples)
+{
+    std::mt19937_64 random(5);
+    std::normal_distribution<double> market(0, 0.01);
+    std::normal_distribution<double> noise(0, 0.002);
+    std::uniform_real_distribution<double> beta(0.8, 1.2);
+    std::vector<double> betas(currencies);
+    for (double &b : betas)
+    {
+        b = beta(random);
+    }
+    std::vector<std::vector<double>> prices(currencies, std::vector<double>(ticks, 0));
+    for (size_t c = 0; c < currencies; c++)
+    {
+        prices[c][0] = 100;
+    }
+    for (size_t t = 1; t < ticks; t++)
+    {
+        double factor = market(random);
+        for (size_t c = 0; c < currencies; c++)
+        {
+            bool alone = c == Decoupled && t >= ticks - samples/4;
+            double change = alone ? 5*noise(random) : betas[c]*factor + noise(random);
+            prices[c][t] = prices[c][t - 1]*(1 + change);
+        }
+    }
+    return prices;
+}
+
+// Two pass correlation of the returns of "a" and "b" over the "count" samples that end at "tick"
+double pearson(const std::vector<std::vector<double>> &prices, size_t a, size_t b, size_t tick, size_t count)
+{
+    long double x[2] = {}, xx[2] = {}, xy = 0;
+    std::vector<long double> ra(count), rb(count);
+    for (size_t k = 0; k < count; k++)
+    {
+        size_t t = tick + 1 - count + k;
+        ra[k] = (static_cast<long double>(prices[a][t]) - prices[a][t - 1])/prices[a][t - 1];
+        rb[k] = (static_cast<long double>(prices[b][t]) - prices[b][t - 1])/prices[b][t - 1];
+        x[0] += ra[k];
+        x[1] += rb[k];
+    }
+    x[0] /= count;
+    x[1] /= count;
+    for (size_t k = 0; k < count; k++)
+    {
+        xx[0] += (ra[k] - x[0])*(ra[k] - x[0]);
+        xx[1] += (rb[k] - x[1])*(rb[k] - x[1]);
+        xy += (ra[k] - x[0])*(rb[k] - x[1]);
+    }
+    return static_cast<double>(xy/std::sqrt(xx[0]*xx[1]));
+}
+
+// Mean correlation of "a" with every other currency
+double marketPearson(const std::vector<std::vector<double>> &prices, size_t a, size_t tick, size_t count)
+{
+    double total = 0;
+    for (size_t b = 0; b < prices.size(); b++)
+    {
+        total += b == a ? 0 : pearson(prices, a, b, tick, count);
+    }
+    return total/(prices.size() - 1);
+}
+
+// Mean correlation of every currency with the others over the "count" samples that end at
+// "tick", recomputed from the returns for every pair: the O(window x N^2) way
+void recompute(const std::vector<std::vector<double>> &prices, size_t tick, size_t count, std::vector<double> &means)
+{
+    const size_t n = prices.size();
+    std::vector<double> centered(n*count), norms(n);
+    for (size_t c = 0; c < n; c++)
+    {
+        double* row = &centered[c*count];
+        double mean = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+            size_t t = tick + 1 - count + k;
+            row[k] = (prices[c][t] - prices[c][t - 1])/prices[c][t - 1];
+            mean += row[k]/count;
+        }
+        double squares = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+            row[k] -= mean;
+            squares += row[k]*row[k];
+        }
+        norms[c] = 1/std::sqrt(squares);
+    }
+    means.assign(n, 0);
+    for (size_t a = 0; a < n; a++)
+    {
+        for (size_t b = a + 1; b < n; b++)
+        {
+            double products = 0;
+            for (size_t k = 0; k < count; k++)
+            {
+                products += centered[a*count + k]*centered[b*count + k];
+            }
+            double value = products*norms[a]*norms[b];
+            means[a] += value/(n - 1);
+            means[b] += value/(n - 1);
+        }
+    }
+}
+
+// Feeds the first "ticks" samples, times the last "timed" of them and returns the seconds per sample
+double feed(Correlations &correlations, const std::vector<std::vector<double>> &prices, size_t ticks, size_t timed)
+{
+    std::vector<double> last(prices.size());
+    std::chrono::duration<double> elapsed(0);
+    for (size_t t = 0; t < ticks; t++)
+    {
+        for (size_t c = 0; c < prices.size(); c++)
+        {
+            last[c] = prices[c][t];
+        }
+        auto begin = std::chrono::steady_clock::now();
+        correlations.sample(Start + 60*t, last);
+        elapsed += t + timed >= ticks ? std::chrono::steady_clock::now() - begin : std::chrono::steady_clock::duration(0);
+    }
+    return elapsed.count()/timed;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 1000;
+    size_t samples = argc > 2 ? std::atoi(argv[2]) : 48;
+    if (currencies <= Decoupled || samples < 4)
+    {
+        std::cerr << "Usage: correlation_bench [currencies > " << Decoupled << "] [samples >= 4]" << std::endl;
+        return 1;
+    }
+    const size_t ticks = 2*samples + 1;
+    const size_t timed = samples;
+    const size_t quarter = samples/4;
+    std::vector<std::vector<double>> prices = walks(currencies, ticks, samples);
+    std::vector<int> ids(currencies);
+    for (size_t c = 0; c < currencies; c++)
+    {
+        ids[c] = static_cast<int>(c + 1);
+    }
+    std::cout << currencies << " currencies, windows of " << samples << " and " << quarter << " samples, " << kernels().name << " kernels" << std::endl;
+
+    // Time
+    Correlations reference, market;
+    reference.configure(ids, {1}, samples, 60);
+    market.configure(ids, {}, samples, 60);
+    double referenceSeconds = feed(reference, prices, ticks, timed);
+    double marketSeconds = feed(market, prices, ticks, timed);
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<double> naive, recentNaive;
+    recompute(prices, ticks - 1, samples, naive);
+    recompute(prices, ticks - 1, quarter, recentNaive);
+    double naiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << std::fixed << std::setprecision(3)
+              << "  time     reference " << std::setw(10) << 1e3*referenceSeconds << " ms/sample" << std::endl
+              << "           market    " << std::setw(10) << 1e3*marketSeconds << " ms/sample" << std::endl
+              << "           recompute " << std::setw(10) << 1e3*naiveSeconds << " ms/sample   market is " << std::setprecision(1)
+              << naiveSeconds/marketSeconds << "x faster" << std::endl;
+
+    // Check, every currency against the reference and the recomputed means, the first few against
+    // the market in long double
+    double referenceError = 0, marketError = 0;
+    for (size_t c = 0; c < currencies; c++)
+    {
+        if (c != 0)
+        {
+            referenceError = std::max(referenceError, std::fabs(reference.longer(c, 0) - pearson(prices, c, 0, ticks - 1, samples)));
+            referenceError = std::max(referenceError, std::fabs(reference.recent(c, 0) - pearson(prices, c, 0, ticks - 1, quarter)));
+        }
+        marketError = std::max(marketError, std::fabs(market.longer(c, 0) - naive[c]));
+        marketError = std::max(marketError, std::fabs(market.recent(c, 0) - recentNaive[c]));
+        if (c <= Decoupled)
+        {
+            marketError = std::max(marketError, std::fabs(market.longer(c, 0) - marketPearson(prices, c, ticks - 1, samples)));
+            marketError = std::max(marketError, std::fabs(market.recent(c, 0) - marketPearson(prices, c, ticks - 1, quarter)));
+        }
+    }
+    bool exact = referenceError < 1e-9 && marketError < 1e-9;
+    std::cout << std::scientific << std::setprecision(2) << "  check    largest error, reference " << referenceError << ", market " << marketError
+              << ": " << (exact ? "same" : "CORRELATIONS DIFFER") << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "           " << "coin-" << Decoupled << " with the market " << market.longer(Decoupled, 0) << " -> "
+              << market.recent(Decoupled, 0) << ", with coin-0 " << reference.longer(Decoupled, 0) << " -> " << reference.recent(Decoupled, 0) << std::endl;
+
+    // Alert, through Analytics with a decoupling threshold of 0.5 for every currency
+    bool alerted = true;
+    for (const std::vector<std::string> &partners : {std::vector<std::string>{"coin-0"}, std::vector<std::string>{"all"}})
+    {
+        Config config;
+        for (size_t c = 0; c < currencies; c++)
+        {
+            CurrencyConfig currency;
+            currency.id = ids[c];
+            currency.name = "coin-" + std::to_string(c);
+            currency.gecko = currency.name;
+            currency.limits.decoupling = 0.5;
+            config.currencies.push_back(currency);
+        }
+        PriceStore store;
+        Analytics engine(store, 1);
+        engine.correlate(partners, samples, 1);
+        engine.configure(config);
+        const std::string expected = "coin-" + std::to_string(Decoupled) + " may be decoupling";
+        size_t right = 0, wrong = 0;
+        for (size_t t = 0; t < ticks; t++)
+        {
+            for (size_t c = 0; c < currencies; c++)
+            {
+                store.push(ids[c], Start + 60*t, prices[c][t]);
+                engine.add(ids[c]);
+            }
+            int analysed;
+            for (const std::string &alert : engine.run(Start + 60*t, analysed))
+            {
+                if (alert.find("decoupling") != std::string::npos)
+                {
+                    (alert.find(expected) != std::string::npos ? right : wrong)++;
+                }
+            }
+        }
+        alerted = alerted && right > 0 && wrong == 0;
+        std::cout << "  alert    " << std::left << std::setw(10) << partners[0] << std::right << right << " alerts for coin-" << Decoupled
+                  << ", " << wrong << " for the others" << std::endl;
+    }
+    return exact && alerted ? 0 : 1;
+}
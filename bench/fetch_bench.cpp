@@ -0,0 +1,317 @@
+/** ========================================================================================
+
+    Filename:  fetch_bench.cpp
+
+    Description:  Failures of single chunks of the /simple/price requests, without CoinGecko.
+                  A local HTTP server answers each chunk of Fetcher as the plan of the round
+                  says: with the prices, a 429 rate limit, a 500 error, a closed connection or
+                  a body cut in the middle. Every round goes through API() -> update() ->
+                  pipeline, then the Prices saved are checked: the currencies of the healthy
+                  chunks must have the price of the round, those of the failed chunks must not,
+                  and API() must fail only in the round where every chunk fails (exit code 1
+                  if not). Runs in a scratch fetch.db and log.txt of the working directory.
+
+                  Usage: bench/fetch_bench
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../headers.h"
+#include "../persistence.h"
+#include "../fetch.h"
+#include "../scheduler.h"
+#include "../pricestore.h"
+#include "../analytics.h"
+#include "../pipeline.h"
+#include "../logger.h"
+#include "../config.h"
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+const char* path = "fetch.db";
+const size_t Coins = 10;
+const size_t ChunkSize = 4;   // chunks of 4, 4 and 2 currencies
+
+// What the server does with the request of a chunk
+enum Fault { Healthy, Limited, Down, Dropped, Truncated };
+const char* FaultNames[] = {"healthy", "429", "500", "dropped", "truncated"};
+
+// Faults of the 3 chunks in each round
+const std::vector<std::vector<Fault>> Plan = {
+    {Healthy, Healthy, Healthy},
+    {Healthy, Limited, Healthy},
+    {Down, Healthy, Dropped},
+    {Healthy, Truncated, Healthy},
+    {Limited, Down, Truncated},
+    {Dropped, Dropped, Dropped},
+    {Healthy, Healthy, Healthy}};
+
+double price(size_t round, size_t coin)
+{
+    return 1 + round + coin/100.0;
+}
+
+// HTTP/1.1 server on 127.0.0.1, one thread per connection. The chunk of a request is told by the
+// position of its first id.
+class Server
+{
+public:
+    Server(const std::vector<std::string> &names) : names(names)
+    {
+        for (size_t c = 0; c < names.size(); c++)
+        {
+            index[names[c]] = c;
+        }
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(listener, 64);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+        acceptor = std::thread(&Server::accept, this);
+    }
+
+    ~Server()
+    {
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        acceptor.join();
+        std::lock_guard<std::mutex> guard(lock);
+        for (int client : clients)
+        {
+            shutdown(client, SHUT_RDWR);
+        }
+        for (std::thread &connection : connections)
+        {
+            connection.join();
+        }
+    }
+
+    void show(size_t round, double time)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        current = round;
+        now = time;
+    }
+
+    int port;
+
+private:
+    void accept()
+    {
+        int client;
+        while ((client = ::accept(listener, nullptr, nullptr)) >= 0)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            clients.push_back(client);
+            connections.emplace_back(&Server::serve, this, client);
+        }
+    }
+
+    void serve(int client)
+    {
+        std::string request;
+        char buffer[65536];
+        ssize_t received;
+        while ((received = recv(client, buffer, sizeof(buffer), 0)) > 0)
+        {
+            request.append(buffer, received);
+            size_t end;
+            while ((end = request.find("\r\n\r\n")) != std::string::npos)
+            {
+                std::string reply;
+                if (!answer(request.substr(0, end), reply))
+                {
+                    close(client);
+                    return;
+                }
+                for (size_t sent = 0; sent < reply.size(); )
+                {
+                    ssize_t written = send(client, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                    if (written <= 0)
+                    {
+                        close(client);
+                        return;
+                    }
+                    sent += written;
+                }
+                request.erase(0, end + 4);
+            }
+        }
+        close(client);
+    }
+
+    // Reply to "GET /simple/price?ids=a%2Cb&vs_currencies=usd...", false to close the connection
+    bool answer(const std::string &head, std::string &reply)
+    {
+        std::vector<size_t> ids;
+        size_t begin = head.find("ids=") + 4;
+        size_t end = head.find_first_of("& ", begin);
+        std::string list = head.substr(begin, end - begin);
+        for (size_t at = 0; at <= list.size(); )
+        {
+            size_t next = list.find("%2C", at);
+            next = next == std::string::npos ? list.size() : next;
+            auto found = index.find(list.substr(at, next - at));
+            if (found != index.end())
+            {
+                ids.push_back(found->second);
+            }
+            at = next + 3;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        Fault fault = ids.empty() ? Down : Plan[current][ids.front()/ChunkSize];
+        std::string status = "200 OK", body = "{";
+        for (size_t c : ids)
+        {
+            char values[96];
+            std::snprintf(values, sizeof(values), "\":{\"usd\":%.10g,\"last_updated_at\":%lld}", price(current, c), static_cast<long long>(now));
+            body += (body.size() > 1 ? ",\"" : "\"") + names[c] + values;
+        }
+        body += "}";
+        switch (fault)
+        {
+        case Healthy:
+            break;
+        case Limited:
+            status = "429 Too Many Requests";
+            body = "{\"status\":{\"error_code\":429,\"error_message\":\"You've exceeded the Rate Limit.\"}}";
+            break;
+        case Down:
+            status = "500 Internal Server Error";
+            body = "{\"error\":\"internal error\"}";
+            break;
+        case Dropped:
+            return false;
+        case Truncated:
+            body = body.substr(0, body.size()/2 + 20);   // a few prices, then the end of the stream
+            break;
+        }
+        reply = "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        return true;
+    }
+
+    const std::vector<std::string> &names;
+    std::unordered_map<std::string, size_t> index;
+    int listener;
+    std::thread acceptor;
+    std::mutex lock;
+    std::vector<int> clients;
+    std::vector<std::thread> connections;
+    size_t current = 0;
+    double now = 0;
+};
+
+// Scratch database with the tables of the GUI, every currency followed with the default thresholds
+void create(const std::vector<std::string> &names, int port)
+{
+    sqlite3* db;
+    std::remove(path);
+    std::remove((std::string(path) + "-wal").c_str());
+    std::remove((std::string(path) + "-shm").c_str());
+    sqlite3_open(path,&db);
+    sqlite3_exec(db,"CREATE TABLE Currencies (ID INTEGER PRIMARY KEY AUTOINCREMENT, GeckoID TEXT NOT NULL, name TEXT NOT NULL);"
+                    "CREATE TABLE Prices (priceID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, time DOUBLE NOT NULL, date TEXT NOT NULL, price REAL NOT NULL);"
+                    "CREATE TABLE Configs(alertID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, minimumData INTEGER NOT NULL, timeWindow REAL NOT NULL, gain REAL NOT NULL, longGain REAL NOT NULL, movingAvg TEXT NOT NULL, anomaly REAL NOT NULL);"
+                    "CREATE TABLE Mode(key INTEGER PRIMARY KEY AUTOINCREMENT, updateFreq REAL NOT NULL, mode TEXT NOT NULL, mail TEXT NOT NULL, password TEXT NOT NULL);"
+                    "CREATE TABLE Settings(name TEXT PRIMARY KEY, value TEXT NOT NULL);"
+                    "INSERT INTO Mode (updateFreq,mode,mail,password) VALUES (1,'local','','');"
+                    "BEGIN;",nullptr,nullptr,nullptr);
+    for (const std::string &name : names)
+    {
+        const std::string row = "INSERT INTO Currencies (GeckoID,name) VALUES ('" + name + "','" + name + "');";
+        sqlite3_exec(db,row.c_str(),nullptr,nullptr,nullptr);
+    }
+    const std::string settings = "INSERT INTO Settings VALUES ('apiUrl','http://127.0.0.1:" + std::to_string(port) + "'),('chunkSize','" + std::to_string(ChunkSize) + "'),"
+                                 "('backfill','0');";
+    sqlite3_exec(db,settings.c_str(),nullptr,nullptr,nullptr);
+    sqlite3_exec(db,"COMMIT;",nullptr,nullptr,nullptr);
+    sqlite3_close(db);
+}
+
+int main()
+{
+    std::vector<std::string> names;
+    for (size_t c = 0; c < Coins; c++)
+    {
+        names.push_back("coin-" + std::to_string(c));
+    }
+    Server server(names);
+    create(names, server.port);
+
+    Persistence db;
+    Fetcher api;
+    Scheduler schedule;
+    PriceStore store;
+    Analytics engine(store);
+    if (db.open(path) != 0 || config.refresh(db) < 0 || store.load(db.handle()) != 0)
+    {
+        std::cerr << "Couldn't open " << path << std::endl;
+        return 1;
+    }
+    db.refresh();
+    engine.configure(*config.get());
+    logger.configure(db);
+    api.configure(db);
+    schedule.configure(db, 0);
+    Pipeline pipeline(store, engine, schedule, 64);
+    pipeline.start(path);
+
+    // API() of every round, the prices are checked once the pipeline saved them
+    double start = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() - 60.0*Plan.size();
+    std::vector<int> results;
+    for (size_t round = 0; round < Plan.size(); round++)
+    {
+        server.show(round, start + 60.0*round);
+        results.push_back(API(db, api, schedule, names, pipeline, "local"));
+    }
+    pipeline.stop();
+
+    size_t skipped = 0, invented = 0, calls = 0;
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db.handle(),"SELECT COUNT(*) FROM Prices WHERE CurrencyID = ?1 AND time = ?2 AND price = ?3;",-1,&stmt,nullptr);
+    for (size_t round = 0; round < Plan.size(); round++)
+    {
+        size_t saved = 0, healthy = 0;
+        bool failed = true;
+        for (size_t c = 0; c < Coins; c++)
+        {
+            bool expected = Plan[round][c/ChunkSize] == Healthy;
+            sqlite3_bind_int(stmt,1,db.id(names[c]));
+            sqlite3_bind_double(stmt,2,start + 60.0*round);
+            sqlite3_bind_double(stmt,3,price(round, c));
+            bool found = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt,0) > 0;
+            sqlite3_reset(stmt);
+            skipped += expected && !found;
+            invented += !expected && found;
+            saved += found;
+            healthy += expected;
+            failed = failed && !expected;
+        }
+        bool right = failed ? results[round] == -1 : results[round] == static_cast<int>(healthy);
+        calls += !right;
+        std::printf("  round %zu  %-9s %-9s %-9s  API() %3d, %2zu of %2zu prices saved%s\n", round, FaultNames[Plan[round][0]], FaultNames[Plan[round][1]],
+                    FaultNames[Plan[round][2]], results[round], saved, healthy, right ? "" : "  WRONG RESULT");
+    }
+    sqlite3_finalize(stmt);
+    bool same = skipped == 0 && invented == 0 && calls == 0;
+    std::printf("Healthy chunks skipped %zu, failed chunks saved %zu, wrong results %zu: %s\n", skipped, invented, calls, same ? "same" : "CHUNKS DIFFER");
+    return same ? 0 : 1;
+}
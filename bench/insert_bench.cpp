@@ -0,0 +1,176 @@
+/** ========================================================================================
+
+    Filename:  insert_bench.cpp
+
+    Description:  Microbenchmark of the writes done by update() on every API call. Compares
+                  the old path (statements prepared for every row, one query per GeckoID and
+                  one autocommit transaction per INSERT) with Persistence (statements prepared
+                  once, cached IDs and one transaction per call) on a scratch database, and
+                  with the binary journal (journal.cpp) in a scratch directory. The disk used
+                  per row counts the blocks allocated to the files.
+
+                  Usage: bench/insert_bench [currencies] [calls]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../headers.h"
+#include "../persistence.h"
+#include "../journal.h"
+#include "../pipeline.h"
+#include <sys/stat.h>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+const char* path = "insert_bench.db";
+const char* directory = "insert_bench.journal";
+
+// Bytes allocated on disk to a file, 0 if it does not exist
+double allocated(const std::string &file)
+{
+    struct stat info;
+    return stat(file.c_str(), &info) == 0 ? 512.0*info.st_blocks : 0;
+}
+
+// Empty database with the tables used by update()
+void create(int currencies)
+{
+    sqlite3* db;
+    std::remove(path);
+    sqlite3_open(path,&db);
+    sqlite3_exec(db,"CREATE TABLE Currencies (ID INTEGER PRIMARY KEY AUTOINCREMENT, GeckoID TEXT NOT NULL, name TEXT NOT NULL);"
+                    "CREATE TABLE Prices (priceID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, time DOUBLE NOT NULL, date TEXT NOT NULL, price REAL NOT NULL);"
+                    "BEGIN;",nullptr,nullptr,nullptr);
+    for (int i = 0; i < currencies; i++)
+    {
+        const std::string row = "INSERT INTO Currencies (GeckoID,name) VALUES ('coin" + std::to_string(i) + "','Coin " + std::to_string(i) + "');";
+        sqlite3_exec(db,row.c_str(),nullptr,nullptr,nullptr);
+    }
+    sqlite3_exec(db,"COMMIT;",nullptr,nullptr,nullptr);
+    sqlite3_close(db);
+}
+
+// Writes as update() did before Persistence
+double before(int currencies, int calls)
+{
+    const char* Statement = "INSERT INTO Prices (\"CurrencyID\",\"time\",\"date\",\"price\") VALUES (?,?,?,?);";
+    const char* nameCheck = "SELECT ID FROM Currencies WHERE GeckoID = ?;";
+    const char* Check = "SELECT * FROM Prices WHERE CurrencyID = ? ORDER BY PriceID DESC LIMIT 1;";
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+
+    create(currencies);
+    sqlite3_open(path,&db);
+    auto start = std::chrono::steady_clock::now();
+    for (int call = 0; call < calls; call++)
+    {
+        for (int i = 0; i < currencies; i++)
+        {
+            const std::string name = "coin" + std::to_string(i);
+            sqlite3_prepare_v2(db,nameCheck,-1,&stmt,nullptr);
+            sqlite3_bind_text(stmt,1,name.c_str(),name.size(),nullptr);
+            sqlite3_step(stmt);
+            int id = sqlite3_column_int(stmt,0);
+            sqlite3_finalize(stmt);
+
+            sqlite3_prepare_v2(db,Check,-1,&stmt,nullptr);
+            sqlite3_bind_int(stmt,1,id);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+
+            sqlite3_prepare_v2(db,Statement,-1,&stmt,nullptr);
+            sqlite3_bind_int(stmt,1,id);
+            sqlite3_bind_double(stmt,2,1738000000 + call);
+            sqlite3_bind_text(stmt,3,"2025-01-27 12:00:00",19,nullptr);
+            sqlite3_bind_double(stmt,4,100 + call);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    sqlite3_close(db);
+    return currencies*calls/elapsed.count();
+}
+
+// Writes through Persistence
+double after(int currencies, int calls)
+{
+    Persistence db;
+
+    create(currencies);
+    db.open(path);
+    auto start = std::chrono::steady_clock::now();
+    for (int call = 0; call < calls; call++)
+    {
+        db.begin();
+        for (int i = 0; i < currencies; i++)
+        {
+            db.insert(db.id("coin" + std::to_string(i)),1738000000 + call,100 + call);
+        }
+        db.commit();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    db.close();
+    std::cout << "(" << (allocated(path) + allocated(std::string(path) + "-wal"))/(currencies*calls) << " bytes/row) ";
+    return currencies*calls/elapsed.count();
+}
+
+// Appends to the journal, one commit per call
+double journal(int currencies, int calls)
+{
+    Journal prices(directory, 60);
+    PriceBatch batch;
+    for (int i = 0; i < currencies; i++)
+    {
+        batch.ids.push_back(i + 1);
+    }
+    batch.times.resize(currencies);
+    batch.prices.resize(currencies);
+
+    prices.open(path);
+    auto start = std::chrono::steady_clock::now();
+    for (int call = 0; call < calls; call++)
+    {
+        std::fill(batch.times.begin(), batch.times.end(), 1738000000 + 60*call);
+        std::fill(batch.prices.begin(), batch.prices.end(), 100 + call);
+        prices.append(batch);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    prices.checkpoint();
+    double bytes = 0;
+    for (int i = 0; i < currencies; i++)
+    {
+        bytes += allocated(std::string(directory) + "/" + std::to_string(i + 1) + ".bin");
+    }
+    std::cout << "(" << bytes/(currencies*calls) << " bytes/row) ";
+    return currencies*calls/elapsed.count();
+}
+
+int main(int argc, char* argv[])
+{
+    int currencies = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int calls = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::cout << "Inserting " << currencies << " currencies x " << calls << " API calls" << std::endl;
+    std::cout << "before: " << before(currencies,calls) << " rows/sec" << std::endl;
+    std::cout << "after:  " << after(currencies,calls) << " rows/sec" << std::endl;
+    std::cout << "journal: " << journal(currencies,calls) << " rows/sec" << std::endl;
+    for (int i = 0; i < currencies; i++)
+    {
+        std::remove((std::string(directory) + "/" + std::to_string(i + 1) + ".bin").c_str());
+    }
+    std::remove(directory);
+    std::remove(path);
+    std::remove((std::string(path) + "-wal").c_str());
+    std::remove((std::string(path) + "-shm").c_str());
+    return 0;
+}
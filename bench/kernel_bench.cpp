@@ -0,0 +1,155 @@
+/** ========================================================================================
+
+    Filename:  kernel_bench.cpp
+
+    Description:  Validation and benchmark of the window kernels (kernels.cpp). Builds a batch
+                  of synthetic currencies in struct of arrays layout, one contiguous block of
+                  prices each with scales from 1e-4 to 1e5, and runs every kernel version the
+                  CPU supports over all of them. Results are compared with a two pass reference
+                  in long double that follows pandas: mean(), std() with ddof=1, min(), max()
+                  and pct_change().
+
+                  Usage: bench/kernel_bench [currencies] [prices]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../kernels.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+struct Reference
+{
+    long double mean = 0;
+    long double std = 0;
+    long double min = 0;
+    long double max = 0;
+};
+
+// Two pass statistics of one currency, as pandas computes them
+Reference reference(const double* prices, size_t count)
+{
+    Reference result;
+    result.min = result.max = prices[0];
+    for (size_t i = 0; i < count; i++)
+    {
+        result.mean += prices[i];
+        result.min = std::min<long double>(result.min, prices[i]);
+        result.max = std::max<long double>(result.max, prices[i]);
+    }
+    result.mean /= count;
+    for (size_t i = 0; i < count; i++)
+    {
+        result.std += (prices[i] - result.mean)*(prices[i] - result.mean);
+    }
+    result.std = std::sqrt(result.std/(count - 1));
+    return result;
+}
+
+double relative(long double value, long double expected)
+{
+    long double scale = std::max(std::abs(expected), 1e-300L);
+    return static_cast<double>(std::abs(value - expected)/scale);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 10000;
+    size_t length = argc > 2 ? std::atoi(argv[2]) : 300;
+    const int repetitions = 20;
+    if (currencies == 0 || length < 2)
+    {
+        std::cerr << "Usage: kernel_bench [currencies] [prices], at least 1 currency and 2 prices" << std::endl;
+        return 1;
+    }
+
+    // Random walks, each currency in its own block of "length" prices
+    std::mt19937_64 random(42);
+    std::normal_distribution<double> step(0, 0.002);
+    std::uniform_real_distribution<double> exponent(-4, 5);
+    std::vector<double> prices(currencies*length);
+    for (size_t c = 0; c < currencies; c++)
+    {
+        double price = std::pow(10, exponent(random));
+        for (size_t i = 0; i < length; i++)
+        {
+            price *= 1 + step(random);
+            prices[c*length + i] = price;
+        }
+    }
+
+    std::vector<Reference> expected(currencies);
+    for (size_t c = 0; c < currencies; c++)
+    {
+        expected[c] = reference(&prices[c*length], length);
+    }
+
+    std::cout << currencies << " currencies of " << length << " prices, best kernels: " << kernels().name << std::endl;
+    std::vector<double> returns(length - 1);
+    int failed = 0;
+    for (const KernelSet* set : supportedKernels())
+    {
+        double errorMean = 0, errorStd = 0, errorReturns = 0;
+        bool extremes = true;
+        for (size_t c = 0; c < currencies; c++)
+        {
+            const double* series = &prices[c*length];
+            Moments moments = set->moments(series, length, series[0]);
+            double mean = series[0] + moments.sum/length;
+            double std = std::sqrt(std::max(0.0, (moments.sumSq - moments.sum*moments.sum/length)/(length - 1)));
+            errorMean = std::max(errorMean, relative(mean, expected[c].mean));
+            errorStd = std::max(errorStd, relative(std, expected[c].std));
+            extremes = extremes && moments.min == expected[c].min && moments.max == expected[c].max;
+
+            set->returns(series, length, returns.data());
+            for (size_t i = 0; i + 1 < length; i++)
+            {
+                long double change = (static_cast<long double>(series[i + 1]) - series[i])/series[i];
+                errorReturns = std::max(errorReturns, relative(returns[i], change));
+            }
+        }
+
+        double checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
+        {
+            for (size_t c = 0; c < currencies; c++)
+            {
+                checksum += set->moments(&prices[c*length], length, prices[c*length]).sumSq;
+            }
+        }
+        std::chrono::duration<double> moments = std::chrono::steady_clock::now() - start;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
+        {
+            for (size_t c = 0; c < currencies; c++)
+            {
+                set->returns(&prices[c*length], length, returns.data());
+                checksum += returns[0];
+            }
+        }
+        std::chrono::duration<double> changes = std::chrono::steady_clock::now() - start;
+
+        bool valid = errorMean < 1e-12 && errorStd < 1e-9 && errorReturns < 1e-12 && extremes;
+        failed += !valid;
+        std::cout << std::left << std::setw(8) << set->name << std::right << std::fixed << std::setprecision(3)
+                  << " moments " << std::setw(8) << 1e3*moments.count()/repetitions << " ms"
+                  << "  returns " << std::setw(8) << 1e3*changes.count()/repetitions << " ms"
+                  << std::scientific << std::setprecision(1)
+                  << "  max relative error: mean " << errorMean << " std " << errorStd << " returns " << errorReturns
+                  << (extremes ? "" : ", min/max differ") << (valid ? "  ok" : "  FAILED")
+                  << std::defaultfloat << "  (checksum " << checksum << ")" << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
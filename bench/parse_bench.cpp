@@ -0,0 +1,110 @@
+/** ========================================================================================
+
+    Filename:  parse_bench.cpp
+
+    Description:  Benchmark of the extraction of prices from a synthetic /simple/price
+                  response. Compares the old substring search, which looked for every GeckoID
+                  in the whole response and copied its tail, with PriceParser fed in 16 KB
+                  pieces as curl would deliver them.
+
+                  Usage: bench/parse_bench [currencies]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../parser.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+// Response with the format of CoinGecko for "currencies" GeckoIDs
+std::string response(const std::vector<std::string> &names)
+{
+    std::string body = "{";
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        body += "\"" + names[i] + "\":{\"usd\":" + std::to_string(100 + i*0.37) + ",\"last_updated_at\":" + std::to_string(1738000000 + i) + "}";
+        body += i + 1 < names.size() ? "," : "}";
+    }
+    return body;
+}
+
+// Extraction as done by API() before PriceParser
+double before(const std::vector<std::string> &names, const std::string &Data, int repetitions)
+{
+    const std::string currency = "usd";
+    std::vector<double> time, price;
+    std::string subresponse;
+    size_t begin, end;
+    double checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++)
+    {
+        time.clear();
+        price.clear();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (Data.find("\"" + names[i] + "\"") == std::string::npos)
+            {
+                continue;
+            }
+            subresponse = Data.substr(Data.find(names[i]));
+            begin = subresponse.find(currency);
+            begin = subresponse.find_first_of("0123456789.",begin);
+            end = subresponse.find_first_not_of("0123456789.",begin);
+            price.push_back(std::stod(subresponse.substr(begin,end-begin)));
+            begin = subresponse.find_first_of("0123456789.",end);
+            time.push_back(std::stod(subresponse.substr(begin, subresponse.find_first_not_of("0123456789.",begin)-begin)));
+        }
+        checksum += price.back();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "(checksum " << checksum << ") ";
+    return elapsed.count()/repetitions;
+}
+
+// Extraction with PriceParser
+double after(const std::vector<std::string> &names, const std::string &Data, int repetitions)
+{
+    const size_t piece = 16384;
+    std::vector<double> time(names.size()), price(names.size());
+    std::vector<char> found(names.size());
+    double checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++)
+    {
+        PriceParser parser(names, 0, names.size(), "usd", price.data(), time.data(), found.data());
+        for (size_t i = 0; i < Data.size(); i += piece)
+        {
+            parser.feed(std::string_view(Data).substr(i, piece));
+        }
+        checksum += price.back();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "(checksum " << checksum << ") ";
+    return elapsed.count()/repetitions;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 10000;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < currencies; i++)
+    {
+        names.push_back("coin-" + std::to_string(i) + "-token");
+    }
+    const std::string Data = response(names);
+
+    std::cout << "Parsing " << currencies << " currencies, " << Data.size() << " bytes" << std::endl;
+    std::cout << "before: " << 1000*before(names, Data, 1) << " ms per response" << std::endl;
+    std::cout << "after:  " << 1000*after(names, Data, 100) << " ms per response" << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+/** ========================================================================================
+
+    Filename:  quantile_bench.cpp
+
+    Description:  Benchmark of the percentile anomaly test over a sliding window. Compares the
+                  sort of the whole window done by describe() in Analysis.py, the order
+                  statistic tree of pb_ds used before, and SlidingQuantiles with the two
+                  percentiles tracked, for one new and one evicted price per tick. Every tick
+                  the three must agree, prices are rounded so there are many ties.
+
+                  Usage: bench/quantile_bench [window] [ticks]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../quantiles.h"
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+typedef __gnu_pbds::tree<std::pair<double,size_t>, __gnu_pbds::null_type, std::less<std::pair<double,size_t>>,
+                         __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update> OrderedPrices;
+
+const double Anomaly = 0.95;
+
+// Interpolation of pandas describe() over sorted prices
+double interpolate(double q, size_t n, double low, double high)
+{
+    double position = q*(n - 1);
+    return low + (position - std::floor(position))*(high - low);
+}
+
+double sorted(const std::vector<double> &window, double q)
+{
+    size_t below = static_cast<size_t>(std::floor(q*(window.size() - 1)));
+    return interpolate(q, window.size(), window[below], window[std::min(below + 1, window.size() - 1)]);
+}
+
+double tree(const OrderedPrices &ordered, double q)
+{
+    size_t below = static_cast<size_t>(std::floor(q*(ordered.size() - 1)));
+    size_t above = std::min(below + 1, ordered.size() - 1);
+    return interpolate(q, ordered.size(), ordered.find_by_order(below)->first, ordered.find_by_order(above)->first);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t window = argc > 1 ? std::atoi(argv[1]) : 300;
+    size_t ticks = argc > 2 ? std::atoi(argv[2]) : 20000;
+    if (window < 2 || ticks == 0)
+    {
+        std::cerr << "Usage: quantile_bench [window] [ticks], a window of at least 2 prices" << std::endl;
+        return 1;
+    }
+
+    // Random walk rounded to cents
+    std::mt19937_64 random(7);
+    std::normal_distribution<double> step(0, 0.05);
+    std::vector<double> prices(window + ticks);
+    double price = 100;
+    for (double &value : prices)
+    {
+        price = std::max(1.0, price + step(random));
+        value = std::round(price*100)/100;
+    }
+
+    std::vector<double> expectedHigh(ticks), expectedLow(ticks);
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> copy;
+    for (size_t t = 0; t < ticks; t++)
+    {
+        copy.assign(prices.begin() + t + 1, prices.begin() + t + 1 + window);
+        std::sort(copy.begin(), copy.end());
+        expectedHigh[t] = sorted(copy, Anomaly);
+        expectedLow[t] = sorted(copy, 1 - Anomaly);
+    }
+    std::chrono::duration<double> sorting = std::chrono::steady_clock::now() - start;
+
+    OrderedPrices ordered;
+    for (size_t i = 0; i < window; i++)
+    {
+        ordered.insert(std::make_pair(prices[i], i));
+    }
+    start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < ticks; t++)
+    {
+        ordered.erase(std::make_pair(prices[t], t));
+        ordered.insert(std::make_pair(prices[t + window], t + window));
+        checksum += tree(ordered, Anomaly) + tree(ordered, 1 - Anomaly);
+    }
+    std::chrono::duration<double> pbds = std::chrono::steady_clock::now() - start;
+
+    SlidingQuantiles quantiles;
+    quantiles.track({Anomaly, 1 - Anomaly, 0, 1, 0.5});
+    for (size_t i = 0; i < window; i++)
+    {
+        quantiles.insert(prices[i], i);
+    }
+    size_t mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < ticks; t++)
+    {
+        quantiles.erase(prices[t], t);
+        quantiles.insert(prices[t + window], t + window);
+        double high = quantiles.tracked(0);
+        double low = quantiles.tracked(1);
+        checksum += high + low;
+        mismatches += high != expectedHigh[t] || low != expectedLow[t];
+    }
+    std::chrono::duration<double> sliding = std::chrono::steady_clock::now() - start;
+
+    // The other markers and the O(log n) queries, outside of the timing
+    for (double q : {0.0, 1.0, 0.5})
+    {
+        mismatches += quantiles.percentile(q) != tree(ordered, q);
+    }
+    mismatches += quantiles.tracked(2) != tree(ordered, 0) || quantiles.tracked(3) != tree(ordered, 1) || quantiles.tracked(4) != tree(ordered, 0.5);
+
+    std::cout << "Window of " << window << " prices, " << ticks << " ticks (checksum " << checksum << ")" << std::endl;
+    std::cout << "  sort (describe)    " << 1e6*sorting.count()/ticks << " us/tick" << std::endl;
+    std::cout << "  pb_ds tree         " << 1e6*pbds.count()/ticks << " us/tick" << std::endl;
+    std::cout << "  SlidingQuantiles   " << 1e6*sliding.count()/ticks << " us/tick" << std::endl;
+    std::cout << (mismatches == 0 ? "All percentiles agree" : std::to_string(mismatches) + " percentiles differ") << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,564 @@
+/** ========================================================================================
+
+    Filename:  replay_bench.cpp
+
+    Description:  End to end benchmark without CoinGecko. A local HTTP server answers the
+                  /simple/price requests of Fetcher with the prices of the current frame, and
+                  every frame goes through the same path as the program: database() -> API()
+                  -> update() -> pipeline (writer, analytics, alert dispatcher) -> Alert().
+
+                  Frames are either synthetic, a random walk per currency with jumps injected
+                  now and then, or recorded /simple/price responses replayed from a file with
+                  one response per line. Reports the latency percentiles of every stage,
+                  rows/s, allocations and peak RSS, and checks that every price saved is once
+                  in the ring of its currency (exit code 1 if not). Runs in a scratch
+                  replay.db and log.txt of the working directory.
+
+                  Usage: bench/replay_bench [--coins N] [--frames N] [--speed X] [--seed N]
+                                            [--replay file] [--save file] [--backfill H]
+                                            [--trace file]
+                    --speed X   replay X times faster than the frames were taken, 0 (default)
+                                as fast as possible
+                    --save      write the synthetic frames as a recording for --replay
+                    --backfill  the server also answers /coins/{id}/market_chart with H hours
+                                of prices every 5 minutes before the first frame, and every
+                                currency gets its history on the first call (default 0, off)
+                    --trace     trace the stages (trace.cpp), write the spans to this file and
+                                print their p50/p99
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../headers.h"
+#include "../persistence.h"
+#include "../fetch.h"
+#include "../scheduler.h"
+#include "../pricestore.h"
+#include "../analytics.h"
+#include "../pipeline.h"
+#include "../logger.h"
+#include "../config.h"
+#include "../trace.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <new>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+const char* path = "replay.db";
+
+// Every allocation of the process is counted
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocated{0};
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+// Prices of every currency at one moment, NaN if a recording doesn't have it
+struct Frame
+{
+    double time = 0;
+    std::vector<double> prices;
+    std::vector<double> times;
+};
+
+// Random walks with about 1% of the steps replaced by a jump of 5 to 15%
+std::vector<Frame> synthetic(size_t coins, size_t frames, unsigned seed)
+{
+    std::mt19937_64 random(seed);
+    std::normal_distribution<double> step(0, 0.002);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<Frame> result(frames);
+    std::vector<double> price(coins);
+    double now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    for (size_t c = 0; c < coins; c++)
+    {
+        price[c] = std::exp(uniform(random)*10 - 3);
+    }
+    for (size_t f = 0; f < frames; f++)
+    {
+        Frame &frame = result[f];
+        frame.time = now - 60.0*(frames - f);
+        frame.prices.resize(coins);
+        frame.times.assign(coins, frame.time);
+        for (size_t c = 0; c < coins; c++)
+        {
+            double change = step(random);
+            if (uniform(random) < 0.01)
+            {
+                change = (uniform(random) < 0.5 ? -1 : 1)*(0.05 + 0.1*uniform(random));
+            }
+            price[c] *= std::exp(change);
+            frame.prices[c] = price[c];
+        }
+    }
+    return result;
+}
+
+// Recorded responses, one per line: {"id":{"usd":price,"last_updated_at":time},...}
+std::vector<Frame> recorded(const char* file, std::vector<std::string> &names)
+{
+    std::ifstream input(file);
+    std::unordered_map<std::string, size_t> index;
+    std::vector<Frame> result;
+    std::string line;
+
+    while (std::getline(input, line))
+    {
+        Frame frame;
+        size_t begin = 0;
+        while ((begin = line.find("\":{", begin)) != std::string::npos)
+        {
+            size_t open = line.rfind('"', begin - 1);
+            size_t end = line.find('}', begin);
+            std::string id = line.substr(open + 1, begin - open - 1);
+            std::string object = line.substr(begin, end - begin);
+            size_t usd = object.find("\"usd\":");
+            size_t updated = object.find("\"last_updated_at\":");
+            begin = end;
+            if (usd == std::string::npos || updated == std::string::npos)
+            {
+                continue;
+            }
+            if (index.emplace(id, names.size()).second)
+            {
+                names.push_back(id);
+            }
+            size_t c = index[id];
+            frame.prices.resize(names.size(), NAN);
+            frame.times.resize(names.size(), NAN);
+            frame.prices[c] = std::atof(object.c_str() + usd + 6);
+            frame.times[c] = std::atof(object.c_str() + updated + 18);
+            frame.time = std::max(frame.time, frame.times[c]);
+        }
+        if (!frame.prices.empty())
+        {
+            result.push_back(frame);
+        }
+    }
+    for (Frame &frame : result)
+    {
+        frame.prices.resize(names.size(), NAN);
+        frame.times.resize(names.size(), NAN);
+    }
+    return result;
+}
+
+// Body of a /simple/price response with the requested ids of a frame
+std::string response(const Frame &frame, const std::vector<size_t> &ids, const std::vector<std::string> &names)
+{
+    std::string body = "{";
+    for (size_t c : ids)
+    {
+        if (std::isnan(frame.prices[c]))
+        {
+            continue;
+        }
+        char values[96];
+        std::snprintf(values, sizeof(values), "\":{\"usd\":%.10g,\"last_updated_at\":%lld}", frame.prices[c], static_cast<long long>(frame.times[c]));
+        body += (body.size() > 1 ? ",\"" : "\"") + names[c] + values;
+    }
+    return body + "}";
+}
+
+// Body of a /coins/{id}/market_chart response with the prices of currency c in the frames given
+std::string chart(const std::vector<Frame> &frames, size_t c)
+{
+    std::string body = "{\"prices\":[";
+    for (const Frame &frame : frames)
+    {
+        char point[64];
+        std::snprintf(point, sizeof(point), "[%lld,%.10g]", static_cast<long long>(1000*frame.time), frame.prices[c]);
+        body += (body.back() == '[' ? "" : ",") + std::string(point);
+    }
+    return body + "],\"market_caps\":[],\"total_volumes\":[]}";
+}
+
+// HTTP/1.1 server on 127.0.0.1 answering with the frame shown, one thread per connection
+class Server
+{
+public:
+    Server(const std::vector<std::string> &names) : names(names)
+    {
+        for (size_t c = 0; c < names.size(); c++)
+        {
+            index[names[c]] = c;
+        }
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(listener, 64);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+        acceptor = std::thread(&Server::accept, this);
+    }
+
+    ~Server()
+    {
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        acceptor.join();
+        std::lock_guard<std::mutex> guard(lock);
+        for (int client : clients)
+        {
+            shutdown(client, SHUT_RDWR);
+        }
+        for (std::thread &connection : connections)
+        {
+            connection.join();
+        }
+    }
+
+    void show(const Frame &frame)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        current = &frame;
+    }
+
+    void history(const std::vector<Frame> &frames)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        past = &frames;
+    }
+
+    int port;
+
+private:
+    void accept()
+    {
+        int client;
+        while ((client = ::accept(listener, nullptr, nullptr)) >= 0)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            clients.push_back(client);
+            connections.emplace_back(&Server::serve, this, client);
+        }
+    }
+
+    void serve(int client)
+    {
+        std::string request;
+        char buffer[65536];
+        ssize_t received;
+        while ((received = recv(client, buffer, sizeof(buffer), 0)) > 0)
+        {
+            request.append(buffer, received);
+            size_t end;
+            while ((end = request.find("\r\n\r\n")) != std::string::npos)
+            {
+                std::string body = answer(request.substr(0, end));
+                std::string reply = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+                for (size_t sent = 0; sent < reply.size(); )
+                {
+                    ssize_t written = send(client, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                    if (written <= 0)
+                    {
+                        close(client);
+                        return;
+                    }
+                    sent += written;
+                }
+                request.erase(0, end + 4);
+            }
+        }
+        close(client);
+    }
+
+    // Ids of "GET /simple/price?ids=a%2Cb&vs_currencies=usd...", or "GET /coins/id/market_chart?..."
+    std::string answer(const std::string &head)
+    {
+        if (head.compare(0, 11, "GET /coins/") == 0)
+        {
+            size_t end = head.find('/', 11);
+            auto found = index.find(head.substr(11, end == std::string::npos ? 0 : end - 11));
+            std::lock_guard<std::mutex> guard(lock);
+            return found == index.end() || past == nullptr ? "{\"error\":\"coin not found\"}" : chart(*past, found->second);
+        }
+        std::vector<size_t> ids;
+        size_t begin = head.find("ids=") + 4;
+        size_t end = head.find_first_of("& ", begin);
+        std::string list = head.substr(begin, end - begin);
+        for (size_t at = 0; at <= list.size(); )
+        {
+            size_t next = list.find("%2C", at);
+            next = next == std::string::npos ? list.size() : next;
+            auto found = index.find(list.substr(at, next - at));
+            if (found != index.end())
+            {
+                ids.push_back(found->second);
+            }
+            at = next + 3;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        return current == nullptr ? "{}" : response(*current, ids, names);
+    }
+
+    const std::vector<std::string> &names;
+    std::unordered_map<std::string, size_t> index;
+    int listener;
+    std::thread acceptor;
+    std::mutex lock;
+    std::vector<int> clients;
+    std::vector<std::thread> connections;
+    const Frame* current = nullptr;
+    const std::vector<Frame>* past = nullptr;
+};
+
+// Scratch database with the tables of the GUI, every currency followed with the default thresholds
+void create(const std::vector<std::string> &names, int port, bool backfill)
+{
+    sqlite3* db;
+    std::remove(path);
+    std::remove((std::string(path) + "-wal").c_str());
+    std::remove((std::string(path) + "-shm").c_str());
+    sqlite3_open(path,&db);
+    sqlite3_exec(db,"CREATE TABLE Currencies (ID INTEGER PRIMARY KEY AUTOINCREMENT, GeckoID TEXT NOT NULL, name TEXT NOT NULL);"
+                    "CREATE TABLE Prices (priceID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, time DOUBLE NOT NULL, date TEXT NOT NULL, price REAL NOT NULL);"
+                    "CREATE TABLE Configs(alertID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, minimumData INTEGER NOT NULL, timeWindow REAL NOT NULL, gain REAL NOT NULL, longGain REAL NOT NULL, movingAvg TEXT NOT NULL, anomaly REAL NOT NULL);"
+                    "CREATE TABLE Mode(key INTEGER PRIMARY KEY AUTOINCREMENT, updateFreq REAL NOT NULL, mode TEXT NOT NULL, mail TEXT NOT NULL, password TEXT NOT NULL);"
+                    "CREATE TABLE Settings(name TEXT PRIMARY KEY, value TEXT NOT NULL);"
+                    "INSERT INTO Mode (updateFreq,mode,mail,password) VALUES (1,'local','','');"
+                    "BEGIN;",nullptr,nullptr,nullptr);
+    for (const std::string &name : names)
+    {
+        const std::string row = "INSERT INTO Currencies (GeckoID,name) VALUES ('" + name + "','" + name + "');";
+        sqlite3_exec(db,row.c_str(),nullptr,nullptr,nullptr);
+    }
+    const std::string settings = "INSERT INTO Settings VALUES ('apiUrl','http://127.0.0.1:" + std::to_string(port) + "'),('callsPerMinute','1000000000'),"
+                                 "('backfill','" + (backfill ? "1" : "0") + "');";
+    sqlite3_exec(db,settings.c_str(),nullptr,nullptr,nullptr);
+    sqlite3_exec(db,"COMMIT;",nullptr,nullptr,nullptr);
+    sqlite3_close(db);
+}
+
+void report(const char* stage, std::vector<double> seconds)
+{
+    std::printf("  %-8s %6zu batches", stage, seconds.size());
+    if (seconds.empty())
+    {
+        std::printf("\n");
+        return;
+    }
+    std::sort(seconds.begin(), seconds.end());
+    for (double q : {0.5, 0.9, 0.99})
+    {
+        std::printf("   p%-2g %9.3f ms", 100*q, 1000*seconds[static_cast<size_t>(q*(seconds.size() - 1))]);
+    }
+    std::printf("   max %9.3f ms\n", 1000*seconds.back());
+}
+
+int main(int argc, char* argv[])
+{
+    size_t coins = 1000, frames = 60;
+    double speed = 0, hours = 0;
+    unsigned seed = 1;
+    const char* replay = nullptr;
+    const char* save = nullptr;
+    const char* trace = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--coins") == 0) coins = std::atol(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--frames") == 0) frames = std::atol(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--speed") == 0) speed = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--seed") == 0) seed = std::atol(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--replay") == 0) replay = argv[i + 1];
+        else if (std::strcmp(argv[i], "--save") == 0) save = argv[i + 1];
+        else if (std::strcmp(argv[i], "--backfill") == 0) hours = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--trace") == 0) trace = argv[i + 1];
+    }
+
+    std::vector<std::string> names;
+    std::vector<Frame> recording;
+    if (replay != nullptr)
+    {
+        recording = recorded(replay, names);
+    }
+    else
+    {
+        for (size_t c = 0; c < coins; c++)
+        {
+            names.push_back("coin-" + std::to_string(c));
+        }
+        recording = synthetic(coins, frames, seed);
+    }
+    if (recording.empty())
+    {
+        std::cerr << "No frames to replay" << std::endl;
+        return 1;
+    }
+    if (save != nullptr)
+    {
+        std::ofstream output(save);
+        std::vector<size_t> all(names.size());
+        for (size_t c = 0; c < all.size(); c++)
+        {
+            all[c] = c;
+        }
+        for (const Frame &frame : recording)
+        {
+            output << response(frame, all, names) << '\n';
+        }
+    }
+
+    // History before the first frame, every 5 minutes
+    std::vector<Frame> past = synthetic(names.size(), static_cast<size_t>(12*hours), seed + 1);
+    for (size_t f = 0; f < past.size(); f++)
+    {
+        past[f].time = recording.front().time - 300.0*(past.size() - f);
+    }
+
+    Server server(names);
+    server.history(past);
+    create(names, server.port, hours > 0);
+    std::printf("%zu currencies, %zu frames%s, ", names.size(), recording.size(), replay ? " replayed" : " synthetic");
+    if (speed > 0)
+    {
+        std::printf("speed %gx\n", speed);
+    }
+    else
+    {
+        std::printf("speed unlimited\n");
+    }
+
+    // Same objects and warm up as program.cpp
+    Persistence db;
+    Fetcher api;
+    Scheduler schedule;
+    PriceStore store;
+    Analytics engine(store);
+    if (db.open(path) != 0 || config.refresh(db) < 0 || store.load(db.handle()) != 0)
+    {
+        std::cerr << "Couldn't open " << path << std::endl;
+        return 1;
+    }
+    engine.configure(*config.get());
+    logger.configure(db);
+    Pipeline pipeline(store, engine, schedule, 64);
+    pipeline.profile(true);
+    tracer.enable(trace != nullptr);
+    pipeline.start(path);
+
+    std::vector<double> fetchTimes;
+    size_t allocationsBefore = allocations.load(), allocatedBefore = allocated.load();
+    auto start = std::chrono::steady_clock::now();
+    for (const Frame &frame : recording)
+    {
+        if (speed > 0)
+        {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::duration<double>((frame.time - recording.front().time)/speed)));
+        }
+        server.show(frame);
+        auto begin = std::chrono::steady_clock::now();
+        if (config.refresh(db) > 0)
+        {
+            db.refresh();
+        }
+        schedule.configure(db, 0);  // every currency is due on every frame
+        database(db, api, schedule, pipeline, "local");
+        fetchTimes.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    }
+    pipeline.stop();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t allocationCount = allocations.load() - allocationsBefore, allocatedBytes = allocated.load() - allocatedBefore;
+
+    sqlite3_stmt* stmt;
+    long long rows = 0;
+    sqlite3_prepare_v2(db.handle(),"SELECT COUNT(*) FROM Prices;",-1,&stmt,nullptr);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        rows = sqlite3_column_int64(stmt,0);
+    }
+    sqlite3_finalize(stmt);
+    // Every price saved must be once in the ring of its currency: the rings of the analyses hold as
+    // many prices as Prices has since the oldest one they keep
+    size_t duplicated = 0, currencies = 0;
+    sqlite3_prepare_v2(db.handle(),"SELECT COUNT(*) FROM Prices WHERE CurrencyID = ?1 AND time >= ?2;",-1,&stmt,nullptr);
+    for (const std::string &name : names)
+    {
+        const PriceRing &ring = store.ring(db.id(name));
+        if (ring.size() == 0)
+        {
+            continue;
+        }
+        sqlite3_bind_int(stmt,1,db.id(name));
+        sqlite3_bind_double(stmt,2,ring.time(ring.first()));
+        long long saved = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt,0) : 0;
+        sqlite3_reset(stmt);
+        duplicated += ring.size() > static_cast<size_t>(saved) ? ring.size() - saved : 0;
+        currencies += ring.size() != static_cast<size_t>(saved);
+    }
+    sqlite3_finalize(stmt);
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::printf("Stage latency:\n");
+    report("fetch", fetchTimes);
+    for (const StageLatency &stage : pipeline.latencies())
+    {
+        report(stage.name, stage.seconds);
+    }
+    if (hours > 0)
+    {
+        std::printf("Backfill:    %zu prices of history, first call %.3f s\n", past.size()*names.size(), fetchTimes.front());
+    }
+    std::printf("Rows:        %lld in %.3f s, %.0f rows/s\n", rows, elapsed, rows/elapsed);
+    std::printf("Allocations: %zu (%.1f per row), %.1f MB\n", allocationCount, rows ? static_cast<double>(allocationCount)/rows : 0.0, allocatedBytes/1048576.0);
+    std::printf("Peak RSS:    %.1f MB\n", usage.ru_maxrss/1024.0);
+    std::printf("Rings:       %s", currencies == 0 ? "every price once\n" : "");
+    if (currencies > 0)
+    {
+        std::printf("%zu currencies differ from Prices, %zu prices pushed twice\n", currencies, duplicated);
+    }
+    if (trace != nullptr)
+    {
+        tracer.enable(false);
+        std::printf("%s\n", tracer.summary().c_str());
+        tracer.write(trace);
+    }
+    for (const QueueMetrics &queue : pipeline.metrics())
+    {
+        if (queue.rejected > 0)
+        {
+            std::printf("Queue %s refused %zu batches\n", queue.name, queue.rejected);
+        }
+    }
+    return currencies == 0 ? 0 : 1;
+}
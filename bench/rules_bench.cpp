@@ -0,0 +1,233 @@
+/** ========================================================================================
+
+    Filename:  rules_bench.cpp
+
+    Description:  Alert rules (rules.cpp) over a day of synthetic prices, one per minute, for
+                  every currency with the default thresholds of the GUI and two rules of the
+                  user. Then:
+                    - check: without hysteresis the built in rules must fire exactly when the
+                      hard coded checks they replace become true, pass by pass
+                    - alerts: how many would be sent on every pass the checks are true, and
+                      how many with the rules fired once per crossing, with the default
+                      hysteresis and with a cooldown
+                    - steps: the built in rules, run as straight-line comparisons, must give
+                      the same result as their steps on the stack, on random metrics with and
+                      without the hysteresis band
+                    - time: nanoseconds per currency and pass of the built in rules and of the
+                      hard coded checks, timed over every pass of a currency at once, and of the
+                      rules with those of the user
+
+                  Usage: bench/rules_bench [currencies] [minutes]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../analytics.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+
+const double Start = 1738000000;
+
+// The checks of the built in alerts as Analytics::analyse() wrote them, one bit per Signal
+unsigned hardcoded(const Reading &values, const Thresholds &limits, double high, double low)
+{
+    unsigned triggered = 0;
+    if (limits.gain != 0 && std::abs(100*values.instant) > limits.gain)
+    {
+        triggered |= 1 << InstantGain;
+    }
+    if (limits.longGain != 0 && std::abs(100*values.longer) > limits.longGain)
+    {
+        triggered |= 1 << LongGain;
+    }
+    if (limits.movingAvg && values.recentCount > 0 && values.recent > values.hour)
+    {
+        triggered |= 1 << MovingAverage;
+    }
+    if (limits.anomaly != 0 && (values.last > high || values.last < low))
+    {
+        triggered |= 1 << Anomaly;
+    }
+    if (values.volatility > 0 && values.mean/values.volatility > 1.5)
+    {
+        triggered |= 1 << Variation;
+    }
+    return triggered;
+}
+
+// Counts of one replay of every currency
+struct Tally
+{
+    long long checks = 0;       // passes where a hard coded check is true
+    long long rising = 0;       // passes where it becomes true
+    long long fired = 0;        // alerts of the rules
+    long long custom = 0;       // of those, alerts of the rules of the user
+    bool same = true;           // the built in rules fired on the rising passes
+    double ruleSeconds = 0;
+    double checkSeconds = 0;
+};
+
+Tally replay(const std::vector<std::vector<double>> &walks, const Thresholds &limits, const std::vector<RuleConfig> &rules, const Hysteresis &rearm)
+{
+    Tally count;
+    std::vector<const Rule*> fired;
+    for (size_t c = 0; c < walks.size(); c++)
+    {
+        PriceRing ring;
+        Series data;
+        data.thresholds(limits);
+        data.attach(ring, false);
+        Plan plan;
+        plan.compile(limits, rules, static_cast<int>(c + 1));
+
+        // Readings of the passes with enough data, then the checks and the rules are timed over all
+        // of them, so the clock isn't read on every pass
+        std::vector<Reading> readings;
+        std::vector<double> highs, lows, times;
+        for (size_t m = 0; m < walks[c].size(); m++)
+        {
+            double now = Start + 60*m;
+            ring.push(now, walks[c][m]);
+            data.push();
+            data.evict(now);
+            Reading values = data.read();
+            if (!values.ready(limits))
+            {
+                continue;
+            }
+            readings.push_back(values);
+            highs.push_back(data.ordered.tracked(0));
+            lows.push_back(data.ordered.tracked(1));
+            times.push_back(now);
+        }
+        std::vector<unsigned> checks(readings.size()), builtins(readings.size());
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < readings.size(); i++)
+        {
+            checks[i] = hardcoded(readings[i], limits, highs[i], lows[i]);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < readings.size(); i++)
+        {
+            double metrics[Measures];
+            readings[i].metrics(highs[i], lows[i], metrics);
+            fired.clear();
+            plan.evaluate(metrics, times[i], rearm, fired);
+            for (const Rule *rule : fired)
+            {
+                builtins[i] |= rule->signal >= 0 ? 1u << rule->signal : 0;
+                count.custom += rule->signal < 0;
+            }
+            count.fired += fired.size();
+        }
+        auto end = std::chrono::steady_clock::now();
+        count.checkSeconds += std::chrono::duration<double>(middle - begin).count();
+        count.ruleSeconds += std::chrono::duration<double>(end - middle).count();
+
+        unsigned before = 0;
+        for (size_t i = 0; i < readings.size(); i++)
+        {
+            count.checks += __builtin_popcount(checks[i]);
+            count.rising += __builtin_popcount(checks[i] & ~before);
+            count.same = count.same && builtins[i] == (checks[i] & ~before);
+            before = checks[i];
+        }
+    }
+    return count;
+}
+
+// Built in rules whose comparisons disagree with their steps on random metrics, some of them NaN or
+// infinite, with and without the hysteresis band
+size_t disagreements(const Thresholds &limits, size_t &rules)
+{
+    std::mt19937_64 random(5);
+    std::normal_distribution<double> value(0, 3);
+    std::uniform_int_distribution<int> special(0, 49);
+    Plan plan;
+    plan.compile(limits, {}, 1);
+    size_t wrong = 0;
+    rules = plan.rules().size();
+    for (const Rule &rule : plan.rules())
+    {
+        bool same = true;
+        for (int i = 0; i < 100000 && same; i++)
+        {
+            double metrics[Measures];
+            for (double &metric : metrics)
+            {
+                int kind = special(random);
+                metric = kind == 0 ? NAN : kind == 1 ? INFINITY : kind == 2 ? limits.gain : kind == 3 ? 1.5 : value(random);
+            }
+            for (double slack : {0.0, 0.1})
+            {
+                same = same && plan.met(rule, metrics, slack) == rule.interpret(metrics, slack);
+            }
+        }
+        wrong += !same;
+    }
+    return wrong;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 1000;
+    size_t minutes = argc > 2 ? std::atoi(argv[2]) : 1440;
+    if (currencies == 0 || minutes == 0)
+    {
+        std::cerr << "Usage: rules_bench [currencies] [minutes]" << std::endl;
+        return 1;
+    }
+    std::mt19937_64 random(3);
+    std::normal_distribution<double> step(0, 0.004);
+    std::vector<std::vector<double>> walks(currencies, std::vector<double>(minutes));
+    for (std::vector<double> &walk : walks)
+    {
+        double price = 100;
+        for (double &value : walk)
+        {
+            price *= 1 + step(random);
+            value = price;
+        }
+    }
+
+    // Defaults of a currency added in the GUI
+    Thresholds limits;
+    limits.gain = 2;
+    limits.longGain = 3;
+    limits.anomaly = 98.5;
+    std::vector<RuleConfig> rules = {{"jump", "abs(instant) > gain/2 and volatility > mean/100", 0}, {"drawdown", "return < -longGain", 0}};
+    std::vector<Step> steps;
+    bool rejected = !compile("gain >", limits, steps).empty() && !compile("abs(instant > 1", limits, steps).empty() && !compile("price > 1", limits, steps).empty();
+    std::cout << currencies << " currencies, " << minutes << " prices each, 5 built in rules and 2 of the user" << std::endl;
+
+    Tally edges = replay(walks, limits, {}, {0, 0});
+    bool same = edges.same && edges.fired == edges.rising && rejected;
+    std::cout << "  check    " << edges.fired << " alerts of the built in rules on " << edges.rising << " crossings: "
+              << (same ? "same" : "ALERTS DIFFER") << (rejected ? "" : ", INVALID RULES ACCEPTED") << std::endl;
+
+    size_t builtin = 0, wrong = disagreements(limits, builtin);
+    same = same && wrong == 0;
+    std::cout << "  steps    " << wrong << " of the " << builtin << " built in rules disagree with their steps: " << (wrong == 0 ? "same" : "RULES DIFFER") << std::endl;
+
+    Tally band = replay(walks, limits, rules, Hysteresis());
+    Tally cooled = replay(walks, limits, rules, {0.1, 1800});
+    std::cout << "  alerts   every pass " << std::setw(9) << edges.checks << std::endl
+              << "           crossings  " << std::setw(9) << edges.fired << std::endl
+              << "           hysteresis " << std::setw(9) << band.fired << "   (" << band.custom << " of the user rules, band 0.1)" << std::endl
+              << "           cooldown   " << std::setw(9) << cooled.fired << "   (and 30 minutes between two alerts of a rule)" << std::endl;
+
+    long long passes = static_cast<long long>(currencies*minutes);
+    std::cout << std::fixed << std::setprecision(1) << "  time     built in rules " << 1e9*edges.ruleSeconds/passes << " ns, hard coded checks "
+              << 1e9*edges.checkSeconds/passes << " ns, with the user rules " << 1e9*band.ruleSeconds/passes << " ns per currency and pass" << std::endl;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/** ========================================================================================
+
+    Filename:  scaling_bench.cpp
+
+    Description:  Scaling of the analysis pass with the threads of the pool. For 1 to N threads
+                  a fresh PriceStore and Analytics follow the same synthetic random walks (one
+                  price per minute, 5 hour windows) and the time of run() is measured over a
+                  number of ticks. The alerts of every thread count must be the same lines in
+                  the same order as with one thread.
+
+                  Usage: bench/scaling_bench [currencies] [threads] [ticks]
+                  threads defaults to every hardware thread.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../analytics.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+
+const double Start = 1738000000;
+
+// Seconds per run() and every alert produced, with "threads" threads
+double measure(size_t threads, const Config &config, const std::vector<std::vector<double>> &walks, size_t ticks, std::vector<std::string> &alerts)
+{
+    PriceStore store;
+    Analytics engine(store, threads);
+    engine.configure(config);
+    size_t warmup = walks[0].size() - ticks;
+    for (size_t i = 0; i < warmup; i++)
+    {
+        for (const CurrencyConfig &currency : config.currencies)
+        {
+            store.push(currency.id, Start + 60*i, walks[currency.id - 1][i]);
+            engine.add(currency.id);
+        }
+    }
+
+    int analysed = 0;
+    std::chrono::duration<double> elapsed(0);
+    alerts.clear();
+    for (size_t i = warmup; i < walks[0].size(); i++)
+    {
+        for (const CurrencyConfig &currency : config.currencies)
+        {
+            store.push(currency.id, Start + 60*i, walks[currency.id - 1][i]);
+            engine.add(currency.id);
+        }
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::string> lines = engine.run(Start + 60*i, analysed);
+        elapsed += std::chrono::steady_clock::now() - begin;
+        alerts.insert(alerts.end(), lines.begin(), lines.end());
+    }
+    return elapsed.count()/ticks;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 10000;
+    size_t threads = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    size_t ticks = argc > 3 ? std::atoi(argv[3]) : 20;
+    if (currencies == 0 || threads == 0 || ticks == 0)
+    {
+        std::cerr << "Usage: scaling_bench [currencies] [threads] [ticks]" << std::endl;
+        return 1;
+    }
+
+    Config config;
+    std::vector<std::vector<double>> walks(currencies, std::vector<double>(300 + ticks));
+    std::mt19937_64 random(11);
+    std::normal_distribution<double> step(0, 0.004);
+    for (size_t c = 0; c < currencies; c++)
+    {
+        CurrencyConfig currency = {static_cast<int>(c + 1), "coin" + std::to_string(c + 1), Thresholds(), "coin" + std::to_string(c + 1)};
+        currency.limits.gain = 1;
+        config.currencies.push_back(currency);
+        double price = 100;
+        for (double &value : walks[c])
+        {
+            price *= 1 + step(random);
+            value = price;
+        }
+    }
+
+    std::cout << currencies << " currencies, " << ticks << " ticks, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::vector<std::string> serial, alerts;
+    double base = measure(1, config, walks, ticks, serial);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  threads  1   run " << std::setw(9) << 1e3*base << " ms   speedup  1.00   " << serial.size() << " alerts" << std::endl;
+    int different = 0;
+    for (size_t t = 2; t <= threads; t++)
+    {
+        double seconds = measure(t, config, walks, ticks, alerts);
+        bool same = alerts == serial;
+        different += !same;
+        std::cout << "  threads " << std::setw(2) << t << "   run " << std::setw(9) << 1e3*seconds << " ms   speedup " << std::setw(5) << std::setprecision(2) << base/seconds
+                  << std::setprecision(3) << "   " << (same ? "same alerts" : "ALERTS DIFFER") << std::endl;
+    }
+    return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/** ========================================================================================
+
+    Filename:  startup_bench.cpp
+
+    Description:  Cold start of the analyses with and without a snapshot. A scratch database
+                  gets a 5 hour window of prices (one per minute) for every currency, then:
+                    - cold: PriceStore::load() and configure() read every window from Prices
+                      and push it through the rolling sums and the skip lists
+                    - save: Analytics::save() as the analytics worker does it
+                    - warm: after a few more minutes of prices, restore() maps the snapshot
+                      and load() only reads the rows saved after it
+                  The warm state must give the same alerts and volatilities as a cold start
+                  over the same rows.
+
+                  Usage: bench/startup_bench [currencies] [minutes after the snapshot]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../headers.h"
+#include "../persistence.h"
+#include "../pricestore.h"
+#include "../analytics.h"
+#include "../config.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <sys/stat.h>
+
+const char* path = "startup.db";
+const char* snapshot = "startup.snap";
+
+// Scratch database with the tables of the GUI, every currency followed with the default thresholds
+void create(size_t currencies)
+{
+    sqlite3* db;
+    for (const std::string &name : {std::string(path), std::string(path) + "-wal", std::string(path) + "-shm", std::string(snapshot)})
+    {
+        std::remove(name.c_str());
+    }
+    sqlite3_open(path,&db);
+    sqlite3_exec(db,"CREATE TABLE Currencies (ID INTEGER PRIMARY KEY AUTOINCREMENT, GeckoID TEXT NOT NULL, name TEXT NOT NULL);"
+                    "CREATE TABLE Prices (priceID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, time DOUBLE NOT NULL, date TEXT NOT NULL, price REAL NOT NULL);"
+                    "CREATE TABLE Configs(alertID INTEGER PRIMARY KEY AUTOINCREMENT, CurrencyID INTEGER NOT NULL, minimumData INTEGER NOT NULL, timeWindow REAL NOT NULL, gain REAL NOT NULL, longGain REAL NOT NULL, movingAvg TEXT NOT NULL, anomaly REAL NOT NULL);"
+                    "CREATE TABLE Mode(key INTEGER PRIMARY KEY AUTOINCREMENT, updateFreq REAL NOT NULL, mode TEXT NOT NULL, mail TEXT NOT NULL, password TEXT NOT NULL);"
+                    "CREATE TABLE Settings(name TEXT PRIMARY KEY, value TEXT NOT NULL);"
+                    "INSERT INTO Mode (updateFreq,mode,mail,password) VALUES (1,'local','','');"
+                    "BEGIN;",nullptr,nullptr,nullptr);
+    for (size_t c = 0; c < currencies; c++)
+    {
+        const std::string row = "INSERT INTO Currencies (GeckoID,name) VALUES ('coin-" + std::to_string(c) + "','coin-" + std::to_string(c) + "');";
+        sqlite3_exec(db,row.c_str(),nullptr,nullptr,nullptr);
+    }
+    sqlite3_exec(db,"COMMIT;",nullptr,nullptr,nullptr);
+    sqlite3_close(db);
+}
+
+// "minutes" more prices of every random walk, the last one at "until"
+void append(Persistence &db, std::vector<double> &walks, int minutes, double until, std::mt19937_64 &random)
+{
+    std::normal_distribution<double> step(0, 0.004);
+    db.begin();
+    for (int m = minutes - 1; m >= 0; m--)
+    {
+        for (size_t c = 0; c < walks.size(); c++)
+        {
+            walks[c] *= 1 + step(random);
+            db.insert(static_cast<int>(c + 1), until - 60*m, walks[c]);
+        }
+    }
+    db.commit();
+}
+
+struct Start
+{
+    double seconds;
+    std::vector<std::string> alerts;
+    std::vector<std::pair<int, double>> cvs;
+};
+
+// Time until the engine is ready, then one analysis pass at "now" and the snapshot if "save"
+Start start(Persistence &db, bool warm, double now, bool save)
+{
+    PriceStore store;
+    Analytics engine(store, 1);
+    Start result;
+    auto begin = std::chrono::steady_clock::now();
+    config.refresh(db);
+    if (warm && engine.restore(snapshot, *config.get(), db.handle()) != 0)
+    {
+        std::cerr << "The snapshot could not be restored" << std::endl;
+    }
+    store.load(db.handle());
+    engine.configure(*config.get());
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    int analysed;
+    result.alerts = engine.run(now, analysed);
+    result.cvs = engine.cvs();
+    if (save)
+    {
+        begin = std::chrono::steady_clock::now();
+        engine.save(snapshot);
+        double saving = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        struct stat info;
+        stat(snapshot, &info);
+        std::cout << "  save     " << std::setw(9) << 1e3*saving << " ms   " << info.st_size/1048576.0 << " MB" << std::endl;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t currencies = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int after = argc > 2 ? std::atoi(argv[2]) : 10;
+    if (currencies == 0 || after < 0)
+    {
+        std::cerr << "Usage: startup_bench [currencies] [minutes after the snapshot]" << std::endl;
+        return 1;
+    }
+
+    double now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<double> walks(currencies, 100);
+    std::mt19937_64 random(5);
+    create(currencies);
+    Persistence db;
+    if (db.open(path) != 0)
+    {
+        std::cerr << "Couldn't open " << path << std::endl;
+        return 1;
+    }
+    append(db, walks, 300, now - 60*after, random);
+
+    std::cout << currencies << " currencies, 300 prices each, " << after << " minutes after the snapshot" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    Start cold = start(db, false, now - 60*after, true);
+    std::cout << "  cold     " << std::setw(9) << 1e3*cold.seconds << " ms" << std::endl;
+
+    append(db, walks, after, now, random);
+    Start full = start(db, false, now, false);
+    Start warm = start(db, true, now, false);
+    bool same = warm.alerts == full.alerts && warm.cvs.size() == full.cvs.size();
+    double error = 0;
+    for (size_t i = 0; same && i < warm.cvs.size(); i++)
+    {
+        same = warm.cvs[i].first == full.cvs[i].first;
+        error = std::max(error, std::abs(warm.cvs[i].second - full.cvs[i].second)/std::max(1e-300, std::abs(full.cvs[i].second)));
+    }
+    same = same && error < 1e-9;
+    std::cout << "  cold     " << std::setw(9) << 1e3*full.seconds << " ms   " << full.alerts.size() << " alerts" << std::endl;
+    std::cout << "  warm     " << std::setw(9) << 1e3*warm.seconds << " ms   speedup " << std::setprecision(1) << full.seconds/warm.seconds
+              << "   " << (same ? "same alerts" : "ALERTS DIFFER") << ", cv error " << std::scientific << std::setprecision(1) << error << std::endl;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/** ========================================================================================
+
+    Filename:  trace_bench.cpp
+
+    Description:  Spans of trace.cpp:
+                    - cost: nanoseconds a span adds to a scope with tracing off and on
+                    - check: spans of known durations recorded by 4 threads, the p50/p99 of
+                      the summary against the exact ones sorted, which must be within the
+                      6.25% of the histogram, and the events of the Chrome trace written
+                      against the spans each thread keeps
+
+                  Usage: bench/trace_bench [spans]
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "../trace.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+const size_t Threads = 4;
+const size_t Kept = 65536;   // default traceEvents
+
+volatile unsigned long long sink = 0;
+
+// Seconds per iteration of a loop with or without a span around its body
+double loop(size_t count, bool traced)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (traced)
+        {
+            Trace span(Api);
+            sink = sink + i;
+        }
+        else
+        {
+            sink = sink + i;
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count()/count;
+}
+
+// Value in milliseconds the summary gives "field" (0 p50, 1 p99) of "stage", -1 if it's missing
+double reported(const std::string &summary, const std::string &stage, int field)
+{
+    size_t found = summary.find(" " + stage + " ");
+    double values[3];
+    if (found == std::string::npos || std::sscanf(summary.c_str() + found + stage.size() + 2, "%lf/%lf/%lf", &values[0], &values[1], &values[2]) != 3)
+    {
+        return -1;
+    }
+    return values[field];
+}
+
+int main(int argc, char* argv[])
+{
+    size_t spans = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    if (spans == 0)
+    {
+        std::cerr << "Usage: trace_bench [spans]" << std::endl;
+        return 1;
+    }
+    std::cout << spans << " spans per loop, " << Threads << " threads for the check" << std::endl;
+
+    // Cost, the main thread keeps its last spans of Api
+    double plain = loop(spans, false);
+    double off = loop(spans, true);
+    tracer.enable(true);
+    double on = loop(spans, true);
+    std::cout << std::fixed << std::setprecision(1) << "  cost     off " << 1e9*std::max(0.0, off - plain) << " ns, on "
+              << 1e9*std::max(0.0, on - plain) << " ns per span (loop without a span " << 1e9*plain << " ns)" << std::endl;
+
+    // Check, durations from 1 us to about 50 ms
+    std::vector<std::vector<uint64_t>> durations(Threads, std::vector<uint64_t>(spans/Threads + 1));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < Threads; t++)
+    {
+        threads.emplace_back([&durations, t]()
+        {
+            std::mt19937_64 random(11 + t);
+            std::lognormal_distribution<double> duration(std::log(200000.0), 1.5);
+            tracer.name(("check " + std::to_string(t)).c_str());
+            uint64_t begin = Tracer::now();
+            for (uint64_t &d : durations[t])
+            {
+                d = std::min<uint64_t>(50000000, 1000 + static_cast<uint64_t>(duration(random)));
+                tracer.record(Task, begin, begin + d);
+                begin += d;
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    tracer.enable(false);
+    std::vector<uint64_t> all;
+    for (const std::vector<uint64_t> &d : durations)
+    {
+        all.insert(all.end(), d.begin(), d.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::string summary = tracer.summary();
+    double error = 0;
+    double quantiles[2] = {0.5, 0.99};
+    for (int q = 0; q < 2; q++)
+    {
+        double exact = all[static_cast<size_t>(std::ceil(quantiles[q]*all.size())) - 1]/1e6;
+        double value = reported(summary, "task", q);
+        error = std::max(error, value < 0 ? 1 : std::fabs(value - exact)/exact);
+        std::cout << "  check    p" << (q == 0 ? "50 " : "99 ") << std::setprecision(3) << value << " ms, exact " << exact << " ms" << std::endl;
+    }
+
+    const std::string file = "trace_bench.json";
+    size_t events = 0, expected = std::min(spans, Kept) + Threads*std::min(spans/Threads + 1, Kept);
+    if (tracer.write(file) == 0)
+    {
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            events += line.find("\"ph\":\"X\"") != std::string::npos;
+        }
+        std::remove(file.c_str());
+    }
+    bool same = error <= 0.0625 && events == expected;
+    std::cout << std::setprecision(2) << "           largest error " << 100*error << "%, " << events << " events written, " << expected << " kept: "
+              << (same ? "same" : "TRACE DIFFERS") << std::endl;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+/** ========================================================================================
+
+    Filename:  config.cpp
+
+    Description:  In process copy of the configuration saved by GUI.py: refresh interval,
+                  alert mode, e-mail account and the thresholds of every currency, plus the
+                  alert rules of the Rules table (rules.cpp). The main loop, the analyses
+                  and the alerts used to query Mode and Configs again on every pass. Now
+                  the main loop asks SQLite whether another connection wrote anything
+                  (PRAGMA data_version), and only then compares the last rows of the
+                  tables the GUI appends to. A new snapshot is built only if they changed
+                  and the other threads pick it up from a version counter.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "config.h"
+#include "persistence.h"
+
+ConfigCache config;
+
+// Publish a new snapshot if the configuration changed since the last call. Returns 1 if it did,
+// 0 if not or -1 with errors, in which case the previous snapshot is kept.
+int ConfigCache::refresh(Persistence &db)
+{
+    // The GUI only appends to Mode, Configs and Currencies and deletes currencies; prices and the
+    // compaction mark are written all the time and are left out. Rules are few and compared whole.
+    const char* printQuery = "SELECT (SELECT COALESCE(MAX(key),0) FROM Mode) || ':' || (SELECT COALESCE(MAX(alertID),0) FROM Configs) || ':' "
+                             "|| (SELECT COUNT(*) FROM Currencies) || ':' || (SELECT COALESCE(MAX(ID),0) FROM Currencies) || ':' "
+                             "|| (SELECT COALESCE(group_concat(name || '=' || value,';'),'') FROM Settings WHERE name <> 'compactedUntil') || ':' "
+                             "|| (SELECT COALESCE(group_concat(name || '=' || expression || '@' || COALESCE(CurrencyID,0),';'),'') FROM Rules);";
+    std::lock_guard<std::mutex> guard(refreshing);
+    sqlite3* handle = db.handle();
+    sqlite3_stmt* stmt = nullptr;
+    long long data = -1;
+    std::string print;
+
+    if (handle == nullptr)
+    {
+        return -1;
+    }
+    if (sqlite3_prepare_v2(handle,"PRAGMA data_version;",-1,&stmt,nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        data = sqlite3_column_int64(stmt,0);
+    }
+    sqlite3_finalize(stmt);
+    if (handle == connection && data == dataVersion && data >= 0)
+    {
+        return 0;
+    }
+
+    if (sqlite3_prepare_v2(handle,printQuery,-1,&stmt,nullptr) != SQLITE_OK || sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        Alert(std::vector<std::string> (1,"Error checking the configuration for changes: " + std::string(sqlite3_errmsg(handle))),"error");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    print = reinterpret_cast<const char*>(sqlite3_column_text(stmt,0));
+    sqlite3_finalize(stmt);
+    connection = handle;
+    dataVersion = data;
+    if (print == fingerprint)
+    {
+        return 0;
+    }
+
+    auto snapshot = std::make_shared<Config>();
+    if (build(handle, *snapshot) != 0)
+    {
+        dataVersion = -1;  // try again on the next call
+        return -1;
+    }
+    fingerprint = print;
+    unsigned long version = published.load(std::memory_order_relaxed) + 1;
+    snapshot->version = version;
+    std::atomic_store(&current, std::shared_ptr<const Config>(std::move(snapshot)));
+    published.store(version, std::memory_order_release);
+    return 1;
+}
+
+// Make the next refresh() compare the fingerprint. Needed after writing the configuration on the
+// connection given to refresh(), since data_version only counts the commits of other connections.
+void ConfigCache::invalidate()
+{
+    std::lock_guard<std::mutex> guard(refreshing);
+    dataVersion = -1;
+}
+
+// Read Mode, the latest thresholds of every currency and the rules. Returns 0 or -1 with errors.
+int ConfigCache::build(sqlite3* db, Config &config)
+{
+    const char* modeQuery = "SELECT updateFreq,mode,mail,password FROM Mode ORDER BY key DESC LIMIT 1;";
+    const char* rulesQuery = "SELECT name,expression,COALESCE(CurrencyID,0) FROM Rules ORDER BY name;";
+    sqlite3_stmt* mode = nullptr;
+    sqlite3_stmt* configs = nullptr;
+    sqlite3_stmt* rules = nullptr;
+
+    if (sqlite3_prepare_v2(db,modeQuery,-1,&mode,nullptr) != SQLITE_OK || sqlite3_prepare_v2(db,LatestConfigs,-1,&configs,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,rulesQuery,-1,&rules,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error reading the configuration: " + std::string(sqlite3_errmsg(db))),"error");
+        sqlite3_finalize(mode);
+        sqlite3_finalize(configs);
+        return -1;
+    }
+    if (sqlite3_step(mode) == SQLITE_ROW)
+    {
+        config.updateFreq = sqlite3_column_double(mode,0);
+        config.mode = reinterpret_cast<const char*>(sqlite3_column_text(mode,1));
+        config.mail = sqlite3_column_type(mode,2) == SQLITE_NULL ? "" : reinterpret_cast<const char*>(sqlite3_column_text(mode,2));
+        config.password = sqlite3_column_type(mode,3) == SQLITE_NULL ? "" : reinterpret_cast<const char*>(sqlite3_column_text(mode,3));
+    }
+    while (sqlite3_step(configs) == SQLITE_ROW)
+    {
+        CurrencyConfig currency;
+        currency.id = sqlite3_column_int(configs,0);
+        currency.name = reinterpret_cast<const char*>(sqlite3_column_text(configs,1));
+        if (sqlite3_column_type(configs,2) != SQLITE_NULL)
+        {
+            currency.limits.minimumData = sqlite3_column_int(configs,2);
+            currency.limits.timeWindow = sqlite3_column_double(configs,3);
+            currency.limits.gain = sqlite3_column_double(configs,4);
+            currency.limits.longGain = sqlite3_column_double(configs,5);
+            currency.limits.movingAvg = std::string(reinterpret_cast<const char*>(sqlite3_column_text(configs,6))) == "True";
+            currency.limits.anomaly = sqlite3_column_double(configs,7);
+            currency.limits.decoupling = sqlite3_column_double(configs,8);
+        }
+        currency.gecko = reinterpret_cast<const char*>(sqlite3_column_text(configs,9));
+        config.currencies.push_back(std::move(currency));
+    }
+    while (sqlite3_step(rules) == SQLITE_ROW)
+    {
+        RuleConfig rule;
+        rule.name = reinterpret_cast<const char*>(sqlite3_column_text(rules,0));
+        rule.expression = reinterpret_cast<const char*>(sqlite3_column_text(rules,1));
+        rule.currency = sqlite3_column_int(rules,2);
+        config.rules.push_back(std::move(rule));
+    }
+    sqlite3_finalize(mode);
+    sqlite3_finalize(configs);
+    sqlite3_finalize(rules);
+    return 0;
+}
+
+// Take the latest snapshot if the cache published a newer one. Returns true if it did.
+bool ConfigView::update()
+{
+    if (cache.version() == held->version)
+    {
+        return false;
+    }
+    held = cache.get();
+    return true;
+}
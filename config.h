@@ -0,0 +1,91 @@
+#ifndef config_h
+#define config_h
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <sqlite3.h>
+
+class Persistence;
+
+// Alert thresholds of a currency, as in the latest row of Configs for it
+struct Thresholds
+{
+    int minimumData = 30;
+    double timeWindow = 5;  // hours
+    double gain = 5;        // percentage
+    double longGain = 5;    // percentage
+    bool movingAvg = true;
+    double anomaly = 95;    // percentage
+    double decoupling = 0;  // fall of the correlation with the references or the market, 0 disables
+};
+
+struct CurrencyConfig
+{
+    int id;
+    std::string name;
+    Thresholds limits;
+    std::string gecko;      // GeckoID, to find the reference currencies of the correlations
+};
+
+// Row of the Rules table: an alert of the user over the metrics of the analyses (rules.cpp)
+struct RuleConfig
+{
+    std::string name;
+    std::string expression;
+    int currency = 0;       // Currencies.ID, 0 for every currency
+};
+
+// Everything the user sets in the GUI, as it was at one point. Never modified once published.
+struct Config
+{
+    unsigned long version = 0;   // 0 until it is read from the database
+    double updateFreq = 1;       // minutes
+    std::string mode = "local";
+    std::string mail;
+    std::string password;
+    std::vector<CurrencyConfig> currencies;
+    std::vector<RuleConfig> rules;
+};
+
+// Latest Config read from Crypto.db. refresh() rebuilds it only when the GUI saved something and
+// publishes the new snapshot with an atomic swap, so readers never wait for the database.
+class ConfigCache
+{
+public:
+    ConfigCache() : current(std::make_shared<const Config>()) {}
+    int refresh(Persistence &db);
+    void invalidate();
+    std::shared_ptr<const Config> get() const { return std::atomic_load(&current); }
+    unsigned long version() const { return published.load(std::memory_order_acquire); }
+
+private:
+    int build(sqlite3* db, Config &config);
+
+    std::shared_ptr<const Config> current;
+    std::atomic<unsigned long> published{0};
+    std::mutex refreshing;               // refresh() may be called from several threads
+    sqlite3* connection = nullptr;       // data_version is only comparable on the same connection
+    long long dataVersion = -1;
+    std::string fingerprint;             // of the rows the GUI appends, to ignore the writes of prices
+};
+
+// Snapshot held by one thread. It only touches the cache when the version changed, so reading the
+// configuration takes no lock and no query.
+class ConfigView
+{
+public:
+    explicit ConfigView(const ConfigCache &source) : cache(source), held(source.get()) {}
+    bool update();
+    const Config& operator*() const { return *held; }
+    const Config* operator->() const { return held.get(); }
+
+private:
+    const ConfigCache &cache;
+    std::shared_ptr<const Config> held;
+};
+
+extern ConfigCache config;
+
+#endif
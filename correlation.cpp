@@ -0,0 +1,319 @@
+/** ========================================================================================
+
+    Filename:  correlation.cpp
+
+    Description:  Rolling correlations between the returns of the currencies, to tell when one
+                  decouples from the market or from a reference like bitcoin. Prices arrive
+                  at different times for every currency, so the returns are sampled from the
+                  last price of each one at a fixed interval and the correlations are taken
+                  over the last samples (the whole window) and over the last quarter of them.
+
+                  Sums, sums of squares and cross products are updated with the sample that
+                  comes in and the ones that leave both windows, never recomputed over the
+                  window. Against a few reference currencies that is O(N) per reference. For the
+                  whole market every pair is tracked: the upper triangle of the matrix is
+                  updated in tiles of 64 x 64, so the returns and statistics of the columns of
+                  a tile stay in L1 while its rows are swept, and the columns of a row are
+                  updated by the cross kernel of kernels.cpp, in AVX2 or AVX-512 when the
+                  CPU has them. The correlation of every pair is read while its tile is hot
+                  and added to the mean of both currencies.
+                  Every ResyncSamples the sums are recomputed from the ring so the rounding
+                  errors of adding and removing samples do not accumulate.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "correlation.h"
+#include "snapshot.h"
+#include "kernels.h"
+#include "trace.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+
+// Market correlations keep two matrices of N x N doubles
+static const size_t MaxMarket = 4096;
+
+// Follow the currencies "ids", compared with "references" or with the market if there are none,
+// over windows of "count" samples taken every "seconds". The returns already sampled for the
+// currencies that stay are kept, unless the window changed.
+void Correlations::configure(const std::vector<int> &ids, const std::vector<int> &references, size_t count, double seconds)
+{
+    count = std::max<size_t>(4, count);
+    interval = seconds;
+    std::vector<size_t> columns;
+    for (int reference : references)
+    {
+        auto found = std::find(ids.begin(), ids.end(), reference);
+        if (found != ids.end())
+        {
+            columns.push_back(found - ids.begin());
+        }
+    }
+    bool everything = references.empty();
+    if (everything && ids.size() > MaxMarket)
+    {
+        Alert(std::vector<std::string> (1,"The market correlations of more than " + std::to_string(MaxMarket) + " currencies need too much memory, set correlationReferences to a few currencies"),"error");
+        everything = false;
+    }
+    if (ids == tracked && count == samples && everything == market && (everything || columns == rows) && sum.size() == width)
+    {
+        return;
+    }
+
+    // Returns of the currencies that stay, at the same rows of the ring
+    size_t padded = (ids.size() + Lanes - 1)/Lanes*Lanes;
+    std::vector<double> ring(count*padded, 0);
+    std::vector<double> last(ids.size(), 0);
+    std::vector<size_t> consecutive(ids.size(), 0);
+    std::unordered_map<int, size_t> before;
+    for (size_t column = 0; column < tracked.size(); column++)
+    {
+        before[tracked[column]] = column;
+    }
+    for (size_t column = 0; column < ids.size(); column++)
+    {
+        auto found = before.find(ids[column]);
+        if (found == before.end())
+        {
+            continue;
+        }
+        last[column] = previous[found->second];
+        consecutive[column] = count == samples ? valid[found->second] : 0;
+        for (size_t row = 0; count == samples && row < samples; row++)
+        {
+            ring[row*padded + column] = returns[row*width + found->second];
+        }
+    }
+    taken = count == samples ? taken : 0;
+    tracked = ids;
+    rows = columns;
+    market = everything;
+    samples = count;
+    quarter = samples/4;
+    width = padded;
+    returns.swap(ring);
+    previous.swap(last);
+    valid.swap(consecutive);
+    if (market)
+    {
+        rows.resize(tracked.size());
+        for (size_t column = 0; column < rows.size(); column++)
+        {
+            rows[column] = column;
+        }
+    }
+    resync();
+}
+
+// Take a sample if one is due at "now", "prices" holds the last price of every currency of
+// ids(), 0 if it has none. Returns true if the correlations were updated.
+bool Correlations::sample(double now, const std::vector<double> &prices)
+{
+    if (samples == 0 || now < next || prices.size() != tracked.size())
+    {
+        return false;
+    }
+    Trace span(Correlate);
+    next = now + interval;
+    std::vector<double> fresh(width, 0);
+    for (size_t column = 0; column < tracked.size(); column++)
+    {
+        bool known = previous[column] > 0 && prices[column] > 0;
+        fresh[column] = known ? (prices[column] - previous[column])/previous[column] : 0;
+        valid[column] = known ? valid[column] + 1 : 0;
+        previous[column] = prices[column] > 0 ? prices[column] : previous[column];
+    }
+    std::vector<double> zeros(width, 0);
+    const double* leaving = taken >= samples ? &returns[(taken % samples)*width] : zeros.data();
+    const double* leavingRecent = taken >= quarter ? &returns[((taken - quarter) % samples)*width] : zeros.data();
+    update(fresh.data(), leaving, leavingRecent);
+    std::copy(fresh.begin(), fresh.end(), returns.begin() + (taken % samples)*width);
+    taken++;
+    if (taken % ResyncSamples == 0)
+    {
+        resync();
+    }
+    return true;
+}
+
+// Correlation of a currency (its position in ids()) with the p-th partner over the whole
+// window, NaN without a full window of both
+double Correlations::longer(size_t column, size_t p) const
+{
+    if (!ready(column) || p >= partners() || (!market && (rows[p] == column || !ready(rows[p]))))
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return correlation[p*width + column];
+}
+
+// Same over the last quarter of the window
+double Correlations::recent(size_t column, size_t p) const
+{
+    if (!ready(column) || p >= partners() || (!market && (rows[p] == column || !ready(rows[p]))))
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return recentCorrelation[p*width + column];
+}
+
+// Means and inverses of the standard deviations (times sqrt(n)) of the currencies with a full window
+void Correlations::statistics()
+{
+    for (size_t column = 0; column < width; column++)
+    {
+        bool full = ready(column);
+        double all = squares[column] - sum[column]*sum[column]/samples;
+        double last = recentSquares[column] - recentSum[column]*recentSum[column]/quarter;
+        mean[column] = sum[column]/samples;
+        recentMean[column] = recentSum[column]/quarter;
+        inverse[column] = full && all > 0 ? 1/std::sqrt(all) : 0;
+        recentInverse[column] = full && last > 0 ? 1/std::sqrt(last) : 0;
+    }
+}
+
+// Add the returns "r" to both windows, remove "o" from the whole window and "q" from the last
+// quarter, then read the correlations. Currencies without a full window have inverse 0, so their
+// correlations are 0 and add nothing to the means of the market.
+void Correlations::update(const double* r, const double* o, const double* q)
+{
+    for (size_t column = 0; column < width; column++)
+    {
+        sum[column] += r[column] - o[column];
+        squares[column] += r[column]*r[column] - o[column]*o[column];
+        recentSum[column] += r[column] - q[column];
+        recentSquares[column] += r[column]*r[column] - q[column]*q[column];
+    }
+    statistics();
+    const KernelSet &set = kernels();
+    CrossTile tile;
+    tile.r = r;
+    tile.o = o;
+    tile.q = q;
+    tile.mean = mean.data();
+    tile.inverse = inverse.data();
+    tile.recentMean = recentMean.data();
+    tile.recentInverse = recentInverse.data();
+
+    if (!market)
+    {
+        tile.columnSum = nullptr;
+        tile.recentColumnSum = nullptr;
+        for (size_t k = 0; k < rows.size(); k++)
+        {
+            size_t a = rows[k];
+            tile.all = &cross[k*width];
+            tile.last = &recentCross[k*width];
+            tile.value = &correlation[k*width];
+            tile.recentValue = &recentCorrelation[k*width];
+            set.cross({r[a], o[a], q[a], sum[a], recentSum[a], inverse[a], recentInverse[a]}, tile, 0, width);
+        }
+        return;
+    }
+
+    // Sums of the correlations of every currency, over the rows (rowSums) and the columns (colSums)
+    // of the upper triangle of tiles. The correlations of a pair are only needed in these sums.
+    std::vector<double> rowSums(2*width, 0), colSums(2*width, 0);
+    tile.value = nullptr;
+    tile.recentValue = nullptr;
+    const size_t count = tracked.size();
+    for (size_t top = 0; top < count; top += Tile)
+    {
+        for (size_t left = top; left < width; left += Tile)
+        {
+            const size_t right = std::min(left + Tile, width);
+            // Pairs of a diagonal tile are seen from both of their rows
+            const bool diagonal = left == top;
+            tile.columnSum = diagonal ? nullptr : colSums.data();
+            tile.recentColumnSum = diagonal ? nullptr : colSums.data() + width;
+            for (size_t i = top; i < std::min(top + Tile, count); i++)
+            {
+                tile.all = &cross[i*width];
+                tile.last = &recentCross[i*width];
+                tile.rowSum = 0;
+                tile.recentRowSum = 0;
+                set.cross({r[i], o[i], q[i], sum[i], recentSum[i], inverse[i], recentInverse[i]}, tile, left, right);
+                rowSums[i] += tile.rowSum;
+                rowSums[width + i] += tile.recentRowSum;
+            }
+        }
+    }
+
+    // Mean of the correlations with the other currencies, without the correlation with itself
+    size_t full = 0;
+    for (size_t column = 0; column < count; column++)
+    {
+        full += ready(column) ? 1 : 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        double self = (cross[i*width + i] - sum[i]*mean[i])*inverse[i]*inverse[i];
+        double recentSelf = (recentCross[i*width + i] - recentSum[i]*recentMean[i])*recentInverse[i]*recentInverse[i];
+        correlation[i] = full > 1 ? (rowSums[i] + colSums[i] - self)/(full - 1) : 0;
+        recentCorrelation[i] = full > 1 ? (rowSums[width + i] + colSums[width + i] - recentSelf)/(full - 1) : 0;
+    }
+}
+
+// Recompute every sum from the returns in the ring, by adding its rows in the order they came
+void Correlations::resync()
+{
+    sum.assign(width, 0);
+    squares.assign(width, 0);
+    recentSum.assign(width, 0);
+    recentSquares.assign(width, 0);
+    mean.assign(width, 0);
+    inverse.assign(width, 0);
+    recentMean.assign(width, 0);
+    recentInverse.assign(width, 0);
+    cross.assign(rows.size()*width, 0);
+    recentCross.assign(rows.size()*width, 0);
+    correlation.assign(partners()*width, 0);
+    recentCorrelation.assign(partners()*width, 0);
+    std::vector<double> zeros(width, 0);
+    size_t first = taken > samples ? taken - samples : 0;
+    for (size_t t = first; t < taken; t++)
+    {
+        const double* leavingRecent = t >= first + quarter ? &returns[((t - quarter) % samples)*width] : zeros.data();
+        update(&returns[(t % samples)*width], zeros.data(), leavingRecent);
+    }
+}
+
+// Returns sampled, the sums are recomputed when configure() is called after restore()
+void Correlations::save(SnapshotWriter &out) const
+{
+    out.put(tracked);
+    out.put(static_cast<uint64_t>(samples));
+    out.put(static_cast<uint64_t>(width));
+    out.put(static_cast<uint64_t>(taken));
+    out.put(next);
+    out.put(returns);
+    out.put(previous);
+    out.put(valid);
+}
+
+bool Correlations::restore(SnapshotReader &in)
+{
+    uint64_t count = 0, padded = 0, sampled = 0;
+    if (!in.get(tracked) || !in.get(count) || !in.get(padded) || !in.get(sampled) || !in.get(next) || !in.get(returns)
+        || !in.get(previous) || !in.get(valid) || returns.size() != count*padded || previous.size() != tracked.size()
+        || valid.size() != tracked.size() || padded < tracked.size())
+    {
+        *this = Correlations();
+        return false;
+    }
+    samples = count;
+    width = padded;
+    taken = sampled;
+    rows.clear();
+    market = false;
+    return true;
+}
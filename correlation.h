@@ -0,0 +1,62 @@
+#ifndef correlation_h
+#define correlation_h
+#include <vector>
+#include <string>
+#include <cstddef>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Rolling correlations of the returns of the currencies, sampled from their last price every
+// "interval" seconds. The returns of the last "window" samples are kept in a ring. The sums and
+// cross products of the whole window and of its last quarter are updated as a sample comes in
+// and the oldest one leaves. With reference currencies each currency is compared with them, in
+// O(N) per reference and sample. Without them every pair is tracked, in O(N^2) per sample over
+// tiles of the matrix, and each currency is compared with the market: the mean of its
+// correlations with the others.
+class Correlations
+{
+public:
+    static constexpr size_t Lanes = 8;            // columns are padded to a multiple of the widest vector
+    static constexpr size_t Tile = 64;            // rows and columns of a tile of the matrix
+    static constexpr size_t ResyncSamples = 1024; // samples between two recomputations from the ring
+
+    void configure(const std::vector<int> &ids, const std::vector<int> &references, size_t samples, double interval);
+    bool sample(double now, const std::vector<double> &prices);
+    const std::vector<int>& ids() const { return tracked; }
+    size_t partners() const { return market ? 1 : rows.size(); }
+    int partner(size_t p) const { return market ? -1 : tracked[rows[p]]; }
+    double longer(size_t column, size_t p) const;
+    double recent(size_t column, size_t p) const;
+    size_t window() const { return samples; }
+    double seconds() const { return interval; }
+    void save(SnapshotWriter &out) const;
+    bool restore(SnapshotReader &in);
+
+private:
+    bool ready(size_t column) const { return column < tracked.size() && valid[column] >= samples; }
+    void statistics();
+    void update(const double* r, const double* o, const double* q);
+    void resync();
+
+    std::vector<int> tracked;            // Currencies.ID of every column
+    std::vector<size_t> rows;            // columns of the references, every column for the market
+    bool market = false;
+    size_t samples = 0;                  // 0 until configured
+    size_t quarter = 0;
+    double interval = 300;               // seconds between samples
+    double next = 0;                     // time of the next sample
+    size_t width = 0;                    // columns padded to a multiple of Lanes
+    size_t taken = 0;                    // samples in the ring, the newest is at (taken - 1) % samples
+    std::vector<double> returns;         // ring of "samples" rows of "width" returns
+    std::vector<double> previous;        // price of every column at the last sample, 0 if unknown
+    std::vector<size_t> valid;           // consecutive samples with a return of every column
+
+    // Sums of the window (all) and of its last quarter (recent)
+    std::vector<double> sum, squares, recentSum, recentSquares;
+    std::vector<double> mean, inverse, recentMean, recentInverse;  // inverse of sqrt(n*variance), 0 if not ready
+    std::vector<double> cross, recentCross;                      // rows.size() x width
+    std::vector<double> correlation, recentCorrelation;          // partners() x width
+};
+
+#endif
@@ -3,10 +3,15 @@
     Filename:  database.cpp
     
     Description:  This program handles the SQLite database Crypto.db. It calls the CoinGecko API 
-                  with requests for each currency in the table Currencies and adds new prices 
-                  to the database, if they changed. If changes occurred, the Python 
-                  statistical analysis program is called by program.cpp, which could trigger a 
-                  SMTP alert. 
+                  (fetch.cpp) with requests for each currency in the table Currencies and adds new prices 
+                  to the database, if they changed. The new prices are published as one batch to the
+                  pipeline (pipeline.cpp), whose threads save them, run the analyses and send the
+                  alerts they trigger, so the next API call never waits for them.
+
+                  A currency added in the GUI first gets its recent history from the
+                  /coins/{id}/market_chart endpoint, every new currency at the same time and
+                  within the API budget, so its analyses don't wait for "minimumData" prices.
+                  The history goes through the pipeline like any other prices.
                   
     Version:  1.0 Changes:
     Created:  01/22/2025
@@ -18,289 +23,277 @@
 */
 
 #include "headers.h"
+#include "pipeline.h"
+#include "persistence.h"
+#include "fetch.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "config.h"
+#include "trace.h"
 #include <stdio.h>
 #include <sqlite3.h>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <curl/curl.h>
+#include <chrono>
 #include <ctime>
+#include <algorithm>
+#include <cmath>
+#include <memory>
 
-int update(sqlite3 *db,std::vector<std::string> &names, std::vector<double> &time, std::vector<std::string> &date, std::vector<double> &price);
-int API(sqlite3 *db);
-size_t curlCallback(void* contents, size_t size, size_t nmemb, std::string* userp);
+int update(Persistence &db,const std::vector<std::string> &names, const std::vector<char> &found, const std::vector<double> &time, const std::vector<double> &price, Pipeline &pipeline, const std::string &mode);
 std::string UNIX(std::string unix_time);
 
-int database()
+// Requests the currencies that the scheduler considers due. db.refresh() and schedule.configure()
+// are expected to have been called with the current Currencies.
+int database(Persistence &db, Fetcher &api, Scheduler &schedule, Pipeline &pipeline, const std::string &mode)
 {
-    sqlite3* db;
-    int updates;
-    if (sqlite3_open("Crypto.db",&db) != SQLITE_OK)
+    if (db.names().empty())
     {
-        Alert(std::vector<std::string> (1,"Error opening database, probably the database is missing: " + std::string(sqlite3_errmsg(db))),"error");
+        Alert(std::vector<std::string> (1,"You haven't defined any cryptos to query"),"local");
         return -1;
     }
-    updates = API(db);
-    sqlite3_close(db);
-    return updates;
+    api.configure(db);
+    backfill(db,api,schedule,pipeline,mode);
+    std::vector<std::string> names = schedule.due(db,api.chunk());
+    if (names.empty())
+    {
+        return 0;
+    }
+    return API(db,api,schedule,names,pipeline,mode);
 }
 
-// Calls Gecko API then update() whose output is returned
-// Returns: 0 without changes, -1 with errors, and > 0 if that number of database changes ocurred.
-int API(sqlite3 *db)
+// Calls Gecko API for the names given then update() whose output is returned. The currencies are
+// requested in chunks, a chunk that fails is reported and its currencies are skipped until the
+// next call. The scheduler is told which currencies were received and about rate limits.
+// Returns: 0 without changes, -1 with errors, and > 0 if that number of changes were published.
+int API(Persistence &db, Fetcher &api, Scheduler &schedule, const std::vector<std::string> &names, Pipeline &pipeline, const std::string &mode)
 {
-    const std::string url = "https://api.coingecko.com/api/v3";
-    const std::string Query = "SELECT GeckoID FROM Currencies;";
+    Trace span(Api);
     const std::string currency = "usd";
-    std::vector<std::string> Endpoints = {"/simple/price?ids=","/ping"};
-    std::string Request;
-    std::string Response;
-    std::vector<std::string> Data;
-    std::vector<std::string> names, names_returned;
-    std::vector<std::string> date;
-    std::vector<double> time;
-    std::vector<double> price;
-    CURL* curl;
-    CURLcode flag;;
-    std::string subresponse;
-    int j = 0,k = 0, i,flag2,begin,end;
+    std::vector<double> time(names.size());
+    std::vector<double> price(names.size());
+    std::vector<char> found(names.size(), 0);
+    size_t failed = 0;
+    bool limited = false;
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<Chunk> chunks = api.fetch(names,currency,price.data(),time.data(),found.data());
+    metrics.fetchSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
 
-    // find what currencies to request
-    sqlite3_stmt* stmt;
-    flag2 = sqlite3_prepare_v2(db,Query.c_str(),-1,&stmt,nullptr);
-    if (flag2 == SQLITE_OK)
+    for (const Chunk &chunk : chunks)
     {
-        while (sqlite3_step(stmt) == SQLITE_ROW)
+        const std::string &Data = chunk.response;
+        if (chunk.result != CURLE_OK)
         {
-            names.push_back( reinterpret_cast<const char*>(sqlite3_column_text(stmt,0)) );
-            Endpoints[0] = Endpoints[0] + names[j] + "%2C";
-            j++;
+            Alert(std::vector<std::string> (1,"Failed to use curl. Your internet is probably down: " + std::string(curl_easy_strerror(chunk.result))),"error");
+            metrics.fetchErrors++;
         }
-        if (j == 0)
+        else if (chunk.status == 429 || Data.find("exceeded the Rate Limit") != std::string::npos)
         {
-            Alert(std::vector<std::string> (1,"You haven't defined any cryptos to query"),"local");
-            sqlite3_finalize(stmt);
-            return -1;
-        }      
-        Endpoints[0].erase(Endpoints[0].end() - 3, Endpoints[0].end()); // remove the extra comma
-        Endpoints[0] = Endpoints[0] + "&vs_currencies=" + currency + "&include_last_updated_at=true";
-    }
-    else
-    {
-        Alert(std::vector<std::string> (1,"Error reading database: " + std::string(sqlite3_errmsg(db))),"error");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
-    // Call each endpoint
-    for (int i = 0; i < Endpoints.size(); i++)
-    {
-        curl = curl_easy_init();
-        if (curl) 
+            Alert(std::vector<std::string> (1,"Rate limited, server response: " + Data),"error");
+            metrics.rateLimited++;
+            limited = true;
+        }
+        else if (chunk.status != 200 || !chunk.parser.complete())
         {
-            Request = url + Endpoints[i];
-            //std::cout<< Request << std::endl; 
-            curl_easy_setopt(curl, CURLOPT_URL, Request.c_str());
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &Response);
-
-            flag = curl_easy_perform(curl);
-
-            if (flag != CURLE_OK) 
-            {
-                Alert(std::vector<std::string> (1,"Failed to use curl. Your internet is probably down"),"error");
-                sqlite3_finalize(stmt);
-                return -1;
-            } 
-            else
-            {
-                //std::cout << "raw response: " << Response << std::endl;
-                Data.push_back(Response);
-            }
-            curl_easy_cleanup(curl);
+            Alert(std::vector<std::string> (1,"API may be down, response: " + Data),"error");
+            metrics.fetchErrors++;
         }
-        else 
+        else
         {
-            Alert(std::vector<std::string> (1,"Failed to initialize curl"),"error");
-            sqlite3_finalize(stmt);
-            return -1;
+            continue;
         }
+        // Prices read before the error are not trusted
+        std::fill(found.begin() + chunk.begin, found.begin() + chunk.end, 0);
+        failed++;
     }
-    const std::string test = "{\"gecko_says\":\"(V3) To the Moon!\"}";
-
-    if(Data[1].find("exceeded the Rate Limit") != std::string::npos)
+    if (limited)
     {
-        Alert(std::vector<std::string> (1,"Rate limited, server response: " + Data[0]),"error");
-        sqlite3_finalize(stmt);
-        return -1;
+        schedule.limited();
     }
-    else if (Data[1].find( test ) == std::string::npos)
+    else
+    {
+        schedule.recovered();
+    }
+    if (failed == chunks.size())
     {
-        Alert(std::vector<std::string> (1,"API may be down, response: " + Data[1]),"error");
-        sqlite3_finalize(stmt);
         return -1;
     }
-    else
+    metrics.lastFetch = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    int updates = update(db,names,found,time,price,pipeline,mode);
+    if (updates >= 0)
     {
-        // assign date and price
-        for(i = 0; i < j; i++)
+        // Currencies refused by a full queue stay due, so they are requested again on the next call
+        for (size_t i = 0; i < names.size(); i++)
         {
-            if(Data[0].find("\"" + names[i]+"\"") == std::string::npos)
+            if (found[i] == PriceParser::Found)
             {
-                k++;
-                continue;
+                schedule.fetched(db.id(names[i]));
             }
-            names_returned.push_back(names[i]);
-            subresponse = Data[0].substr(Data[0].find(names[i]));
-            begin = subresponse.find(currency);
-
-            // Maybe put this inside previous if
-
-            if(begin == std::string::npos)
-            {
-                Alert(std::vector<std::string> (1,"Error retrieving the crypto " + names[i] + " from API"),"error");
-                sqlite3_finalize(stmt);
-                return -1;
-            }
-            else
-            {
-                begin = subresponse.find_first_of("0123456789.",begin);
-                end = subresponse.find_first_not_of("0123456789.",begin);
-                price.push_back(std::stod(subresponse.substr(begin,end-begin)));
-                begin = subresponse.find_first_of("0123456789.",end);
-                date.push_back( UNIX(subresponse.substr(begin, subresponse.find_first_not_of("0123456789.",begin)-begin)) );
-                time.push_back( std::stod(subresponse.substr(begin, subresponse.find_first_not_of("0123456789.",begin)-begin)) );
-                ;
-            }
-
         }
     }
-    sqlite3_finalize(stmt);
-    return update(db,names_returned,time,date,price);
+    return updates;
 }
 
-// New entry in the database with new date/price for each currency from API response.
-// Only updates the currencies that have changed. 
-// returns 0 without changes, -1 with errors, and updated > 0 if database changes ocurred.
-int update(sqlite3 *db,std::vector<std::string> &names, std::vector<double> &time, std::vector<std::string> &date, std::vector<double> &price)
+// Requests the history of the currencies added since the last call, as many as the budget allows,
+// and publishes their prices inside "timeWindow" as one batch that the pipeline saves in one
+// transaction, like the prices of update(). Currencies that already have prices, or whose history
+// can't be read, go straight to the regular calls; those stopped by the budget, a transfer error,
+// a rate limit or a full queue are requested again on the next call.
+// Returns the number of prices published, or -1 with errors.
+int backfill(Persistence &db, Fetcher &api, Scheduler &schedule, Pipeline &pipeline, const std::string &mode)
 {
-    sqlite3_stmt* stmt;
-    sqlite3_stmt* chck;
-    sqlite3_stmt* nchck;
-    const char* Statement = "INSERT INTO Prices (\"CurrencyID\",\"time\",\"date\",\"price\") VALUES (?,?,?,?);";
-    const char* nameCheck = "SELECT ID FROM Currencies WHERE GeckoID = ?;";
-    const char* Check = "SELECT * FROM Prices WHERE CurrencyID = ? ORDER BY PriceID DESC LIMIT 1;";
-    std::vector<int> IDs;
-    int flag, flag2;
-    int updated = 0;
+    const std::string currency = "usd";
+    std::shared_ptr<const Config> current = config.get();
+    double now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<std::string> names;
+    std::vector<int> days;
+    std::vector<double> since;
 
-    // Extract internal crypto ID corresponding to each name returned by API
-    for(int i = 0; i < names.size(); i++)
+    for (const std::string &name : schedule.newcomers(db))
     {
-        flag = sqlite3_prepare_v2(db,nameCheck,-1,&nchck,nullptr);
-        if (flag == SQLITE_OK)
+        int id = db.id(name);
+        if (pipeline.known(id))
         {
-            sqlite3_bind_text(nchck,1,names[i].c_str(),names[i].size(),nullptr);
-            if (sqlite3_step(nchck) != SQLITE_ROW)
-            {
-                Alert(std::vector<std::string> (1,"Error reading crypto IDs internally: " + std::string(sqlite3_errmsg(db))),"error");
-                sqlite3_finalize(nchck);
-                return -1;
-            }
-            IDs.push_back(sqlite3_column_int(nchck,0));
-            if (sqlite3_step(nchck) == SQLITE_ROW)
-            {
-                Alert(std::vector<std::string> (1,"Duplicated ID entries for the same crypto currency: " + names[i] + ", the database in your computer is not reliable. Aborting."),"error");
-                sqlite3_finalize(nchck);
-                return -1;
-            }
-            sqlite3_finalize(nchck);
-            }
-        else
+            schedule.backfilled(id);
+            continue;
+        }
+        double hours = Thresholds().timeWindow;
+        for (const CurrencyConfig &followed : current->currencies)
         {
-            Alert(std::vector<std::string> (1,"Error reading crypto IDs internally: " + std::string(sqlite3_errmsg(db)) ),"error");
-            sqlite3_finalize(nchck);
-            return -1;
+            hours = followed.id == id ? followed.limits.timeWindow : hours;
         }
+        names.push_back(name);
+        days.push_back(std::max(1, static_cast<int>(std::ceil(hours/24))));
+        since.push_back(now - 3600*hours);
+    }
+    names.resize(schedule.spend(names.size()));
+    if (names.empty())
+    {
+        return 0;
     }
 
-    
-    for (int i = 0; i < IDs.size() ; i++) // for each currency of interest
+    PriceBatch batch;
+    std::vector<int> done;
+    bool limited = false;
+    batch.mode = mode;
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<Chart> charts = api.history(names,days,currency);
+    metrics.fetchSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    for (const Chart &chart : charts)
     {
-        flag = sqlite3_prepare_v2(db,Check,-1,&chck,nullptr);
-        if(flag != SQLITE_OK)
+        const std::string &name = names[chart.index];
+        if (chart.result != CURLE_OK)
         {
-            Alert(std::vector<std::string> (1,"Error preparing statements: " + std::string(sqlite3_errmsg(db)) ),"error");
-            sqlite3_finalize(chck);
-            return -1;
+            Alert(std::vector<std::string> (1,"Failed to request the history of " + name + ": " + std::string(curl_easy_strerror(chart.result))),"error");
+            metrics.fetchErrors++;
+            continue;
         }
-        else if (sqlite3_prepare_v2(db,Statement,-1,&stmt,nullptr) != SQLITE_OK)
+        if (chart.status == 429 || chart.response.find("exceeded the Rate Limit") != std::string::npos)
         {
-            Alert(std::vector<std::string> (1,"Error preparing statements: " + std::string(sqlite3_errmsg(db)) ),"error");
-            sqlite3_finalize(stmt);
-            return -1;
+            metrics.rateLimited++;
+            limited = true;
+            continue;
         }
-
-        sqlite3_bind_int(chck,1,IDs[i]);
-        flag2 = sqlite3_step(chck);
-
-        if(flag2 == SQLITE_ROW || flag2 == 101)
+        if (!chart.parsed)
         {
-            // Check if price changed since last API call
-            if(std::abs(price[i] - sqlite3_column_double(chck, 4)) < 0.0000002)
-            {
-                sqlite3_step(chck);
-                sqlite3_finalize(stmt);
-                sqlite3_finalize(chck);
-                continue;
-            }
-            else // Append to db
+            Alert(std::vector<std::string> (1,"The history of " + name + " is not available, its analyses wait for new prices. Response: " + chart.response.substr(0, 512)),"error");
+            metrics.fetchErrors++;
+        }
+        for (size_t i = 0; chart.parsed && i < chart.times.size(); i++)
+        {
+            if (chart.times[i] >= since[chart.index])
             {
-                sqlite3_bind_int(stmt,1,IDs[i]);
-                sqlite3_bind_double(stmt,2,time[i]);
-                sqlite3_bind_text(stmt,3,date[i].c_str(),19,nullptr); // call UNIX to date
-                sqlite3_bind_double(stmt,4,price[i]);
-                if(sqlite3_step(stmt) == SQLITE_DONE)
-                {
-                    updated++;
-                }
-                else
-                {
-                    Alert(std::vector<std::string> (1,"Error writing changes to database: " + std::string(sqlite3_errmsg(db)) ),"error");
-                    sqlite3_finalize(stmt);
-                    sqlite3_finalize(chck);
-                    return -1;
-                }
-                
+                batch.ids.push_back(db.id(name));
+                batch.times.push_back(chart.times[i]);
+                batch.prices.push_back(chart.prices[i]);
             }
         }
-        else
+        done.push_back(db.id(name));
+    }
+    if (limited)
+    {
+        schedule.limited();
+    }
+
+    int published = batch.ids.size();
+    if (published > 0 && !pipeline.publish(std::move(batch)))
+    {
+        Alert(std::vector<std::string> (1,"The pipeline is falling behind, the history of the new currencies will be requested again"),"error");
+        return -1;
+    }
+    for (int id : done)
+    {
+        schedule.backfilled(id);
+    }
+    if (published > 0)
+    {
+        Alert(std::vector<std::string> (1,"The history of " + std::to_string(done.size()) + " new currencies was saved (" + std::to_string(published) + " prices)"),"local");
+    }
+    return published;
+}
+
+// Publishes a new date/price for each currency found in the API response whose price changed
+// from the last one published, all of them in one batch that the pipeline saves in one transaction.
+// returns 0 without changes, -1 with errors or a full queue, and updated > 0 if changes were published.
+int update(Persistence &db,const std::vector<std::string> &names, const std::vector<char> &found, const std::vector<double> &time, const std::vector<double> &price, Pipeline &pipeline, const std::string &mode)
+{
+    Trace span(Update);
+    std::vector<int> IDs(names.size(), -1);
+    PriceBatch batch;
+    batch.mode = mode;
+
+    // Extract internal crypto ID corresponding to each name returned by API
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        if (found[i] != PriceParser::Found)
+        {
+            continue;
+        }
+        IDs[i] = db.id(names[i]);
+        if (IDs[i] < 0)
         {
-            Alert(std::vector<std::string> (1,"Error performing query: " + std::string(sqlite3_errmsg(db)) ),"error");
-            sqlite3_finalize(stmt);
-            sqlite3_finalize(chck);
+            Alert(std::vector<std::string> (1,"Error reading crypto IDs internally: " + names[i] + " is not followed"),"error");
             return -1;
         }
-        sqlite3_finalize(stmt);
-        sqlite3_finalize(chck);
+        // Check if price changed since last API call
+        if (pipeline.changed(IDs[i],price[i]))
+        {
+            batch.ids.push_back(IDs[i]);
+            batch.times.push_back(time[i]);
+            batch.prices.push_back(price[i]);
+        }
+    }
+    if (batch.ids.empty())
+    {
+        return 0;
     }
-    return updated;
-}
 
-// Function required to save output into variables when calling the API
-size_t curlCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    size_t totalSize = size * nmemb;
-    userp->append(static_cast<char*>(contents), totalSize);
-    return totalSize;
+    int updated = batch.ids.size();
+    if (!pipeline.publish(std::move(batch)))
+    {
+        std::string depths = "The pipeline is falling behind, prices will be requested again. Queues (depth/capacity):";
+        for (const QueueMetrics &queue : pipeline.metrics())
+        {
+            depths += " " + std::string(queue.name) + " " + std::to_string(queue.depth) + "/" + std::to_string(queue.capacity);
+        }
+        Alert(std::vector<std::string> (1,depths),"error");
+        return -1;
+    }
+    return updated;
 }
 
 // Function to convert UNIX output given by the API to format: YYYY-MM-DD HH:MM:SS before saving to database
 std::string UNIX(std::string unix_time)
 {
     const std::time_t unix_time_t = std::stoll(unix_time);
-    std::tm* local_time = std::localtime(&unix_time_t);
+    std::tm local_time;  // localtime_r, the pipeline threads convert dates too
+    localtime_r(&unix_time_t, &local_time);
 
     char temp[100];
-    if (std::strftime(temp, sizeof(temp), "%Y-%m-%d %H:%M:%S", local_time)) {
+    if (std::strftime(temp, sizeof(temp), "%Y-%m-%d %H:%M:%S", &local_time)) {
         std::string result(temp);
         return result;
     } else {
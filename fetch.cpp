@@ -0,0 +1,219 @@
+/** ========================================================================================
+
+    Filename:  fetch.cpp
+
+    Description:  Calls the CoinGecko /simple/price endpoint for an arbitrarily large list of
+                  currencies. The GeckoIDs are split in chunks so no URL gets too long, and the
+                  chunks are requested concurrently through a curl multi handle that keeps its
+                  connections alive between API calls, asking for gzip responses. A chunk that
+                  fails only affects its own currencies. Responses are parsed while they are
+                  received (parser.cpp). The history of the currencies just added is
+                  requested from /coins/{id}/market_chart the same way, one request per
+                  currency (see backfill() in database.cpp).
+
+                  Settings: "apiUrl" (default https://api.coingecko.com/api/v3, can point to a
+                  local server), "chunkSize" (default 100 GeckoIDs per request) and
+                  "connections" (default 4 simultaneous connections).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "fetch.h"
+#include "persistence.h"
+#include "trace.h"
+#include <algorithm>
+#include <stdexcept>
+
+size_t curlCallback(void* contents, size_t size, size_t nmemb, Chunk* userp);
+static size_t chartCallback(void* contents, size_t size, size_t nmemb, Chart* chart);
+
+Fetcher::Fetcher()
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi = curl_multi_init();
+}
+
+Fetcher::~Fetcher()
+{
+    for (CURL* curl : pool)
+    {
+        curl_easy_cleanup(curl);
+    }
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+}
+
+// Read the endpoint, chunk size and number of connections from the Settings table
+void Fetcher::configure(Persistence &db)
+{
+    url = db.setting("apiUrl", url);
+    try
+    {
+        chunkSize = std::max(1L, std::stol(db.setting("chunkSize", std::to_string(chunkSize))));
+        connections = std::max(1L, std::stol(db.setting("connections", std::to_string(connections))));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid chunkSize or connections setting, keeping the previous values"),"error");
+    }
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, connections);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, connections);
+}
+
+// Easy handles for that many simultaneous requests, as many as could be created
+void Fetcher::reserve(size_t handles)
+{
+    while (pool.size() < handles)
+    {
+        CURL* curl = curl_easy_init();
+        if (!curl)
+        {
+            break;
+        }
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");   // gzip or whatever curl supports
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        pool.push_back(curl);
+    }
+}
+
+// Run the requests added to the multi handle until all of them are done, then remove them.
+// Returns every handle with the result of its transfer.
+std::vector<std::pair<CURL*, CURLcode>> Fetcher::perform()
+{
+    std::vector<std::pair<CURL*, CURLcode>> done;
+    int running = 0;
+    do
+    {
+        curl_multi_perform(multi, &running);
+        if (running > 0)
+        {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    } while (running > 0);
+
+    CURLMsg* message;
+    int left;
+    while ((message = curl_multi_info_read(multi, &left)) != nullptr)
+    {
+        if (message->msg == CURLMSG_DONE)
+        {
+            done.emplace_back(message->easy_handle, message->data.result);
+        }
+    }
+    for (const auto &transfer : done)
+    {
+        curl_multi_remove_handle(multi, transfer.first);
+    }
+    return done;
+}
+
+// Request the prices of every name, in chunks. Prices and times are written to the arrays given at
+// the position of each name, found[i] is PriceParser::Found if both were received.
+// Returns one Chunk per request, the caller checks each one's result and status.
+std::vector<Chunk> Fetcher::fetch(const std::vector<std::string> &names, const std::string &currency, double* prices, double* times, char* found)
+{
+    Trace span(Fetch);
+    std::vector<Chunk> chunks((names.size() + chunkSize - 1)/chunkSize);
+    std::vector<std::string> requests(chunks.size());
+
+    reserve(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        Chunk &chunk = chunks[i];
+        chunk.begin = i*chunkSize;
+        chunk.end = std::min(names.size(), chunk.begin + chunkSize);
+        chunk.parser = PriceParser(names, chunk.begin, chunk.end, currency, prices, times, found);
+        if (i >= pool.size())
+        {
+            chunk.result = CURLE_FAILED_INIT;
+            continue;
+        }
+        requests[i] = url + "/simple/price?ids=";
+        for (size_t j = chunk.begin; j < chunk.end; j++)
+        {
+            requests[i] += names[j] + (j + 1 < chunk.end ? "%2C" : "");
+        }
+        requests[i] += "&vs_currencies=" + currency + "&include_last_updated_at=true";
+
+        curl_easy_setopt(pool[i], CURLOPT_URL, requests[i].c_str());
+        curl_easy_setopt(pool[i], CURLOPT_WRITEFUNCTION, curlCallback);
+        curl_easy_setopt(pool[i], CURLOPT_WRITEDATA, &chunk);
+        curl_easy_setopt(pool[i], CURLOPT_PRIVATE, &chunk);
+        curl_multi_add_handle(multi, pool[i]);
+    }
+
+    for (const auto &transfer : perform())
+    {
+        Chunk* chunk;
+        curl_easy_getinfo(transfer.first, CURLINFO_PRIVATE, &chunk);
+        curl_easy_getinfo(transfer.first, CURLINFO_RESPONSE_CODE, &chunk->status);
+        chunk->result = transfer.second;
+    }
+    return chunks;
+}
+
+// Request the market chart of the last days[i] days of every name, all of them at the same time
+// within the connections allowed. CoinGecko returns a price every 5 minutes up to 1 day, hourly
+// up to 90 days. Returns one Chart per name, the caller checks each one's result and status.
+std::vector<Chart> Fetcher::history(const std::vector<std::string> &names, const std::vector<int> &days, const std::string &currency)
+{
+    Trace span(History);
+    std::vector<Chart> charts(names.size());
+    std::vector<std::string> requests(names.size());
+
+    reserve(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        charts[i].index = i;
+        if (i >= pool.size())
+        {
+            charts[i].result = CURLE_FAILED_INIT;
+            continue;
+        }
+        requests[i] = url + "/coins/" + names[i] + "/market_chart?vs_currency=" + currency + "&days=" + std::to_string(days[i]);
+        curl_easy_setopt(pool[i], CURLOPT_URL, requests[i].c_str());
+        curl_easy_setopt(pool[i], CURLOPT_WRITEFUNCTION, chartCallback);
+        curl_easy_setopt(pool[i], CURLOPT_WRITEDATA, &charts[i]);
+        curl_easy_setopt(pool[i], CURLOPT_PRIVATE, &charts[i]);
+        curl_multi_add_handle(multi, pool[i]);
+    }
+
+    for (const auto &transfer : perform())
+    {
+        Chart* chart;
+        curl_easy_getinfo(transfer.first, CURLINFO_PRIVATE, &chart);
+        curl_easy_getinfo(transfer.first, CURLINFO_RESPONSE_CODE, &chart->status);
+        chart->result = transfer.second;
+        chart->parsed = chart->result == CURLE_OK && chart->status == 200 && parseChart(chart->response, chart->times, chart->prices);
+    }
+    return charts;
+}
+
+// Function required to save output into variables when calling the API.
+// The bytes go straight to the parser, only the first ones are copied for error messages.
+size_t curlCallback(void* contents, size_t size, size_t nmemb, Chunk* userp) {
+    const size_t kept = 512;
+    size_t totalSize = size * nmemb;
+    userp->parser.feed(std::string_view(static_cast<char*>(contents), totalSize));
+    if (userp->response.size() < kept)
+    {
+        userp->response.append(static_cast<char*>(contents), std::min(totalSize, kept - userp->response.size()));
+    }
+    return totalSize;
+}
+
+// A market chart is kept whole, it is parsed once complete
+static size_t chartCallback(void* contents, size_t size, size_t nmemb, Chart* chart)
+{
+    chart->response.append(static_cast<char*>(contents), size*nmemb);
+    return size*nmemb;
+}
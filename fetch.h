@@ -0,0 +1,58 @@
+#ifndef fetch_h
+#define fetch_h
+#include <vector>
+#include <string>
+#include <curl/curl.h>
+#include "parser.h"
+
+class Persistence;
+
+// Response to the request for the prices of names[begin, end). The body is parsed as it arrives,
+// only its beginning is kept to report errors.
+struct Chunk
+{
+    size_t begin = 0;
+    size_t end = 0;
+    PriceParser parser;
+    std::string response;
+    long status = 0;              // HTTP status
+    CURLcode result = CURLE_OK;   // transfer error, if any
+};
+
+// Response to the request for the history of names[index], read whole then parsed
+struct Chart
+{
+    size_t index = 0;
+    std::vector<double> times;    // seconds
+    std::vector<double> prices;
+    std::string response;
+    long status = 0;
+    CURLcode result = CURLE_OK;
+    bool parsed = false;
+};
+
+// Requests the prices of the watchlist in chunks of "chunkSize" GeckoIDs, all of them at the same
+// time through a curl multi handle. Easy handles and connections are kept between calls. The
+// history of new currencies is requested the same way, one currency per request.
+class Fetcher
+{
+public:
+    Fetcher();
+    ~Fetcher();
+    void configure(Persistence &db);
+    size_t chunk() const { return chunkSize; }
+    std::vector<Chunk> fetch(const std::vector<std::string> &names, const std::string &currency, double* prices, double* times, char* found);
+    std::vector<Chart> history(const std::vector<std::string> &names, const std::vector<int> &days, const std::string &currency);
+
+private:
+    void reserve(size_t handles);
+    std::vector<std::pair<CURL*, CURLcode>> perform();
+
+    CURLM* multi;
+    std::vector<CURL*> pool;
+    std::string url = "https://api.coingecko.com/api/v3";
+    size_t chunkSize = 100;
+    long connections = 4;
+};
+
+#endif
@@ -4,8 +4,16 @@
 #include <string>
 #include <sqlite3.h>
 
+class Analytics;
+class PriceStore;
+class Persistence;
+class Fetcher;
+class Scheduler;
+class Pipeline;
+
 int Alert(std::vector<std::string> alerts, const char* mode);
-int API(sqlite3 *db);
-int database();
+int API(Persistence &db, Fetcher &api, Scheduler &schedule, const std::vector<std::string> &names, Pipeline &pipeline, const std::string &mode);
+int database(Persistence &db, Fetcher &api, Scheduler &schedule, Pipeline &pipeline, const std::string &mode);
+int backfill(Persistence &db, Fetcher &api, Scheduler &schedule, Pipeline &pipeline, const std::string &mode);
 std::string UNIX(std::string unix_time);
 #endif
@@ -0,0 +1,603 @@
+/** ========================================================================================
+
+    Filename:  ipc.cpp
+
+    Description:  Channel between the core and GUI.py over a Unix domain socket. The GUI used
+                  to write Crypto.db itself and reread it to show the prices, so both processes
+                  took the write lock and changes waited for the next poll of the main loop.
+                  Now the GUI sends its changes here, they are written by this thread, published
+                  to the configuration snapshot (config.cpp) and the scheduler is woken up, and
+                  the analytics worker pushes every new price and alert to the connected GUIs.
+
+                  Setting: "ipcSocket", path of the socket (default crypto.sock, empty disables it).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "ipc.h"
+#include "pipeline.h"
+#include "analytics.h"
+#include "persistence.h"
+#include "scheduler.h"
+#include "config.h"
+#include "rules.h"
+#include "trace.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <stdexcept>
+
+static const size_t MaxLine = 65536;          // a command longer than this closes the client
+static const size_t MaxBacklog = 4*1024*1024; // bytes waiting for a client that doesn't read
+
+static std::string quote(const std::string &text);
+static std::string number(double value);
+
+Channel::~Channel()
+{
+    stop();
+}
+
+// Listen on the socket given and start the thread. Returns 0 or -1 with errors.
+int Channel::start(const std::string &socket, const char* file)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket.empty() || socket.size() >= sizeof(address.sun_path))
+    {
+        Alert(std::vector<std::string> (1,"Invalid ipcSocket setting " + socket + ", the GUI will use the database directly"),"error");
+        return -1;
+    }
+    std::memcpy(address.sun_path, socket.c_str(), socket.size());
+    path = socket;
+    database = file;
+
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || pipe(wake) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error creating the GUI socket: " + std::string(std::strerror(errno))),"error");
+        stop();
+        return -1;
+    }
+    ::unlink(socket.c_str()); // left by a previous run that didn't end cleanly
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error listening on " + socket + ": " + std::string(std::strerror(errno))),"error");
+        stop();
+        return -1;
+    }
+    chmod(socket.c_str(), S_IRUSR | S_IWUSR); // the credentials go through it
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    stopping.store(false);
+    thread = std::thread(&Channel::run, this);
+    return 0;
+}
+
+void Channel::stop()
+{
+    stopping.store(true);
+    if (thread.joinable())
+    {
+        char byte = 0;
+        if (write(wake[1], &byte, 1) < 0)
+        {
+            // the pipe is full, poll() wakes up anyway
+        }
+        thread.join();
+    }
+    if (listener >= 0)
+    {
+        close(listener);
+        ::unlink(path.c_str());
+    }
+    for (int &end : wake)
+    {
+        if (end >= 0)
+        {
+            close(end);
+        }
+        end = -1;
+    }
+    listener = -1;
+}
+
+// Called by the analytics worker after every pass. Cheap if no GUI is connected.
+void Channel::publish(const PriceBatch &batch, const Analytics &engine, const std::vector<std::string> &alerts)
+{
+    if (!listening())
+    {
+        return;
+    }
+    std::string lines;
+    for (size_t i = 0; i < batch.ids.size(); i++)
+    {
+        lines += "{\"type\":\"price\",\"id\":" + std::to_string(batch.ids[i]) + ",\"time\":" + number(batch.times[i]) + ",\"price\":"
+               + number(batch.prices[i]) + ",\"cv\":" + number(engine.cv(batch.ids[i])) + "}\n";
+    }
+    for (const std::string &alert : alerts)
+    {
+        lines += "{\"type\":\"alert\",\"text\":" + quote(alert) + "}\n";
+    }
+    if (lines.empty())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(queued);
+        if (pending.size() < MaxBacklog)
+        {
+            pending += lines;
+        }
+    }
+    char byte = 0;
+    if (write(wake[1], &byte, 1) < 0)
+    {
+        // the pipe is full, the thread is already woken up
+    }
+}
+
+// Accept clients, run their commands and write the events, in a single poll() loop
+void Channel::run()
+{
+    Persistence db;
+    std::vector<Client> connected;
+    db.open(database.c_str());
+
+    while (!stopping.load())
+    {
+        std::vector<pollfd> fds;
+        fds.push_back({wake[0], POLLIN, 0});
+        fds.push_back({listener, POLLIN, 0});
+        for (const Client &client : connected)
+        {
+            fds.push_back({client.fd, static_cast<short>(POLLIN | (client.out.empty() ? 0 : POLLOUT)), 0});
+        }
+        if (poll(fds.data(), fds.size(), 500) < 0 && errno != EINTR)
+        {
+            Alert(std::vector<std::string> (1,"Error waiting on the GUI socket: " + std::string(std::strerror(errno))),"error");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            char drain[64];
+            while (read(wake[0], drain, sizeof(drain)) > 0)
+            {
+            }
+            std::string events;
+            {
+                std::lock_guard<std::mutex> guard(queued);
+                events.swap(pending);
+            }
+            for (Client &client : connected)
+            {
+                client.out += events;
+            }
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            int fd;
+            while ((fd = accept(listener, nullptr, nullptr)) >= 0)
+            {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                connected.push_back({fd, "", ""});
+            }
+        }
+
+        // Commands are run in the order they arrive, the reply goes before any later event
+        for (size_t i = 0, slot = 2; i < connected.size(); slot++)
+        {
+            Client &client = connected[i];
+            bool closed = false;
+            short events = slot < fds.size() ? fds[slot].revents : 0;  // clients accepted above weren't polled
+            if (events & (POLLIN | POLLHUP | POLLERR))
+            {
+                char buffer[4096];
+                ssize_t got;
+                while ((got = read(client.fd, buffer, sizeof(buffer))) > 0)
+                {
+                    client.in.append(buffer, got);
+                }
+                closed = got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+                size_t end;
+                while ((end = client.in.find('\n')) != std::string::npos)
+                {
+                    std::string line = client.in.substr(0, end);
+                    client.in.erase(0, end + 1);
+                    if (!line.empty() && line.back() == '\r')
+                    {
+                        line.pop_back();
+                    }
+                    client.out += execute(db, line);
+                }
+                closed = closed || client.in.size() > MaxLine;
+            }
+            if (!client.out.empty() && !closed)
+            {
+                ssize_t sent = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+                if (sent > 0)
+                {
+                    client.out.erase(0, sent);
+                }
+                closed = (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) || client.out.size() > MaxBacklog;
+            }
+            if (closed)
+            {
+                close(client.fd);
+                connected.erase(connected.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+        clients.store(connected.size(), std::memory_order_relaxed);
+    }
+    for (const Client &client : connected)
+    {
+        close(client.fd);
+    }
+    clients.store(0);
+}
+
+// Run one command and return its reply lines
+std::string Channel::execute(Persistence &db, const std::string &line)
+{
+    std::vector<std::string> fields;
+    size_t begin = 0;
+    while (true)
+    {
+        size_t end = line.find('\t', begin);
+        fields.push_back(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        if (end == std::string::npos)
+        {
+            break;
+        }
+        begin = end + 1;
+    }
+    const std::string command = fields[0];
+    fields.erase(fields.begin());
+
+    if (db.handle() == nullptr)
+    {
+        return "{\"type\":\"error\",\"command\":" + quote(command) + ",\"message\":\"The core couldn't open the database\"}\n";
+    }
+    if (command == "snapshot" && fields.empty())
+    {
+        return snapshot(db.handle());
+    }
+    if (command == "trace" && fields.size() == 1 && (fields[0] == "on" || fields[0] == "off"))
+    {
+        tracer.enable(fields[0] == "on");
+        return "{\"type\":\"ok\",\"command\":\"trace\"}\n";
+    }
+    std::string error = change(db, command, fields);
+    if (!error.empty())
+    {
+        return "{\"type\":\"error\",\"command\":" + quote(command) + ",\"message\":" + quote(error) + "}\n";
+    }
+    return "{\"type\":\"ok\",\"command\":" + quote(command) + "}\n";
+}
+
+// Every currency with its last price, or the last rollup bucket if Prices has none left
+std::string Channel::snapshot(sqlite3* db)
+{
+    const char* Query = "SELECT ID,GeckoID,name,p.time,p.price,(SELECT MAX(bucket) FROM (SELECT MAX(bucket) AS bucket FROM PricesMinute WHERE CurrencyID = ID "
+                        "UNION ALL SELECT MAX(bucket) FROM PricesHour WHERE CurrencyID = ID UNION ALL SELECT MAX(bucket) FROM PricesDay WHERE CurrencyID = ID)) "
+                        "FROM Currencies LEFT JOIN Prices p ON p.PriceID = (SELECT PriceID FROM Prices WHERE CurrencyID = ID ORDER BY time DESC LIMIT 1);";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db,Query,-1,&stmt,nullptr) != SQLITE_OK)
+    {
+        return "{\"type\":\"error\",\"command\":\"snapshot\",\"message\":" + quote(sqlite3_errmsg(db)) + "}\n";
+    }
+    std::string lines;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        bool priced = sqlite3_column_type(stmt,3) != SQLITE_NULL;
+        bool rolled = sqlite3_column_type(stmt,5) != SQLITE_NULL;
+        lines += "{\"type\":\"currency\",\"id\":" + std::to_string(sqlite3_column_int(stmt,0))
+               + ",\"gecko\":" + quote(reinterpret_cast<const char*>(sqlite3_column_text(stmt,1)))
+               + ",\"name\":" + quote(reinterpret_cast<const char*>(sqlite3_column_text(stmt,2)))
+               + ",\"time\":" + (priced ? number(sqlite3_column_double(stmt,3)) : rolled ? number(sqlite3_column_double(stmt,5)) : "null")
+               + ",\"price\":" + (priced ? number(sqlite3_column_double(stmt,4)) : "null") + "}\n";
+    }
+    sqlite3_finalize(stmt);
+    return lines + "{\"type\":\"end\",\"command\":\"snapshot\"}\n";
+}
+
+// Validate and write a change from the GUI, then apply it. Returns the error or "" if it was saved.
+std::string Channel::change(Persistence &writer, const std::string &command, const std::vector<std::string> &fields)
+{
+    const char* findQuery = "SELECT ID FROM Currencies WHERE name = ?1;";
+    const char* duplicateQuery = "SELECT COUNT(*) FROM Currencies WHERE GeckoID = ?1 OR name = ?2;";
+    const char* addStatement = "INSERT INTO Currencies (GeckoID,name) VALUES (?1,?2);";
+    const char* defaultStatement = "INSERT INTO Configs (CurrencyID,minimumData,timeWindow,gain,longGain,movingAvg,anomaly) VALUES (last_insert_rowid(),30,5,2,3,'True',98.5);";
+    const char* removeStatement = "DELETE FROM Currencies WHERE name = ?1;";
+    // Clients that don't send the decoupling threshold keep the current one
+    const char* thresholdStatement = "INSERT INTO Configs (CurrencyID,minimumData,timeWindow,gain,longGain,movingAvg,anomaly,decoupling) VALUES (?1,?2,?3,?4,?5,?6,?7,"
+                                     "COALESCE(?8,(SELECT decoupling FROM Configs WHERE CurrencyID = ?1 ORDER BY alertID DESC LIMIT 1),0));";
+    const char* modeStatement = "INSERT INTO Mode (updateFreq,mode,mail,password) VALUES (?1,?2,?3,?4);";
+    const char* unruleStatement = "DELETE FROM Rules WHERE name = ?1;";
+    const char* ruleStatement = "INSERT INTO Rules (name,expression,CurrencyID) VALUES (?1,?2,?3);";
+    std::vector<double> values;
+    std::vector<const char*> statements;
+    size_t expected;
+
+    if (command == "add" || command == "remove")
+    {
+        expected = command == "add" ? 2 : 1;
+    }
+    else if (command == "thresholds" || command == "mode")
+    {
+        expected = command == "thresholds" ? 7 : 4;
+    }
+    else if (command == "rule")
+    {
+        expected = fields.size() == 3 ? 3 : 2;
+    }
+    else
+    {
+        return "Unknown command " + command;
+    }
+    if (fields.size() != expected && !(command == "thresholds" && fields.size() == 8))
+    {
+        return "Wrong number of fields for " + command;
+    }
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        // An empty expression deletes the rule
+        if (fields[i].empty() && command != "mode" && !(command == "rule" && i == 1))
+        {
+            return "Fields cannot be empty";
+        }
+    }
+
+    // Same checks as GUI.py
+    try
+    {
+        if (command == "thresholds")
+        {
+            for (size_t i : {1u, 2u, 3u, 4u, 6u})
+            {
+                values.push_back(std::stod(fields[i]));
+                if (values.back() < 0)
+                {
+                    return "No input should be negative";
+                }
+                if (values.back() > 100 && i != 1 && i != 2)
+                {
+                    return "Invalid percentage (0-100)";
+                }
+            }
+            if (fields[5] != "True" && fields[5] != "False")
+            {
+                return "The moving average alert is neither true nor false";
+            }
+            if (fields.size() == 8)
+            {
+                values.push_back(std::stod(fields[7]));
+                if (values.back() < 0 || values.back() > 2)
+                {
+                    return "Invalid decoupling threshold (0-2)";
+                }
+            }
+        }
+        else if (command == "mode")
+        {
+            values.push_back(std::stod(fields[0]));
+            if (values.back() <= 9e-2)
+            {
+                return "The update frequency (in minutes) should be a real positive number";
+            }
+            if (fields[1] != "mail" && fields[1] != "local")
+            {
+                return "Invalid mode, choose mail or local";
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        return "Failed to read input as real number";
+    }
+    if (command == "rule" && !fields[1].empty())
+    {
+        std::vector<Step> steps;
+        std::string invalid = compile(fields[1], Thresholds(), steps);
+        if (!invalid.empty())
+        {
+            return "Invalid rule: " + invalid;
+        }
+    }
+
+    if (writer.begin() != 0)
+    {
+        return "Error writing to database: " + std::string(sqlite3_errmsg(writer.handle()));
+    }
+    sqlite3* db = writer.handle();
+    sqlite3_stmt* stmt = nullptr;
+    int id = -1;
+    std::string error;
+
+    if (command == "add")
+    {
+        sqlite3_prepare_v2(db,duplicateQuery,-1,&stmt,nullptr);
+        sqlite3_bind_text(stmt,1,fields[0].c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt,2,fields[1].c_str(),-1,SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt,0) > 0)
+        {
+            error = "You are using that crypto currency or name already";
+        }
+        sqlite3_finalize(stmt);
+        statements = {addStatement, defaultStatement};
+    }
+    else if (command == "mode")
+    {
+        statements = {modeStatement};
+    }
+    else if (command == "rule")
+    {
+        if (fields.size() == 3)
+        {
+            sqlite3_prepare_v2(db,findQuery,-1,&stmt,nullptr);
+            sqlite3_bind_text(stmt,1,fields[2].c_str(),-1,SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                id = sqlite3_column_int(stmt,0);
+            }
+            else
+            {
+                error = "Name not found";
+            }
+            sqlite3_finalize(stmt);
+        }
+        statements = {unruleStatement};
+        if (!fields[1].empty())
+        {
+            statements.push_back(ruleStatement);
+        }
+    }
+    else
+    {
+        sqlite3_prepare_v2(db,findQuery,-1,&stmt,nullptr);
+        sqlite3_bind_text(stmt,1,fields[0].c_str(),-1,SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            id = sqlite3_column_int(stmt,0);
+        }
+        else
+        {
+            error = "Name not found";
+        }
+        sqlite3_finalize(stmt);
+        statements = {command == "remove" ? removeStatement : thresholdStatement};
+    }
+
+    for (const char* statement : statements)
+    {
+        if (!error.empty())
+        {
+            break;
+        }
+        if (sqlite3_prepare_v2(db,statement,-1,&stmt,nullptr) != SQLITE_OK)
+        {
+            error = "Error writing to database: " + std::string(sqlite3_errmsg(db));
+            break;
+        }
+        if (command == "thresholds")
+        {
+            sqlite3_bind_int(stmt,1,id);
+            sqlite3_bind_int(stmt,2,static_cast<int>(values[0]));
+            sqlite3_bind_double(stmt,3,values[1]);
+            sqlite3_bind_double(stmt,4,values[2]);
+            sqlite3_bind_double(stmt,5,values[3]);
+            sqlite3_bind_text(stmt,6,fields[5].c_str(),-1,SQLITE_TRANSIENT);
+            sqlite3_bind_double(stmt,7,values[4]);
+            if (values.size() > 5)
+            {
+                sqlite3_bind_double(stmt,8,values[5]);
+            }
+        }
+        else if (command == "mode")
+        {
+            sqlite3_bind_double(stmt,1,values[0]);
+            for (int i = 1; i < 4; i++)
+            {
+                sqlite3_bind_text(stmt,i + 1,fields[i].c_str(),-1,SQLITE_TRANSIENT);
+            }
+        }
+        else if (command == "rule")
+        {
+            sqlite3_bind_text(stmt,1,fields[0].c_str(),-1,SQLITE_TRANSIENT);
+            if (statement == ruleStatement)
+            {
+                sqlite3_bind_text(stmt,2,fields[1].c_str(),-1,SQLITE_TRANSIENT);
+                if (id > 0)
+                {
+                    sqlite3_bind_int(stmt,3,id);
+                }
+            }
+        }
+        else if (statement != defaultStatement)
+        {
+            for (size_t i = 0; i < fields.size(); i++)
+            {
+                sqlite3_bind_text(stmt,i + 1,fields[i].c_str(),-1,SQLITE_TRANSIENT);
+            }
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            error = "Error writing to database: " + std::string(sqlite3_errmsg(db));
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (!error.empty())
+    {
+        writer.rollback();
+        return error;
+    }
+    if (writer.commit() != 0)
+    {
+        return "Error writing to database: " + std::string(sqlite3_errmsg(db));
+    }
+
+    // The analyses, the alerts and the main loop pick the new snapshot up without polling
+    config.invalidate();
+    config.refresh(writer);
+    schedule.notify();
+    return "";
+}
+
+// JSON string of the text given
+static std::string quote(const std::string &text)
+{
+    std::string out = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Text that reads back as the same double, null when it is NaN or infinite (JSON has no spelling for them)
+static std::string number(double value)
+{
+    if (!std::isfinite(value))
+    {
+        return "null";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.17g", value);
+    return text;
+}
@@ -0,0 +1,60 @@
+#ifndef ipc_h
+#define ipc_h
+#include <vector>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <sqlite3.h>
+
+class Scheduler;
+class Analytics;
+class Persistence;
+struct PriceBatch;
+
+// Unix domain socket shared with GUI.py. Every line sent to a client is a JSON object: replies
+// ("ok", "error", "currency", "end") and live events ("price", "alert"). Clients send one command
+// per line with its fields separated by tabs:
+//   snapshot                                                   currencies and their last price
+//   add <GeckoID> <name>
+//   remove <name>
+//   thresholds <name> <minimumData> <timeWindow> <gain> <longGain> <movingAvg> <anomaly> [<decoupling>]
+//   mode <updateFreq> <mode> <mail> <password>
+//   rule <name> <expression> [<currency name>]                 an empty expression deletes it
+//   trace <on|off>                                             spans of the stages (trace.cpp)
+// Changes are written by the core and applied right away instead of waiting for the next poll.
+class Channel
+{
+public:
+    explicit Channel(Scheduler &schedule) : schedule(schedule) {}
+    ~Channel();
+    int start(const std::string &socket, const char* file);
+    void stop();
+    bool listening() const { return clients.load(std::memory_order_relaxed) > 0; }
+    void publish(const PriceBatch &batch, const Analytics &engine, const std::vector<std::string> &alerts);
+
+private:
+    struct Client
+    {
+        int fd;
+        std::string in;
+        std::string out;
+    };
+    void run();
+    std::string execute(Persistence &db, const std::string &line);
+    std::string snapshot(sqlite3* db);
+    std::string change(Persistence &writer, const std::string &command, const std::vector<std::string> &fields);
+
+    Scheduler &schedule;
+    std::string path;
+    std::string database;
+    int listener = -1;
+    int wake[2] = {-1, -1};               // self pipe, written by publish() to interrupt poll()
+    std::mutex queued;                    // pending
+    std::string pending;                  // events not yet copied to the clients
+    std::atomic<size_t> clients{0};       // connected, events are only formatted if there is one
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+#endif
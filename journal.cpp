@@ -0,0 +1,579 @@
+/** ========================================================================================
+
+    Filename:  journal.cpp
+
+    Description:  Binary journal of the prices, an alternative to the rows of Prices in
+                  Crypto.db. Every currency has an append only file in "journalDirectory",
+                  mapped in memory: a price costs a record of about 11 bytes (time delta and
+                  price) written with a memcpy instead of an SQLite insert with its indexes,
+                  and the warm up at startup decodes the windows straight from the mapping.
+
+                  Every batch ends by writing the superblock copy not used by the previous
+                  commit, with a CRC of its fields and of the records of the last block. When a
+                  file is opened the newest copy whose CRCs match is used and anything written
+                  after it is dropped; if neither matches, the file goes back to the last
+                  checkpoint, where the records were synced to disk before the superblock.
+
+                  "./CryptoAnalysis --export" copies the prices of the journal that Prices does
+                  not have yet into Crypto.db, for the GUI charts or any other tool.
+
+                  Settings: "journalDirectory" (default journal), "journalCheckpoint", seconds
+                  between syncs to disk (default 60).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "journal.h"
+#include "pipeline.h"
+#include "pricestore.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <array>
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+
+static const char Magic[8] = {'C','R','Y','P','T','J','0','1'};
+static const size_t Slot = 64;   // bytes between the two copies of the superblock
+
+// CRC32 (IEEE 802.3), continuing from a previous value. Eight bytes per step with eight tables
+// (slicing by 8), the snapshots of the analyses (snapshot.cpp) check megabytes with it.
+uint32_t crc32(uint32_t crc, const unsigned char* data, size_t length)
+{
+    static const std::array<std::array<uint32_t, 256>, 8> tables = []
+    {
+        std::array<std::array<uint32_t, 256>, 8> values;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            }
+            values[0][i] = value;
+        }
+        for (size_t slice = 1; slice < 8; slice++)
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                values[slice][i] = values[0][values[slice - 1][i] & 0xFF] ^ (values[slice - 1][i] >> 8);
+            }
+        }
+        return values;
+    }();
+    crc = ~crc;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint32_t low = crc ^ (data[i] | data[i + 1] << 8 | data[i + 2] << 16 | static_cast<uint32_t>(data[i + 3]) << 24);
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24]
+            ^ tables[3][data[i + 4]] ^ tables[2][data[i + 5]] ^ tables[1][data[i + 6]] ^ tables[0][data[i + 7]];
+    }
+    for (; i < length; i++)
+    {
+        crc = tables[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Zigzag varint, small deltas of either sign take few bytes
+static size_t encode(int64_t delta, unsigned char* out)
+{
+    uint64_t value = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+    size_t length = 0;
+    while (value >= 0x80)
+    {
+        out[length++] = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = static_cast<unsigned char>(value);
+    return length;
+}
+
+// Returns the bytes read, 0 if the varint does not end before "available"
+static size_t decode(const unsigned char* in, size_t available, int64_t &delta)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < available && i < 10; i++)
+    {
+        value |= static_cast<uint64_t>(in[i] & 0x7F) << (7*i);
+        if ((in[i] & 0x80) == 0)
+        {
+            delta = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+JournalFile::~JournalFile()
+{
+    if (memory != nullptr)
+    {
+        munmap(memory, size);
+    }
+}
+
+// Map the file, creating it or recovering its last consistent state. Returns 0 or -1 with errors.
+int JournalFile::open(const std::string &file)
+{
+    path = file;
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error opening the journal " + path + ": " + std::string(std::strerror(errno))),"error");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    // Files are created with a superblock and 16 blocks, anything smaller never held a price
+    bool fresh = static_cast<size_t>(info.st_size) < Data + Page;
+    size = fresh ? Data + 16*Page : static_cast<size_t>(info.st_size);
+    void* mapped = MAP_FAILED;
+    if (!fresh || ftruncate(fd, size) == 0)
+    {
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        Alert(std::vector<std::string> (1,"Error mapping the journal " + path + ": " + std::string(std::strerror(errno))),"error");
+        size = 0;
+        return -1;
+    }
+    memory = static_cast<unsigned char*>(mapped);
+    if (fresh)
+    {
+        std::memset(memory, 0, Data);
+        dirty = true;
+        commit();
+        return 0;
+    }
+    return recover();
+}
+
+// Grow the file and its mapping
+int JournalFile::map(size_t length)
+{
+    int fd = ::open(path.c_str(), O_RDWR);
+    void* moved = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, length) == 0)
+    {
+        moved = mremap(memory, size, length, MREMAP_MAYMOVE);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (moved == MAP_FAILED)
+    {
+        Alert(std::vector<std::string> (1,"Error growing the journal " + path + ": " + std::string(std::strerror(errno))),"error");
+        return -1;
+    }
+    memory = static_cast<unsigned char*>(moved);
+    size = length;
+    return 0;
+}
+
+bool JournalFile::valid(const Superblock &copy) const
+{
+    size_t offset = (copy.committed - Data) % Page;
+    return std::memcmp(copy.magic, Magic, sizeof(Magic)) == 0
+        && copy.crc == crc32(0, reinterpret_cast<const unsigned char*>(&copy), offsetof(Superblock, crc))
+        && copy.committed >= Data && copy.committed <= size && copy.durable >= Data && copy.durable <= copy.committed
+        && (copy.committed == Data || offset == 0 || offset > sizeof(Block));
+}
+
+// End of the records of a block
+size_t JournalFile::end(size_t index) const
+{
+    if (index == tail())
+    {
+        return committed;
+    }
+    return Data + index*Page + sizeof(Block) + std::min<size_t>(block(index).used, Page - sizeof(Block));
+}
+
+// CRC of the records of the open block, "time" is set to the time of its last record
+uint32_t JournalFile::check(int64_t &time) const
+{
+    if (committed == Data)
+    {
+        return 0;
+    }
+    size_t begin = Data + tail()*Page + sizeof(Block);
+    time = block(tail()).base;
+    for (size_t position = begin; position < committed; )
+    {
+        int64_t delta;
+        size_t length = decode(memory + position, committed - position, delta);
+        if (length == 0)
+        {
+            break;
+        }
+        time += delta;
+        position += length + sizeof(double);
+    }
+    return crc32(0, memory + begin, committed - begin);
+}
+
+// Newest superblock whose records are intact, or the last checkpoint
+int JournalFile::recover()
+{
+    Superblock copies[2];
+    std::memcpy(&copies[0], memory, sizeof(Superblock));
+    std::memcpy(&copies[1], memory + Slot, sizeof(Superblock));
+    if (copies[1].sequence > copies[0].sequence)
+    {
+        std::swap(copies[0], copies[1]);
+    }
+
+    const Superblock* checkpoint = nullptr;
+    for (const Superblock &copy : copies)
+    {
+        if (!valid(copy))
+        {
+            continue;
+        }
+        checkpoint = checkpoint == nullptr ? &copy : checkpoint;
+        committed = copy.committed;
+        int64_t time = 0;
+        if (check(time) == copy.tailCrc)
+        {
+            sequence = copy.sequence;
+            durable = copy.durable;
+            last = copy.last;
+            tailCrc = copy.tailCrc;
+            if (&copy != &copies[0])
+            {
+                Alert(std::vector<std::string> (1,"The last commit of the journal " + path + " was incomplete, it was dropped"),"error");
+                dirty = true;
+                commit();
+            }
+            return 0;
+        }
+    }
+    if (checkpoint == nullptr)
+    {
+        Alert(std::vector<std::string> (1,"The journal " + path + " has no valid superblock, move it away to start a new one"),"error");
+        return -1;
+    }
+
+    // Records after the checkpoint did not reach the disk
+    sequence = checkpoint->sequence;
+    committed = durable = checkpoint->durable;
+    tailCrc = check(last);
+    Alert(std::vector<std::string> (1,"The journal " + path + " was damaged after its last checkpoint, the prices since then were dropped"),"error");
+    dirty = true;
+    commit();
+    return 0;
+}
+
+// Add a price after the last one, it is only kept once commit() is called
+int JournalFile::append(double time, double price)
+{
+    int64_t milliseconds = std::llround(time*1000);
+    unsigned char record[10 + sizeof(double)];
+    size_t length = 0;
+    size_t offset = (committed - Data) % Page;
+    bool start = committed == Data || offset == 0;
+    if (!start)
+    {
+        length = encode(milliseconds - last, record);
+        start = offset + length + sizeof(double) > Page;
+    }
+
+    // New block, the first record is a delta of 0 from its base
+    if (start)
+    {
+        size_t index = committed == Data ? 0 : tail() + 1;
+        if (committed != Data)
+        {
+            block(tail()).used = committed - Data - tail()*Page - sizeof(Block);
+        }
+        size_t begin = Data + index*Page;
+        if (begin + Page > size && map(size + std::min<size_t>(size, 16 << 20)) != 0)
+        {
+            return -1;
+        }
+        block(index) = {milliseconds, 0, 0};
+        committed = begin + sizeof(Block);
+        tailCrc = 0;
+        length = encode(0, record);
+    }
+    std::memcpy(record + length, &price, sizeof(double));
+    length += sizeof(double);
+    std::memcpy(memory + committed, record, length);
+    tailCrc = crc32(tailCrc, record, length);
+    committed += length;
+    last = milliseconds;
+    dirty = true;
+    return 0;
+}
+
+// Publish the records appended so far in the superblock copy not used by the previous commit
+void JournalFile::commit()
+{
+    if (!dirty)
+    {
+        return;
+    }
+    Superblock copy;
+    std::memcpy(copy.magic, Magic, sizeof(Magic));
+    copy.sequence = ++sequence;
+    copy.committed = committed;
+    copy.durable = durable;
+    copy.last = last;
+    copy.tailCrc = tailCrc;
+    copy.crc = crc32(0, reinterpret_cast<const unsigned char*>(&copy), offsetof(Superblock, crc));
+    std::memcpy(memory + (sequence % 2)*Slot, &copy, sizeof(copy));
+    dirty = false;
+}
+
+// Sync the records, then the superblock that marks them durable
+int JournalFile::checkpoint()
+{
+    if (durable == committed && !dirty)
+    {
+        return 0;
+    }
+    if (msync(memory, committed, MS_SYNC) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error syncing the journal " + path + ": " + std::string(std::strerror(errno))),"error");
+        return -1;
+    }
+    durable = committed;
+    dirty = true;
+    commit();
+    return msync(memory, Page, MS_SYNC) == 0 ? 0 : -1;
+}
+
+// Call visit(time, price) for every price at or after "since", in the order they were appended.
+// Blocks are found by their base time, the records are decoded straight from the mapping.
+int JournalFile::scan(double since, const std::function<void(double, double)> &visit) const
+{
+    if (committed == Data)
+    {
+        return 0;
+    }
+    int64_t from = static_cast<int64_t>(std::ceil(since*1000));
+    size_t blocks = tail() + 1;
+    size_t low = 0, high = blocks;
+    while (low < high)
+    {
+        size_t middle = (low + high)/2;
+        if (block(middle).base <= from)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    int count = 0;
+    for (size_t index = low == 0 ? 0 : low - 1; index < blocks; index++)
+    {
+        size_t position = Data + index*Page + sizeof(Block);
+        size_t stop = end(index);
+        int64_t time = block(index).base;
+        while (position < stop)
+        {
+            int64_t delta;
+            size_t length = decode(memory + position, stop - position, delta);
+            if (length == 0 || position + length + sizeof(double) > stop)
+            {
+                break;
+            }
+            double price;
+            std::memcpy(&price, memory + position + length, sizeof(double));
+            position += length + sizeof(double);
+            time += delta;
+            if (time >= from)
+            {
+                visit(time/1000.0, price);
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+Journal::~Journal()
+{
+    checkpoint();
+}
+
+// The files are opened when a currency is first written or read
+int Journal::open(const char*)
+{
+    if (!opened && mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        Alert(std::vector<std::string> (1,"Error creating the journal directory " + directory + ": " + std::string(std::strerror(errno))),"error");
+        return -1;
+    }
+    opened = true;
+    return 0;
+}
+
+JournalFile* Journal::file(int id)
+{
+    auto found = files.find(id);
+    if (found != files.end())
+    {
+        return found->second.get();
+    }
+    std::unique_ptr<JournalFile> created(new JournalFile);
+    if (created->open(directory + "/" + std::to_string(id) + ".bin") != 0)
+    {
+        return nullptr;
+    }
+    return files.emplace(id, std::move(created)).first->second.get();
+}
+
+// Every price of the batch, then a commit of each file touched and a checkpoint when it is due.
+// The prices a previous try of the batch kept already are skipped, so a failed batch can be
+// appended again.
+int Journal::append(const PriceBatch &batch)
+{
+    std::vector<JournalFile*> touched;
+    int result = 0;
+    for (size_t i = 0; i < batch.ids.size(); i++)
+    {
+        JournalFile* journal = file(batch.ids[i]);
+        if (journal != nullptr && std::llround(batch.times[i]*1000) <= std::llround(journal->lastTime()*1000))
+        {
+            continue;
+        }
+        if (journal == nullptr || journal->append(batch.times[i], batch.prices[i]) != 0)
+        {
+            result = -1;
+            continue;
+        }
+        touched.push_back(journal);
+    }
+    for (JournalFile* journal : touched)
+    {
+        journal->commit();
+    }
+    if (std::chrono::duration<double>(std::chrono::steady_clock::now() - synced).count() >= interval)
+    {
+        result = checkpoint() == 0 ? result : -1;
+    }
+    return result;
+}
+
+// Prices of a currency after the ones the ring already has, at or after "since"
+int Journal::replay(int id, double since, PriceRing &ring)
+{
+    struct stat info;
+    std::string name = directory + "/" + std::to_string(id) + ".bin";
+    if (files.find(id) == files.end() && stat(name.c_str(), &info) != 0)
+    {
+        return 0;
+    }
+    JournalFile* journal = file(id);
+    if (journal == nullptr)
+    {
+        return -1;
+    }
+    // The last price is always read, to detect changes, as PriceStore::load() does with Prices
+    journal->scan(journal->empty() ? since : std::min(since, journal->lastTime()), [&ring](double time, double price)
+    {
+        if (!ring.seen() || time > ring.lastTime())
+        {
+            ring.push(time, price);
+        }
+    });
+    return 0;
+}
+
+int Journal::checkpoint()
+{
+    int result = 0;
+    for (auto &entry : files)
+    {
+        result = entry.second->checkpoint() == 0 ? result : -1;
+    }
+    synced = std::chrono::steady_clock::now();
+    return result;
+}
+
+// Copy into Prices the prices newer than the last one it has (or than the compacted ones) for every
+// currency still followed. Returns the number of rows written, or -1 with errors.
+long long Journal::exportPrices(Persistence &db)
+{
+    const char* Query = "SELECT MAX(COALESCE((SELECT MAX(time) FROM Prices WHERE CurrencyID = ?1),0),"
+                        "COALESCE((SELECT CAST(value AS REAL) FROM Settings WHERE name = 'compactedUntil'),0)) "
+                        "FROM Currencies WHERE ID = ?1;";
+    std::vector<int> ids;
+    DIR* folder = opendir(directory.c_str());
+    if (folder == nullptr)
+    {
+        Alert(std::vector<std::string> (1,"Error reading the journal directory " + directory + ": " + std::string(std::strerror(errno))),"error");
+        return -1;
+    }
+    while (dirent* entry = readdir(folder))
+    {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".bin") == 0 && name.find_first_not_of("0123456789") == name.size() - 4)
+        {
+            ids.push_back(std::stoi(name.substr(0, name.size() - 4)));
+        }
+    }
+    closedir(folder);
+    std::sort(ids.begin(), ids.end());
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db.handle(),Query,-1,&stmt,nullptr) != SQLITE_OK || db.begin() != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error exporting the journal: " + std::string(sqlite3_errmsg(db.handle()))),"error");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    long long rows = 0;
+    bool failed = false;
+    for (int id : ids)
+    {
+        sqlite3_bind_int(stmt,1,id);
+        bool followed = sqlite3_step(stmt) == SQLITE_ROW;
+        double after = followed ? sqlite3_column_double(stmt,0) : 0;
+        sqlite3_reset(stmt);
+        JournalFile* journal = followed ? file(id) : nullptr;
+        if (journal == nullptr)
+        {
+            continue;
+        }
+        journal->scan(after, [&](double time, double price)
+        {
+            if (!failed && time > after)
+            {
+                failed = db.insert(id, time, price) != 0;
+                rows++;
+            }
+        });
+    }
+    sqlite3_finalize(stmt);
+    if (failed || db.commit() != 0)
+    {
+        db.rollback();
+        return -1;
+    }
+    return rows;
+}
@@ -0,0 +1,94 @@
+#ifndef journal_h
+#define journal_h
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include "storage.h"
+
+// CRC32 (IEEE 802.3) of "length" bytes, continuing from "crc" (0 to start)
+uint32_t crc32(uint32_t crc, const unsigned char* data, size_t length);
+
+// Append only file of the prices of one currency, memory mapped. After a page with two copies of
+// the superblock the file is made of 4 KB blocks; each block starts with the absolute time of its
+// first price and holds records of a zigzag varint time delta in milliseconds and an 8 byte price.
+// The superblock copy with the highest sequence and a valid CRC tells where the records end.
+class JournalFile
+{
+public:
+    ~JournalFile();
+    int open(const std::string &path);
+    int append(double time, double price);
+    void commit();
+    int checkpoint();
+    int scan(double since, const std::function<void(double, double)> &visit) const;
+    double lastTime() const { return last/1000.0; }
+    bool empty() const { return committed == Data; }
+
+    static constexpr size_t Page = 4096;
+    static constexpr size_t Data = Page;     // first block
+
+private:
+    struct Superblock
+    {
+        char magic[8];
+        uint64_t sequence;
+        uint64_t committed;   // end of the records, from the start of the file
+        uint64_t durable;     // committed at the last checkpoint, synced to disk
+        int64_t last;         // time of the last record, milliseconds
+        uint32_t tailCrc;     // CRC32 of the records of the open block
+        uint32_t crc;         // of the fields above
+    };
+    struct Block
+    {
+        int64_t base;         // time of its first record, milliseconds
+        uint32_t used;        // bytes of records, set when the block is full
+        uint32_t reserved;
+    };
+
+    int map(size_t size);
+    int recover();
+    size_t tail() const { return committed == Data ? 0 : (committed - 1 - Data)/Page; }  // index of the open block
+    Block& block(size_t index) const { return *reinterpret_cast<Block*>(memory + Data + index*Page); }
+    size_t end(size_t index) const;
+    bool valid(const Superblock &copy) const;
+    uint32_t check(int64_t &time) const;
+
+    std::string path;
+    unsigned char* memory = nullptr;
+    size_t size = 0;
+    uint64_t sequence = 0;
+    uint64_t committed = Data;
+    uint64_t durable = Data;
+    int64_t last = 0;
+    uint32_t tailCrc = 0;
+    bool dirty = false;
+};
+
+// Journal backend of the prices: a JournalFile per currency in a directory, checkpointed (synced
+// to disk) every "interval" seconds. Between checkpoints a crash of the program loses nothing and
+// a power failure at most the prices since the last one, as SQLite with synchronous=NORMAL.
+class Journal : public Storage
+{
+public:
+    Journal(const std::string &directory, double interval) : directory(directory), interval(interval) {}
+    ~Journal();
+    int open(const char* database) override;
+    int append(const PriceBatch &batch) override;
+    int replay(int id, double since, PriceRing &ring) override;
+    int checkpoint();
+    long long exportPrices(Persistence &db);
+
+private:
+    JournalFile* file(int id);
+
+    std::string directory;
+    double interval;
+    bool opened = false;
+    std::unordered_map<int, std::unique_ptr<JournalFile>> files;
+    std::chrono::steady_clock::time_point synced = std::chrono::steady_clock::now();
+};
+
+#endif
@@ -0,0 +1,326 @@
+/** ========================================================================================
+
+    Filename:  kernels.cpp
+
+    Description:  Window statistics over contiguous prices: shifted sums and sums of squares
+                  (mean and sample std, as pandas), minimum, maximum and simple returns. Each
+                  kernel has a scalar version and AVX2 and AVX-512 versions compiled with the
+                  target attribute, the best one the CPU supports is chosen once at runtime, so
+                  the binary still runs on machines without them. The cross products and
+                  correlations of a row of a tile of the correlation matrix are updated the
+                  same way.
+
+                  bench/kernel_bench.cpp checks every version against a two pass reference.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "kernels.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <limits>
+
+static const double Infinity = std::numeric_limits<double>::infinity();
+
+Moments& Moments::merge(const Moments &other)
+{
+    if (other.count == 0)
+    {
+        return *this;
+    }
+    min = count == 0 ? other.min : std::min(min, other.min);
+    max = count == 0 ? other.max : std::max(max, other.max);
+    sum += other.sum;
+    sumSq += other.sumSq;
+    count += other.count;
+    return *this;
+}
+
+static Moments momentsScalar(const double* values, size_t count, double shift)
+{
+    Moments result;
+    result.min = Infinity;
+    result.max = -Infinity;
+    for (size_t i = 0; i < count; i++)
+    {
+        double shifted = values[i] - shift;
+        result.sum += shifted;
+        result.sumSq += shifted*shifted;
+        result.min = std::min(result.min, values[i]);
+        result.max = std::max(result.max, values[i]);
+    }
+    result.count = count;
+    return result;
+}
+
+// Same formula as Analytics::run, (new - old)/old
+static void returnsScalar(const double* prices, size_t count, double* out)
+{
+    for (size_t i = 0; i + 1 < count; i++)
+    {
+        out[i] = (prices[i + 1] - prices[i])/prices[i];
+    }
+}
+
+// Cross products of a row of the correlation matrix with the columns of a tile, and their correlations
+static void crossScalar(const CrossRow &row, CrossTile &tile, size_t from, size_t to)
+{
+    double rowSum = 0, recentRowSum = 0;
+    for (size_t j = from; j < to; j++)
+    {
+        double all = tile.all[j] + row.r*tile.r[j] - row.o*tile.o[j];
+        double last = tile.last[j] + row.r*tile.r[j] - row.q*tile.q[j];
+        double value = (all - row.sum*tile.mean[j])*row.inverse*tile.inverse[j];
+        double recentValue = (last - row.recentSum*tile.recentMean[j])*row.recentInverse*tile.recentInverse[j];
+        tile.all[j] = all;
+        tile.last[j] = last;
+        if (tile.value != nullptr)
+        {
+            tile.value[j] = value;
+            tile.recentValue[j] = recentValue;
+        }
+        if (tile.columnSum != nullptr)
+        {
+            tile.columnSum[j] += value;
+            tile.recentColumnSum[j] += recentValue;
+        }
+        rowSum += value;
+        recentRowSum += recentValue;
+    }
+    tile.rowSum += rowSum;
+    tile.recentRowSum += recentRowSum;
+}
+
+__attribute__((target("avx2,fma")))
+static Moments momentsAvx2(const double* values, size_t count, double shift)
+{
+    __m256d sum = _mm256_setzero_pd();
+    __m256d sumSq = _mm256_setzero_pd();
+    __m256d low = _mm256_set1_pd(Infinity);
+    __m256d high = _mm256_set1_pd(-Infinity);
+    const __m256d offset = _mm256_set1_pd(shift);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(values + i);
+        __m256d shifted = _mm256_sub_pd(x, offset);
+        sum = _mm256_add_pd(sum, shifted);
+        sumSq = _mm256_fmadd_pd(shifted, shifted, sumSq);
+        low = _mm256_min_pd(low, x);
+        high = _mm256_max_pd(high, x);
+    }
+    alignas(32) double lanes[4][4];
+    _mm256_store_pd(lanes[0], sum);
+    _mm256_store_pd(lanes[1], sumSq);
+    _mm256_store_pd(lanes[2], low);
+    _mm256_store_pd(lanes[3], high);
+    Moments result = momentsScalar(values + i, count - i, shift);
+    for (int lane = 0; lane < 4; lane++)
+    {
+        result.sum += lanes[0][lane];
+        result.sumSq += lanes[1][lane];
+        result.min = std::min(result.min, lanes[2][lane]);
+        result.max = std::max(result.max, lanes[3][lane]);
+    }
+    result.count = count;
+    return result;
+}
+
+__attribute__((target("avx2")))
+static void returnsAvx2(const double* prices, size_t count, double* out)
+{
+    size_t i = 0;
+    for (; i + 5 <= count; i += 4)
+    {
+        __m256d old = _mm256_loadu_pd(prices + i);
+        __m256d next = _mm256_loadu_pd(prices + i + 1);
+        _mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_sub_pd(next, old), old));
+    }
+    if (i + 1 < count)
+    {
+        returnsScalar(prices + i, count - i, out + i);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void crossAvx2(const CrossRow &row, CrossTile &tile, size_t from, size_t to)
+{
+    const __m256d r = _mm256_set1_pd(row.r), o = _mm256_set1_pd(row.o), q = _mm256_set1_pd(row.q);
+    const __m256d sum = _mm256_set1_pd(row.sum), recentSum = _mm256_set1_pd(row.recentSum);
+    const __m256d inverse = _mm256_set1_pd(row.inverse), recentInverse = _mm256_set1_pd(row.recentInverse);
+    __m256d rowSum = _mm256_setzero_pd(), recentRowSum = _mm256_setzero_pd();
+    size_t j = from;
+    for (; j + 4 <= to; j += 4)
+    {
+        __m256d rj = _mm256_loadu_pd(tile.r + j);
+        __m256d all = _mm256_fnmadd_pd(o, _mm256_loadu_pd(tile.o + j), _mm256_fmadd_pd(r, rj, _mm256_loadu_pd(tile.all + j)));
+        __m256d last = _mm256_fnmadd_pd(q, _mm256_loadu_pd(tile.q + j), _mm256_fmadd_pd(r, rj, _mm256_loadu_pd(tile.last + j)));
+        __m256d value = _mm256_mul_pd(_mm256_mul_pd(_mm256_fnmadd_pd(sum, _mm256_loadu_pd(tile.mean + j), all), inverse), _mm256_loadu_pd(tile.inverse + j));
+        __m256d recentValue = _mm256_mul_pd(_mm256_mul_pd(_mm256_fnmadd_pd(recentSum, _mm256_loadu_pd(tile.recentMean + j), last), recentInverse), _mm256_loadu_pd(tile.recentInverse + j));
+        _mm256_storeu_pd(tile.all + j, all);
+        _mm256_storeu_pd(tile.last + j, last);
+        if (tile.value != nullptr)
+        {
+            _mm256_storeu_pd(tile.value + j, value);
+            _mm256_storeu_pd(tile.recentValue + j, recentValue);
+        }
+        rowSum = _mm256_add_pd(rowSum, value);
+        recentRowSum = _mm256_add_pd(recentRowSum, recentValue);
+        if (tile.columnSum != nullptr)
+        {
+            _mm256_storeu_pd(tile.columnSum + j, _mm256_add_pd(_mm256_loadu_pd(tile.columnSum + j), value));
+            _mm256_storeu_pd(tile.recentColumnSum + j, _mm256_add_pd(_mm256_loadu_pd(tile.recentColumnSum + j), recentValue));
+        }
+    }
+    alignas(32) double lanes[2][4];
+    _mm256_store_pd(lanes[0], rowSum);
+    _mm256_store_pd(lanes[1], recentRowSum);
+    for (int lane = 0; lane < 4; lane++)
+    {
+        tile.rowSum += lanes[0][lane];
+        tile.recentRowSum += lanes[1][lane];
+    }
+    crossScalar(row, tile, j, to);
+}
+
+__attribute__((target("avx512f")))
+static Moments momentsAvx512(const double* values, size_t count, double shift)
+{
+    __m512d sum = _mm512_setzero_pd();
+    __m512d sumSq = _mm512_setzero_pd();
+    __m512d low = _mm512_set1_pd(Infinity);
+    __m512d high = _mm512_set1_pd(-Infinity);
+    const __m512d offset = _mm512_set1_pd(shift);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512d x = _mm512_loadu_pd(values + i);
+        __m512d shifted = _mm512_sub_pd(x, offset);
+        sum = _mm512_add_pd(sum, shifted);
+        sumSq = _mm512_fmadd_pd(shifted, shifted, sumSq);
+        low = _mm512_mask_min_pd(low, 0xFF, low, x);    // masked forms avoid a false warning of g++ 12
+        high = _mm512_mask_max_pd(high, 0xFF, high, x);
+    }
+    alignas(64) double lanes[4][8];
+    _mm512_store_pd(lanes[0], sum);
+    _mm512_store_pd(lanes[1], sumSq);
+    _mm512_store_pd(lanes[2], low);
+    _mm512_store_pd(lanes[3], high);
+    Moments result = momentsScalar(values + i, count - i, shift);
+    for (int lane = 0; lane < 8; lane++)
+    {
+        result.sum += lanes[0][lane];
+        result.sumSq += lanes[1][lane];
+        result.min = std::min(result.min, lanes[2][lane]);
+        result.max = std::max(result.max, lanes[3][lane]);
+    }
+    result.count = count;
+    return result;
+}
+
+__attribute__((target("avx512f")))
+static void returnsAvx512(const double* prices, size_t count, double* out)
+{
+    size_t i = 0;
+    for (; i + 9 <= count; i += 8)
+    {
+        __m512d old = _mm512_loadu_pd(prices + i);
+        __m512d next = _mm512_loadu_pd(prices + i + 1);
+        _mm512_storeu_pd(out + i, _mm512_div_pd(_mm512_sub_pd(next, old), old));
+    }
+    if (i + 1 < count)
+    {
+        returnsScalar(prices + i, count - i, out + i);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void crossAvx512(const CrossRow &row, CrossTile &tile, size_t from, size_t to)
+{
+    const __m512d r = _mm512_set1_pd(row.r), o = _mm512_set1_pd(row.o), q = _mm512_set1_pd(row.q);
+    const __m512d sum = _mm512_set1_pd(row.sum), recentSum = _mm512_set1_pd(row.recentSum);
+    const __m512d inverse = _mm512_set1_pd(row.inverse), recentInverse = _mm512_set1_pd(row.recentInverse);
+    __m512d rowSum = _mm512_setzero_pd(), recentRowSum = _mm512_setzero_pd();
+    size_t j = from;
+    for (; j + 8 <= to; j += 8)
+    {
+        __m512d rj = _mm512_loadu_pd(tile.r + j);
+        __m512d all = _mm512_fnmadd_pd(o, _mm512_loadu_pd(tile.o + j), _mm512_fmadd_pd(r, rj, _mm512_loadu_pd(tile.all + j)));
+        __m512d last = _mm512_fnmadd_pd(q, _mm512_loadu_pd(tile.q + j), _mm512_fmadd_pd(r, rj, _mm512_loadu_pd(tile.last + j)));
+        __m512d value = _mm512_mul_pd(_mm512_mul_pd(_mm512_fnmadd_pd(sum, _mm512_loadu_pd(tile.mean + j), all), inverse), _mm512_loadu_pd(tile.inverse + j));
+        __m512d recentValue = _mm512_mul_pd(_mm512_mul_pd(_mm512_fnmadd_pd(recentSum, _mm512_loadu_pd(tile.recentMean + j), last), recentInverse), _mm512_loadu_pd(tile.recentInverse + j));
+        _mm512_storeu_pd(tile.all + j, all);
+        _mm512_storeu_pd(tile.last + j, last);
+        if (tile.value != nullptr)
+        {
+            _mm512_storeu_pd(tile.value + j, value);
+            _mm512_storeu_pd(tile.recentValue + j, recentValue);
+        }
+        rowSum = _mm512_add_pd(rowSum, value);
+        recentRowSum = _mm512_add_pd(recentRowSum, recentValue);
+        if (tile.columnSum != nullptr)
+        {
+            _mm512_storeu_pd(tile.columnSum + j, _mm512_add_pd(_mm512_loadu_pd(tile.columnSum + j), value));
+            _mm512_storeu_pd(tile.recentColumnSum + j, _mm512_add_pd(_mm512_loadu_pd(tile.recentColumnSum + j), recentValue));
+        }
+    }
+    alignas(64) double lanes[2][8];
+    _mm512_store_pd(lanes[0], rowSum);
+    _mm512_store_pd(lanes[1], recentRowSum);
+    for (int lane = 0; lane < 8; lane++)
+    {
+        tile.rowSum += lanes[0][lane];
+        tile.recentRowSum += lanes[1][lane];
+    }
+    crossScalar(row, tile, j, to);
+}
+
+static const KernelSet Scalar = {"scalar", momentsScalar, returnsScalar, crossScalar};
+static const KernelSet Avx2 = {"avx2", momentsAvx2, returnsAvx2, crossAvx2};
+static const KernelSet Avx512 = {"avx512", momentsAvx512, returnsAvx512, crossAvx512};
+
+// Every version this CPU can run, the fastest first
+std::vector<const KernelSet*> supportedKernels()
+{
+    std::vector<const KernelSet*> sets;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        sets.push_back(&Avx512);
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        sets.push_back(&Avx2);
+    }
+    sets.push_back(&Scalar);
+    return sets;
+}
+
+// Fastest version, chosen on the first call
+const KernelSet& kernels()
+{
+    static const KernelSet* best = supportedKernels().front();
+    return *best;
+}
+
+// Moments of many windows at once, out[i] belongs to windows[i]
+void summarize(const std::vector<Window> &windows, std::vector<Moments> &out)
+{
+    const KernelSet &set = kernels();
+    out.resize(windows.size());
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        const Window &window = windows[i];
+        out[i] = set.moments(window.first.data, window.first.count, window.shift);
+        if (window.second.count > 0)
+        {
+            out[i].merge(set.moments(window.second.data, window.second.count, window.shift));
+        }
+    }
+}
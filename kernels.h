@@ -0,0 +1,76 @@
+#ifndef kernels_h
+#define kernels_h
+#include <vector>
+#include <cstddef>
+
+// Contiguous run of prices, a ring buffer gives at most two of them for any range
+struct Span
+{
+    const double* data = nullptr;
+    size_t count = 0;
+};
+
+// Sums of (price - shift) and its square, and the extremes, over some prices
+struct Moments
+{
+    double sum = 0;
+    double sumSq = 0;
+    double min;
+    double max;
+    size_t count = 0;
+
+    Moments& merge(const Moments &other);
+};
+
+// A window of one currency in a batch: its one or two spans and the shift of its sums
+struct Window
+{
+    Span first;
+    Span second;
+    double shift = 0;
+};
+
+// A row of a tile of the correlation matrix (correlation.cpp): its new return, the returns that
+// leave the whole window and its last quarter, its sums and the inverses of its deviations
+struct CrossRow
+{
+    double r, o, q;
+    double sum, recentSum;
+    double inverse, recentInverse;
+};
+
+// Columns of the tile and what the row does to them. The arrays are indexed by column, the
+// correlations are only written or added to the sums of the columns if their pointers aren't null.
+struct CrossTile
+{
+    const double* r;
+    const double* o;
+    const double* q;
+    const double* mean;
+    const double* inverse;
+    const double* recentMean;
+    const double* recentInverse;
+    double* all;                 // cross products of the row, updated
+    double* last;
+    double* value;               // correlations, written if not null
+    double* recentValue;
+    double* columnSum;           // correlations, added
+    double* recentColumnSum;
+    double rowSum = 0;           // correlations of the row, added
+    double recentRowSum = 0;
+};
+
+// One implementation of the kernels for an instruction set
+struct KernelSet
+{
+    const char* name;
+    Moments (*moments)(const double* values, size_t count, double shift);
+    void (*returns)(const double* prices, size_t count, double* out);  // count - 1 simple returns
+    void (*cross)(const CrossRow &row, CrossTile &tile, size_t from, size_t to);  // columns [from, to)
+};
+
+const KernelSet& kernels();
+std::vector<const KernelSet*> supportedKernels();
+void summarize(const std::vector<Window> &windows, std::vector<Moments> &out);
+
+#endif
@@ -0,0 +1,307 @@
+/** ========================================================================================
+
+    Filename:  logger.cpp
+
+    Description:  Background writer of log.txt. Alert() used to open the file, format the
+                  date and close it again for every line, which under error storms (network
+                  down with many currencies) meant several syscalls per line. Now every thread
+                  hands its lines to its own lock-free ring and a flusher thread writes them in
+                  batches on a file kept open, formatting the date once per second.
+
+                  Settings: "logFormat" (text or json, one JSON object per line), "logMaxBytes"
+                  (rotate at this size, default 10485760, 0 never), "logRotateHours" (rotate
+                  at this age, default 0, never) and "logFiles" (rotated files kept as
+                  log.txt.1, log.txt.2..., default 5).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "logger.h"
+#include "persistence.h"
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+
+Logger logger;
+
+// Ring taken by the current thread, given back when the thread ends
+struct RingOwner
+{
+    LogRing* ring = nullptr;
+    ~RingOwner()
+    {
+        if (ring != nullptr)
+        {
+            ring->released.store(true);
+        }
+    }
+};
+static thread_local RingOwner owner;
+
+LogRing::LogRing(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    records.resize(size);
+    mask = size - 1;
+}
+
+// Called by the owner thread only. Returns false if the ring is full.
+bool LogRing::push(LogRecord &&record)
+{
+    size_t position = head.load(std::memory_order_relaxed);
+    if (position - tail.load(std::memory_order_acquire) == records.size())
+    {
+        return false;
+    }
+    records[position & mask] = std::move(record);
+    head.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// Called by the flusher only
+bool LogRing::pop(LogRecord &record)
+{
+    size_t position = tail.load(std::memory_order_relaxed);
+    if (position == head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    record = std::move(records[position & mask]);
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+Logger::Logger()
+{
+    flusher = std::thread(&Logger::run, this);
+}
+
+// Write whatever is left and close the file
+Logger::~Logger()
+{
+    stopping.store(true);
+    bell.ring();
+    flusher.join();
+    drain();
+    if (file != nullptr)
+    {
+        std::fclose(file);
+    }
+}
+
+// Read the format and the rotation limits
+void Logger::configure(Persistence &db)
+{
+    std::string format = db.setting("logFormat","text");
+    size_t bytes = maxBytes;
+    double hours = rotateHours;
+    int kept = files;
+    try
+    {
+        bytes = std::stoull(db.setting("logMaxBytes", std::to_string(maxBytes)));
+        hours = std::max(0.0, std::stod(db.setting("logRotateHours", std::to_string(rotateHours))));
+        kept = std::max(0, std::stoi(db.setting("logFiles", std::to_string(files))));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid logMaxBytes, logRotateHours or logFiles setting, keeping the previous values"),"error");
+    }
+    if (format != "text" && format != "json")
+    {
+        Alert(std::vector<std::string> (1,"Invalid logFormat setting " + format + ", it must be text or json"),"error");
+        format = json ? "json" : "text";
+    }
+
+    std::lock_guard<std::mutex> guard(writing);
+    json = format == "json";
+    maxBytes = bytes;
+    rotateHours = hours;
+    files = kept;
+}
+
+// Queue a line for the flusher without locks. Only if the ring of the thread is full the caller
+// writes the queued lines itself, so no line is lost under error storms.
+void Logger::write(char level, const std::string &text)
+{
+    LogRecord record;
+    record.sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+    record.time = std::time(nullptr);
+    record.level = level;
+    record.text = text;
+    LogRing &own = ring();
+    while (!own.push(std::move(record)))
+    {
+        drain();
+    }
+}
+
+// Write every queued line now
+void Logger::flush()
+{
+    drain();
+}
+
+LogRing& Logger::ring()
+{
+    if (owner.ring != nullptr)
+    {
+        return *owner.ring;
+    }
+    std::lock_guard<std::mutex> guard(registry);
+    for (const auto &candidate : rings)
+    {
+        bool released = true;
+        if (candidate->released.compare_exchange_strong(released, false))
+        {
+            owner.ring = candidate.get();
+            return *owner.ring;
+        }
+    }
+    rings.push_back(std::make_unique<LogRing>(4096));
+    owner.ring = rings.back().get();
+    return *owner.ring;
+}
+
+// Flusher thread, writes every 200 ms
+void Logger::run()
+{
+    while (!stopping.load())
+    {
+        bell.wait(std::chrono::milliseconds(200));
+        drain();
+    }
+}
+
+// Merge the rings in the order of the calls and write them in one call
+void Logger::drain()
+{
+    std::lock_guard<std::mutex> guard(writing);
+    std::vector<LogRing*> sources;
+    std::vector<LogRecord> batch;
+    LogRecord record;
+    {
+        std::lock_guard<std::mutex> list(registry);
+        for (const auto &source : rings)
+        {
+            sources.push_back(source.get());
+        }
+    }
+    for (LogRing* source : sources)
+    {
+        while (source->pop(record))
+        {
+            batch.push_back(std::move(record));
+        }
+    }
+    if (batch.empty())
+    {
+        return;
+    }
+    std::sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b){ return a.sequence < b.sequence; });
+
+    std::string out;
+    for (const LogRecord &line : batch)
+    {
+        if (json)
+        {
+            out += "{\"time\":\"" + stamp(line.time) + "\",\"unix\":" + std::to_string(line.time) + ",\"level\":\""
+                 + (line.level == 'e' ? "error" : line.level == 'k' ? "end" : "local") + "\",\"message\":\"";
+            for (char c : line.text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                    out += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                }
+                else
+                {
+                    out += c;
+                }
+            }
+            out += "\"}\n";
+        }
+        else if (line.level == 'k')
+        {
+            out += "------------------------------------------------------------------------------------------------------------------------------------------------------------\n";
+        }
+        else
+        {
+            out += "[" + stamp(line.time) + "] " + line.text + '\n';
+        }
+    }
+
+    std::time_t now = std::time(nullptr);
+    if (file == nullptr)
+    {
+        file = std::fopen(path.c_str(), "a");
+        if (file == nullptr)
+        {
+            std::cout << "[" << stamp(now) << "] " << "Error opening " << path << ". Couldn't write " << batch.size() << " alerts" << std::endl;
+            return;
+        }
+        std::fseek(file, 0, SEEK_END);
+        size = std::ftell(file);
+        opened = now;
+    }
+    if ((maxBytes > 0 && size > 0 && size + out.size() > maxBytes) || (rotateHours > 0 && now - opened >= 3600*rotateHours))
+    {
+        rotate(now);
+    }
+    if (file != nullptr)
+    {
+        std::fwrite(out.data(), 1, out.size(), file);
+        std::fflush(file);
+        size += out.size();
+    }
+}
+
+// Rename log.txt to log.txt.1, shifting the older files, and start a new one
+void Logger::rotate(std::time_t now)
+{
+    std::fclose(file);
+    if (files > 0)
+    {
+        std::remove((path + "." + std::to_string(files)).c_str());
+        for (int i = files - 1; i >= 1; i--)
+        {
+            std::rename((path + "." + std::to_string(i)).c_str(), (path + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(path.c_str(), (path + ".1").c_str());
+    }
+    file = std::fopen(path.c_str(), files > 0 ? "a" : "w");
+    size = 0;
+    opened = now;
+}
+
+// Local date of the time given, formatted once per second
+const std::string& Logger::stamp(std::time_t time)
+{
+    if (time != cachedSecond)
+    {
+        char temp[32];
+        std::tm local_time;
+        localtime_r(&time, &local_time);
+        std::strftime(temp, sizeof(temp), "%Y-%m-%d %H:%M:%S", &local_time);
+        cachedStamp = temp;
+        cachedSecond = time;
+    }
+    return cachedStamp;
+}
@@ -0,0 +1,81 @@
+#ifndef logger_h
+#define logger_h
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include "queue.h"
+
+class Persistence;
+
+// One line of the log, kept until the flusher writes it
+struct LogRecord
+{
+    unsigned long long sequence = 0;  // order of the calls across threads
+    std::time_t time = 0;
+    char level = 'l';                 // 'e' error, 'l' local, 'k' end of a session
+    std::string text;
+};
+
+// Single producer, single consumer ring of records owned by one thread
+class LogRing
+{
+public:
+    explicit LogRing(size_t capacity);
+    bool push(LogRecord &&record);
+    bool pop(LogRecord &record);
+
+    std::atomic<bool> released{false};  // its thread ended, another one may take it
+
+private:
+    std::vector<LogRecord> records;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};  // next to write, only moved by the producer
+    alignas(64) std::atomic<size_t> tail{0};  // next to read, only moved by the flusher
+};
+
+// Writes log.txt from a background thread. Every thread appends its records to its own ring
+// without locks, and the flusher merges them in order and writes them in one call per batch.
+// The file stays open and is rotated by size or age. Lines are plain text or JSON lines.
+class Logger
+{
+public:
+    Logger();
+    ~Logger();
+    void configure(Persistence &db);
+    void write(char level, const std::string &text);
+    void flush();
+
+private:
+    LogRing& ring();
+    void run();
+    void drain();
+    void rotate(std::time_t now);
+    const std::string& stamp(std::time_t time);
+
+    std::mutex registry;                     // rings
+    std::vector<std::unique_ptr<LogRing>> rings;
+    std::atomic<unsigned long long> sequence{0};
+    Doorbell bell;
+    std::atomic<bool> stopping{false};
+    std::mutex writing;                      // the file and the settings, taken by the flusher or flush()
+    std::FILE* file = nullptr;
+    size_t size = 0;                         // bytes in the current file
+    std::time_t opened = 0;
+    std::time_t cachedSecond = -1;
+    std::string cachedStamp;                 // "YYYY-MM-DD HH:MM:SS" of cachedSecond
+    std::string path = "log.txt";
+    bool json = false;
+    size_t maxBytes = 10*1024*1024;          // 0 never rotates by size
+    double rotateHours = 0;                  // 0 never rotates by age
+    int files = 5;                           // rotated files kept
+    std::thread flusher;
+};
+
+extern Logger logger;
+
+#endif
@@ -0,0 +1,195 @@
+/** ========================================================================================
+
+    Filename:  mailer.cpp
+
+    Description:  E-mail alerts. Instead of one SMTP session per alert, the alerts of every
+                  analysis pass are collected and sent as a single digest once the flush window
+                  ends. The credentials come from the configuration snapshot (config.cpp),
+                  and the same curl handle is reused, so while the server keeps the
+                  session open a digest costs no new TLS handshake nor login.
+
+                  Settings: "smtpUrl" (default smtp://smtp.<domain of the e-mail>:587),
+                  "smtpTls" (1 requires TLS, 0 is meant for a local SMTP sink, default 1) and
+                  "digestWindow", seconds an alert waits for others (default 30).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "mailer.h"
+#include "config.h"
+#include "persistence.h"
+#include "trace.h"
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <stdexcept>
+
+struct UploadStatus {std::string message; size_t bytes_read;};
+
+// Callback for curl, hands the message in pieces
+static size_t upload(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    UploadStatus *upload_ctx = static_cast<UploadStatus*>(userdata);
+    size_t max_copy = size * nmemb;
+    size_t remaining = upload_ctx->message.size() - upload_ctx->bytes_read;
+    size_t copy_this_much = (remaining < max_copy) ? remaining : max_copy;
+
+    if(copy_this_much > 0) {
+        memcpy(ptr, upload_ctx->message.data() + upload_ctx->bytes_read, copy_this_much);
+        upload_ctx->bytes_read += copy_this_much;
+    }
+    return copy_this_much;
+}
+
+Mailer::Mailer()
+{
+    curl = curl_easy_init();
+}
+
+Mailer::~Mailer()
+{
+    curl_easy_cleanup(curl);
+}
+
+// Take the account provided by the user and read the SMTP server and the flush window.
+// Returns 0 or -1 if the alerts can't be sent with the current values.
+int Mailer::configure(Persistence &db, const Config &config)
+{
+    const std::vector<std::string> validDomains {"gmail.com","outlook.com","hotmail.com","alumnos.udg.mx"}; // Scalable way to add custom SMTP servers later
+
+    if (db.handle() == nullptr)
+    {
+        Alert(std::vector<std::string> (1,"Error reading the e-mail settings, probably the database is missing"),"error");
+        return -1;
+    }
+    mail = config.mail;
+    password = config.password;
+
+    try
+    {
+        window = std::max(0.0, std::stod(db.setting("digestWindow", std::to_string(window))));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid digestWindow setting, keeping " + std::to_string(window) + " seconds"),"error");
+    }
+    tls = db.setting("smtpTls","1") != "0";
+
+    // Change domains that don't correspond to the actual name of the SMTP server.
+    std::string domain = mail.substr(mail.find("@")+1);
+    if (domain == validDomains[2])
+    {
+        domain = "outlook.com";
+    }
+    else if (domain == validDomains[3])
+    {
+        domain = "gmail.com";
+    }
+    url = db.setting("smtpUrl","smtp://smtp." + domain + ":587");
+
+    if (mail.empty() || password.empty())
+    {
+        Alert(std::vector<std::string> (1,"An e-mail alert was triggered but you didn't introduce both e-mail and password "),"error");
+        return -1;
+    }
+    return 0;
+}
+
+// Queue the alerts of one analysis pass for the next digest
+void Mailer::add(const std::vector<std::string> &alerts)
+{
+    if (alerts.empty())
+    {
+        return;
+    }
+    if (queued.empty())
+    {
+        first = Clock::now();
+    }
+    queued.insert(queued.end(), alerts.begin(), alerts.end());
+}
+
+// When the queued alerts have to be sent
+Mailer::Clock::time_point Mailer::deadline() const
+{
+    return first + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(window));
+}
+
+bool Mailer::due() const
+{
+    return !queued.empty() && Clock::now() >= deadline();
+}
+
+// Send every queued alert in one message, on the session kept by the curl handle.
+// configure() must have succeeded. Returns 0, or -1 and the alerts are dropped.
+int Mailer::flush()
+{
+    if (queued.empty())
+    {
+        return 0;
+    }
+    Trace span(Smtp);
+    if (curl == nullptr)
+    {
+        Alert(std::vector<std::string> (1,"E-mail alert was triggered but curl failed to initialize"),"error");
+        queued.clear();
+        return -1;
+    }
+
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::tm local_time;
+    localtime_r(&now, &local_time);
+    std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S %z", &local_time);
+
+    // Curl expects its own type of list
+    std::string from =  "<"+mail+">";
+    std::string to = "<"+ mail + ">";
+    UploadStatus message = {"Date: " + std::string(date) + "\r\nTo: " + to + "\r\nFrom: " + from
+                            + "\r\nSubject: CryptoAnalysis: " + std::to_string(queued.size()) + (queued.size() == 1 ? " alert" : " alerts") + "\r\n\r\n", 0};
+    for (const std::string &alert : queued)
+    {
+        message.message += alert + "\r\n";
+    }
+    struct curl_slist *recipients = NULL;
+    recipients = curl_slist_append(recipients, to.c_str());
+
+    curl_easy_setopt(curl, CURLOPT_URL,url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERNAME, mail.c_str());
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, password.c_str());
+    curl_easy_setopt(curl, CURLOPT_USE_SSL, tls ? CURLUSESSL_ALL : CURLUSESSL_NONE);
+    curl_easy_setopt(curl, CURLOPT_MAIL_FROM,from.c_str());
+    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, recipients);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &message);
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, nullptr);
+    curl_slist_free_all(recipients);
+    size_t count = queued.size();
+    queued.clear();
+
+    if(res == CURLE_OK)
+    {
+        Alert(std::vector<std::string> (1,"SMTP digest with " + std::to_string(count) + (count == 1 ? " alert" : " alerts") + " sent"),"local");
+        return 0;
+    }
+    else if (res == CURLE_LOGIN_DENIED)
+    {
+        Alert(std::vector<std::string> (1,"E-mail alert was triggered but got the following error (gmail / outlook don't allow simple email-password authentication, you need to create an application password): " + std::string(curl_easy_strerror(res))),"error");
+    }
+    else
+    {
+        Alert(std::vector<std::string> (1,"E-mail alert was triggered but failed to get a response from e-mail server: " + std::string(curl_easy_strerror(res))),"error");
+    }
+    return -1;
+}
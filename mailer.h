@@ -0,0 +1,41 @@
+#ifndef mailer_h
+#define mailer_h
+#include <vector>
+#include <string>
+#include <chrono>
+#include <curl/curl.h>
+
+class Persistence;
+struct Config;
+
+// Sends the e-mail alerts as digests through one SMTP session. Alerts are collected for the flush
+// window and then sent together in a single message. The curl handle is kept between digests so
+// the authenticated connection is reused while the server keeps it open.
+class Mailer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Mailer();
+    ~Mailer();
+    Mailer(const Mailer&) = delete;
+    Mailer& operator=(const Mailer&) = delete;
+    int configure(Persistence &db, const Config &config);
+    void add(const std::vector<std::string> &alerts);
+    bool due() const;
+    Clock::time_point deadline() const;
+    size_t pending() const { return queued.size(); }
+    int flush();
+
+private:
+    CURL* curl = nullptr;
+    std::string mail;
+    std::string password;
+    std::string url;
+    bool tls = true;
+    double window = 30;                  // seconds an alert waits for others before the digest is sent
+    std::vector<std::string> queued;
+    Clock::time_point first;             // when the oldest queued alert was added
+};
+
+#endif
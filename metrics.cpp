@@ -0,0 +1,232 @@
+/** ========================================================================================
+
+    Filename:  metrics.cpp
+
+    Description:  Counters of the fetch, write and analysis stages and the depth of the queues
+                  of the pipeline, served over HTTP in the Prometheus text format, so a server
+                  running the program headless can be watched without reading log.txt. The
+                  stages only add to atomics; the text is built when /metrics is requested.
+
+                  Setting: "metricsPort", TCP port on 127.0.0.1 (default 9464, 0 disables it).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+
+Metrics metrics;
+
+void Histogram::observe(double seconds)
+{
+    int bucket = 0;
+    while (bucket < Buckets && seconds > Bounds[bucket])
+    {
+        bucket++;
+    }
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    micros.fetch_add(static_cast<unsigned long long>(std::llround(std::max(0.0, seconds)*1e6)), std::memory_order_relaxed);
+}
+
+// Cumulative buckets, sum and count
+std::string Histogram::format(const std::string &name, const std::string &help) const
+{
+    std::string out = "# HELP " + name + " " + help + "\n# TYPE " + name + " histogram\n";
+    unsigned long long total = 0;
+    char line[128];
+    for (int bucket = 0; bucket <= Buckets; bucket++)
+    {
+        total += counts[bucket].load(std::memory_order_relaxed);
+        if (bucket < Buckets)
+        {
+            std::snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name.c_str(), Bounds[bucket], total);
+        }
+        else
+        {
+            std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", name.c_str(), total);
+        }
+        out += line;
+    }
+    std::snprintf(line, sizeof(line), "%s_sum %.6f\n%s_count %llu\n", name.c_str(), micros.load(std::memory_order_relaxed)/1e6, name.c_str(), total);
+    return out + line;
+}
+
+Exporter::~Exporter()
+{
+    stop();
+}
+
+// Listen on 127.0.0.1 at the port given and start the thread. Returns 0 or -1 with errors.
+int Exporter::start(int port, const char* file)
+{
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    database = file;
+
+    int reuse = 1;
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+        || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error serving the metrics on port " + std::to_string(port) + ": " + std::string(std::strerror(errno))),"error");
+        stop();
+        return -1;
+    }
+    stopping.store(false);
+    thread = std::thread(&Exporter::run, this);
+    return 0;
+}
+
+void Exporter::stop()
+{
+    stopping.store(true);
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    if (listener >= 0)
+    {
+        close(listener);
+    }
+    listener = -1;
+}
+
+// Scrapes are rare and short, they are answered one at a time
+void Exporter::run()
+{
+    while (!stopping.load())
+    {
+        pollfd listening = {listener, POLLIN, 0};
+        if (poll(&listening, 1, 500) <= 0)
+        {
+            continue;
+        }
+        int client = accept(listener, nullptr, nullptr);
+        if (client >= 0)
+        {
+            answer(client);
+            close(client);
+        }
+    }
+}
+
+// Read the request line and send the metrics, or 404 for any other path
+void Exporter::answer(int client)
+{
+    std::string request;
+    char buffer[1024];
+    pollfd readable = {client, POLLIN, 0};
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192 && poll(&readable, 1, 1000) > 0)
+    {
+        ssize_t got = recv(client, buffer, sizeof(buffer), 0);
+        if (got <= 0)
+        {
+            return;
+        }
+        request.append(buffer, got);
+    }
+
+    std::string status = "404 Not Found";
+    std::string body = "Not found, the metrics are at /metrics\n";
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0)
+    {
+        status = "200 OK";
+        body = render();
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: "
+                         + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+        ssize_t wrote = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (wrote <= 0)
+        {
+            return;
+        }
+        sent += wrote;
+    }
+}
+
+// NaN and the infinities are spelled NaN, +Inf and -Inf by Prometheus, not as printf writes them
+static std::string sample(const std::string &name, const char* type, const std::string &help, double value)
+{
+    char line[64];
+    if (std::isnan(value))
+    {
+        std::snprintf(line, sizeof(line), " NaN\n");
+    }
+    else if (std::isinf(value))
+    {
+        std::snprintf(line, sizeof(line), value > 0 ? " +Inf\n" : " -Inf\n");
+    }
+    else
+    {
+        std::snprintf(line, sizeof(line), " %.17g\n", value);
+    }
+    return "# HELP " + name + " " + help + "\n# TYPE " + name + " " + type + "\n" + name + line;
+}
+
+std::string Exporter::render() const
+{
+    std::string out;
+    out += metrics.fetchSeconds.format("crypto_fetch_seconds", "Duration of the API calls.");
+    out += metrics.analysisSeconds.format("crypto_analysis_seconds", "Duration of the analysis passes.");
+    out += sample("crypto_ticks_total", "counter", "Transactions of prices written.", metrics.ticks.load());
+    out += sample("crypto_rows_inserted_total", "counter", "Prices written.", metrics.rows.load());
+    out += sample("crypto_rows_last_tick", "gauge", "Prices written by the last transaction.", metrics.lastRows.load());
+    out += sample("crypto_rate_limited_total", "counter", "Requests refused by the API rate limit.", metrics.rateLimited.load());
+    out += sample("crypto_fetch_errors_total", "counter", "Requests that failed for other reasons.", metrics.fetchErrors.load());
+    out += sample("crypto_last_fetch_timestamp_seconds", "gauge", "Unix time of the last API call that returned prices.", metrics.lastFetch.load());
+
+    std::vector<QueueMetrics> queues = pipeline.metrics();
+    out += "# HELP crypto_queue_depth Batches waiting in each queue of the pipeline.\n# TYPE crypto_queue_depth gauge\n";
+    for (const QueueMetrics &queue : queues)
+    {
+        out += "crypto_queue_depth{queue=\"" + std::string(queue.name) + "\"} " + std::to_string(queue.depth) + "\n";
+    }
+    out += "# HELP crypto_queue_capacity Batches each queue of the pipeline can hold.\n# TYPE crypto_queue_capacity gauge\n";
+    for (const QueueMetrics &queue : queues)
+    {
+        out += "crypto_queue_capacity{queue=\"" + std::string(queue.name) + "\"} " + std::to_string(queue.capacity) + "\n";
+    }
+    out += "# HELP crypto_queue_refused_total Batches refused because a queue was full.\n# TYPE crypto_queue_refused_total counter\n";
+    for (const QueueMetrics &queue : queues)
+    {
+        out += "crypto_queue_refused_total{queue=\"" + std::string(queue.name) + "\"} " + std::to_string(queue.rejected) + "\n";
+    }
+
+    // The WAL holds the pages not yet checkpointed, it is part of the size on disk
+    struct stat info;
+    double bytes = 0;
+    for (const std::string &file : {database, database + "-wal"})
+    {
+        if (stat(file.c_str(), &info) == 0)
+        {
+            bytes += info.st_size;
+        }
+    }
+    out += sample("crypto_database_bytes", "gauge", "Size of the database and its WAL.", bytes);
+    return out;
+}
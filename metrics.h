@@ -0,0 +1,61 @@
+#ifndef metrics_h
+#define metrics_h
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+
+class Pipeline;
+
+// Durations in the default buckets of Prometheus, updated without locks from any thread
+class Histogram
+{
+public:
+    void observe(double seconds);
+    std::string format(const std::string &name, const std::string &help) const;
+
+private:
+    static constexpr int Buckets = 12;
+    static constexpr double Bounds[Buckets] = {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+    std::atomic<unsigned long long> counts[Buckets + 1] = {};  // the last one is +Inf
+    std::atomic<unsigned long long> micros{0};                 // sum
+};
+
+// Counters of the whole process, written where things happen and read by the Exporter
+struct Metrics
+{
+    Histogram fetchSeconds;                         // API calls
+    Histogram analysisSeconds;                      // analysis passes
+    std::atomic<unsigned long long> ticks{0};       // transactions of prices written
+    std::atomic<unsigned long long> rows{0};        // prices written
+    std::atomic<unsigned long long> lastRows{0};    // prices of the last transaction
+    std::atomic<unsigned long long> rateLimited{0}; // chunks refused with 429
+    std::atomic<unsigned long long> fetchErrors{0}; // chunks that failed otherwise
+    std::atomic<long long> lastFetch{0};            // unix time of the last call with prices
+};
+
+extern Metrics metrics;
+
+// Minimal HTTP server on 127.0.0.1 answering GET /metrics in the Prometheus text format, with the
+// counters above, the depth of the pipeline queues and the size of the database.
+class Exporter
+{
+public:
+    explicit Exporter(const Pipeline &pipeline) : pipeline(pipeline) {}
+    ~Exporter();
+    int start(int port, const char* database);
+    void stop();
+
+private:
+    void run();
+    void answer(int client);
+    std::string render() const;
+
+    const Pipeline &pipeline;
+    std::string database;
+    int listener = -1;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,241 @@
+/** ========================================================================================
+
+    Filename:  parser.cpp
+
+    Description:  Streaming parser for the /simple/price response of the CoinGecko API. The
+                  response is walked once, byte by byte, as curl receives it. Keys are matched
+                  exactly against the GeckoIDs requested (so "bitcoin" never matches
+                  "bitcoin-cash") and prices and times are written straight into arrays
+                  allocated by the caller. Keys and numbers are gathered in a fixed buffer,
+                  so no strings are created while parsing.
+
+                  The history of a new currency (/coins/{id}/market_chart) is read once its
+                  response is complete, only its "prices" array is used.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "parser.h"
+#include <charconv>
+
+PriceParser::PriceParser(const std::vector<std::string> &names, size_t begin, size_t end, std::string_view currency,
+                         double* prices, double* times, char* found)
+    : currency(currency), prices(prices), times(times), found(found)
+{
+    ids.reserve(end - begin);
+    for (size_t i = begin; i < end; i++)
+    {
+        ids.emplace(names[i], i);
+        found[i] = 0;
+    }
+}
+
+void PriceParser::feed(std::string_view bytes)
+{
+    for (char c : bytes)
+    {
+        if (inString)
+        {
+            if (escape)
+            {
+                escape = false;
+            }
+            else if (c == '\\')
+            {
+                escape = true;
+                continue;
+            }
+            else if (c == '"')
+            {
+                inString = false;
+                endString();
+                continue;
+            }
+            if (stringIsKey)
+            {
+                if (tokenSize < sizeof(token))
+                {
+                    token[tokenSize++] = c;
+                }
+                else
+                {
+                    overflow = true;
+                }
+            }
+            continue;
+        }
+        if (inNumber)
+        {
+            if ((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E')
+            {
+                if (tokenSize < sizeof(token))
+                {
+                    token[tokenSize++] = c;
+                }
+                continue;
+            }
+            inNumber = false;
+            endNumber();
+        }
+
+        switch (c)
+        {
+            case '{':
+            case '[':
+                if (depth == static_cast<int>(sizeof(stack)))
+                {
+                    return; // nested too deep to be a price response
+                }
+                stack[depth++] = c;
+                started = true;
+                expectKey = c == '{';
+                if (c == '{' && depth == 2)
+                {
+                    current = pending;
+                }
+                break;
+            case '}':
+            case ']':
+                if (depth > 0)
+                {
+                    depth--;
+                }
+                if (depth < 2)
+                {
+                    current = -1;
+                }
+                expectKey = false;
+                field = 0;
+                break;
+            case '"':
+                inString = true;
+                stringIsKey = depth > 0 && stack[depth - 1] == '{' && expectKey;
+                tokenSize = 0;
+                overflow = false;
+                break;
+            case ':':
+                expectKey = false;
+                break;
+            case ',':
+                expectKey = depth > 0 && stack[depth - 1] == '{';
+                field = 0;
+                break;
+            default:
+                if ((c >= '0' && c <= '9') || c == '-')
+                {
+                    inNumber = true;
+                    tokenSize = 0;
+                    token[tokenSize++] = c;
+                }
+                break;
+        }
+    }
+}
+
+void PriceParser::endString()
+{
+    if (!stringIsKey || overflow)
+    {
+        pending = depth == 1 ? -1 : pending;
+        field = 0;
+        return;
+    }
+    std::string_view key(token, tokenSize);
+    if (depth == 1)
+    {
+        auto id = ids.find(key);
+        pending = id == ids.end() ? -1 : static_cast<long>(id->second);
+    }
+    else if (depth == 2 && current >= 0)
+    {
+        field = key == currency ? 1 : key == "last_updated_at" ? 2 : 0;
+    }
+}
+
+void PriceParser::endNumber()
+{
+    double value;
+    if (depth != 2 || current < 0 || field == 0 || std::from_chars(token, token + tokenSize, value).ec != std::errc())
+    {
+        return;
+    }
+    if (field == 1)
+    {
+        prices[current] = value;
+    }
+    else
+    {
+        times[current] = value;
+    }
+    found[current] |= field;
+    field = 0;
+}
+
+bool parseChart(std::string_view body, std::vector<double> &times, std::vector<double> &prices)
+{
+    size_t at = body.find("\"prices\"");
+    at = at == std::string_view::npos ? at : body.find('[', at);
+    if (at == std::string_view::npos)
+    {
+        return false;
+    }
+    const char* c = body.data() + at + 1;
+    const char* end = body.data() + body.size();
+    auto skip = [&c, end]()
+    {
+        while (c < end && (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t'))
+        {
+            c++;
+        }
+    };
+    times.clear();
+    prices.clear();
+    skip();
+    if (c < end && *c == ']')
+    {
+        return true;
+    }
+    while (c < end)
+    {
+        double time, price;
+        skip();
+        if (c == end || *c++ != '[')
+        {
+            return false;
+        }
+        skip();
+        auto parsed = std::from_chars(c, end, time);
+        c = parsed.ptr;
+        skip();
+        if (parsed.ec != std::errc() || c == end || *c++ != ',')
+        {
+            return false;
+        }
+        skip();
+        parsed = std::from_chars(c, end, price);
+        c = parsed.ptr;
+        skip();
+        if (parsed.ec != std::errc() || c == end || *c++ != ']')
+        {
+            return false;
+        }
+        times.push_back(time/1000);
+        prices.push_back(price);
+        skip();
+        if (c < end && *c == ']')
+        {
+            return true;
+        }
+        if (c == end || *c++ != ',')
+        {
+            return false;
+        }
+    }
+    return false;
+}
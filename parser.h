@@ -0,0 +1,52 @@
+#ifndef parser_h
+#define parser_h
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Single pass parser of a /simple/price response: {"id":{"usd":price,"last_updated_at":time},...}
+// Bytes can be fed as they arrive. Prices and times are written to the caller's arrays at the
+// position of each id in names, and found[i] is set to Found once both were read.
+class PriceParser
+{
+public:
+    static const char Found = 3;
+
+    PriceParser() = default;
+    PriceParser(const std::vector<std::string> &names, size_t begin, size_t end, std::string_view currency,
+                double* prices, double* times, char* found);
+    void feed(std::string_view bytes);
+    bool complete() const { return started && depth == 0; }
+
+private:
+    void endString();
+    void endNumber();
+
+    std::unordered_map<std::string_view, size_t> ids;  // GeckoID -> position in names
+    std::string_view currency;
+    double* prices = nullptr;
+    double* times = nullptr;
+    char* found = nullptr;
+
+    char stack[32];          // '{' or '[' of every container open
+    int depth = 0;
+    bool started = false;
+    bool expectKey = false;
+    bool inString = false;
+    bool escape = false;
+    bool stringIsKey = false;
+    bool inNumber = false;
+    char token[128];         // key or number being read, may span several calls to feed()
+    size_t tokenSize = 0;
+    bool overflow = false;
+    long pending = -1;       // id whose key was just read
+    long current = -1;       // id whose object is open
+    int field = 0;           // 1 while reading the price, 2 while reading last_updated_at
+};
+
+// Prices of a /coins/{id}/market_chart response: {"prices":[[milliseconds,price],...],"market_caps":...}
+// Times are converted to seconds. Returns false if the "prices" array is missing or malformed.
+bool parseChart(std::string_view body, std::vector<double> &times, std::vector<double> &prices);
+
+#endif
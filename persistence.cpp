@@ -0,0 +1,248 @@
+/** ========================================================================================
+
+    Filename:  persistence.cpp
+
+    Description:  Keeps one connection to Crypto.db open for the whole run. The statements
+                  used on every API call are prepared once, GeckoIDs are resolved to the
+                  internal IDs from a cached map and all the prices of a call are inserted in
+                  one transaction, so a refresh costs a single journal sync.
+
+                  The journal mode and synchronous level are read from the Settings table
+                  ("journalMode", default WAL, and "synchronous", default NORMAL). The schema
+                  version is kept in PRAGMA user_version and older files are migrated when
+                  they are opened.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "persistence.h"
+
+// Changes of the schema, Migrations[i] takes a file from user_version i to i + 1.
+// 1: covering index of the prices of a currency by time, and of its Configs rows by alertID.
+// 2: decoupling threshold of Configs (correlation.cpp), 0 for the rows written before it.
+static const char* Migrations[] = {
+    "CREATE INDEX IF NOT EXISTS PricesByCurrency ON Prices(CurrencyID,time,price);"
+    "CREATE INDEX IF NOT EXISTS ConfigsByCurrency ON Configs(CurrencyID,alertID);",
+    "ALTER TABLE Configs ADD COLUMN decoupling REAL NOT NULL DEFAULT 0;",
+    // Times of the open and close prices of the rollups, the buckets written before keep the
+    // open of their first write and take the close of the next one
+    "ALTER TABLE PricesMinute ADD COLUMN openTime REAL NOT NULL DEFAULT 0;ALTER TABLE PricesMinute ADD COLUMN closeTime REAL NOT NULL DEFAULT 0;"
+    "ALTER TABLE PricesHour ADD COLUMN openTime REAL NOT NULL DEFAULT 0;ALTER TABLE PricesHour ADD COLUMN closeTime REAL NOT NULL DEFAULT 0;"
+    "ALTER TABLE PricesDay ADD COLUMN openTime REAL NOT NULL DEFAULT 0;ALTER TABLE PricesDay ADD COLUMN closeTime REAL NOT NULL DEFAULT 0;"
+    "UPDATE PricesMinute SET openTime = bucket, closeTime = bucket;UPDATE PricesHour SET openTime = bucket, closeTime = bucket;"
+    "UPDATE PricesDay SET openTime = bucket, closeTime = bucket;"
+};
+
+Persistence::~Persistence()
+{
+    close();
+}
+
+// Open the database, apply the configured pragmas and prepare the statements.
+// Returns 0 or -1 with errors.
+int Persistence::open(const char* path)
+{
+    const char* Settings = "CREATE TABLE IF NOT EXISTS Settings(name TEXT PRIMARY KEY, value TEXT NOT NULL);";
+    // Alert rules of the user (rules.cpp), a NULL CurrencyID applies to every currency
+    const char* Rules = "CREATE TABLE IF NOT EXISTS Rules(name TEXT PRIMARY KEY, expression TEXT NOT NULL, CurrencyID INTEGER);";
+    const char* Rollups = "CREATE TABLE IF NOT EXISTS PricesMinute(CurrencyID INTEGER NOT NULL, bucket INTEGER NOT NULL, open REAL NOT NULL, high REAL NOT NULL, low REAL NOT NULL, close REAL NOT NULL, count INTEGER NOT NULL, PRIMARY KEY(CurrencyID,bucket)) WITHOUT ROWID;"
+                          "CREATE TABLE IF NOT EXISTS PricesHour(CurrencyID INTEGER NOT NULL, bucket INTEGER NOT NULL, open REAL NOT NULL, high REAL NOT NULL, low REAL NOT NULL, close REAL NOT NULL, count INTEGER NOT NULL, PRIMARY KEY(CurrencyID,bucket)) WITHOUT ROWID;"
+                          "CREATE TABLE IF NOT EXISTS PricesDay(CurrencyID INTEGER NOT NULL, bucket INTEGER NOT NULL, open REAL NOT NULL, high REAL NOT NULL, low REAL NOT NULL, close REAL NOT NULL, count INTEGER NOT NULL, PRIMARY KEY(CurrencyID,bucket)) WITHOUT ROWID;";
+    // The date is derived from time when it is read, new rows keep the column empty
+    const char* Statement = "INSERT INTO Prices (\"CurrencyID\",\"time\",\"date\",\"price\") VALUES (?,?,'',?);";
+    const char* settingQuery = "SELECT value FROM Settings WHERE name = ?;";
+
+    close();
+    if (sqlite3_open(path,&db) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error opening database, probably the database is missing: " + std::string(sqlite3_errmsg(db))),"error");
+        return -1;
+    }
+    sqlite3_busy_timeout(db,5000); // the GUI writes to the same file
+    if (sqlite3_exec(db,Settings,nullptr,nullptr,nullptr) != SQLITE_OK || sqlite3_exec(db,Rules,nullptr,nullptr,nullptr) != SQLITE_OK
+        || sqlite3_exec(db,Rollups,nullptr,nullptr,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,settingQuery,-1,&settingStmt,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error reading settings: " + std::string(sqlite3_errmsg(db))),"error");
+        return -1;
+    }
+
+    const std::string journal = "PRAGMA journal_mode = " + setting("journalMode","WAL") + ";";
+    const std::string synchronous = "PRAGMA synchronous = " + setting("synchronous","NORMAL") + ";";
+    if (sqlite3_exec(db,journal.c_str(),nullptr,nullptr,nullptr) != SQLITE_OK || sqlite3_exec(db,synchronous.c_str(),nullptr,nullptr,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Invalid journalMode or synchronous setting: " + std::string(sqlite3_errmsg(db))),"error");
+    }
+    if (migrate() != 0)
+    {
+        return -1;
+    }
+
+    if (sqlite3_prepare_v2(db,Statement,-1,&insertStmt,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,"BEGIN;",-1,&beginStmt,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,"COMMIT;",-1,&commitStmt,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,"ROLLBACK;",-1,&rollbackStmt,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error preparing statements: " + std::string(sqlite3_errmsg(db))),"error");
+        return -1;
+    }
+    return refresh();
+}
+
+void Persistence::close()
+{
+    sqlite3_finalize(insertStmt);
+    sqlite3_finalize(beginStmt);
+    sqlite3_finalize(commitStmt);
+    sqlite3_finalize(rollbackStmt);
+    sqlite3_finalize(settingStmt);
+    insertStmt = beginStmt = commitStmt = rollbackStmt = settingStmt = nullptr;
+    sqlite3_close(db);
+    db = nullptr;
+}
+
+// Bring the schema up to the last version, each step in its own transaction. Files whose tables
+// weren't created by the GUI yet are left alone until they exist. Returns 0 or -1 with errors.
+int Persistence::migrate()
+{
+    const int latest = sizeof(Migrations)/sizeof(Migrations[0]);
+    sqlite3_stmt* stmt = nullptr;
+    int version = 0;
+    int tables = 0;
+
+    if (sqlite3_prepare_v2(db,"PRAGMA user_version;",-1,&stmt,nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        version = sqlite3_column_int(stmt,0);
+    }
+    sqlite3_finalize(stmt);
+    if (sqlite3_prepare_v2(db,"SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name IN ('Prices','Configs');",-1,&stmt,nullptr) == SQLITE_OK
+        && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        tables = sqlite3_column_int(stmt,0);
+    }
+    sqlite3_finalize(stmt);
+
+    for (; version < latest && tables == 2; version++)
+    {
+        const std::string step = std::string("BEGIN IMMEDIATE;") + Migrations[version] + "PRAGMA user_version = " + std::to_string(version + 1) + ";COMMIT;";
+        if (sqlite3_exec(db,step.c_str(),nullptr,nullptr,nullptr) != SQLITE_OK)
+        {
+            Alert(std::vector<std::string> (1,"Error migrating the database to version " + std::to_string(version + 1) + ": " + std::string(sqlite3_errmsg(db))),"error");
+            if (!sqlite3_get_autocommit(db))
+            {
+                sqlite3_exec(db,"ROLLBACK;",nullptr,nullptr,nullptr);
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Reload the GeckoID -> ID map from Currencies, they change when the user adds or deletes one.
+// Returns 0 or -1 with errors.
+int Persistence::refresh()
+{
+    const char* Query = "SELECT ID,GeckoID FROM Currencies;";
+    sqlite3_stmt* stmt;
+
+    ids.clear();
+    geckoIDs.clear();
+    if (sqlite3_prepare_v2(db,Query,-1,&stmt,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error reading crypto IDs internally: " + std::string(sqlite3_errmsg(db))),"error");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt,1));
+        if (!ids.emplace(name,sqlite3_column_int(stmt,0)).second)
+        {
+            Alert(std::vector<std::string> (1,"Duplicated ID entries for the same crypto currency: " + name + ", the database in your computer is not reliable. Aborting."),"error");
+            sqlite3_finalize(stmt);
+            ids.clear();
+            geckoIDs.clear();
+            return -1;
+        }
+        geckoIDs.push_back(name);
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+int Persistence::begin()
+{
+    int flag = sqlite3_step(beginStmt);
+    sqlite3_reset(beginStmt);
+    if (flag != SQLITE_DONE)
+    {
+        Alert(std::vector<std::string> (1,"Error starting a transaction: " + std::string(sqlite3_errmsg(db))),"error");
+        return -1;
+    }
+    return 0;
+}
+
+int Persistence::commit()
+{
+    int flag = sqlite3_step(commitStmt);
+    sqlite3_reset(commitStmt);
+    if (flag != SQLITE_DONE)
+    {
+        Alert(std::vector<std::string> (1,"Error writing changes to database: " + std::string(sqlite3_errmsg(db))),"error");
+        rollback();
+        return -1;
+    }
+    return 0;
+}
+
+void Persistence::rollback()
+{
+    if (!sqlite3_get_autocommit(db))
+    {
+        sqlite3_step(rollbackStmt);
+        sqlite3_reset(rollbackStmt);
+    }
+}
+
+// Append one price. Returns 0 or -1 with errors.
+int Persistence::insert(int id, double time, double price)
+{
+    sqlite3_bind_int(insertStmt,1,id);
+    sqlite3_bind_double(insertStmt,2,time);
+    sqlite3_bind_double(insertStmt,3,price);
+    int flag = sqlite3_step(insertStmt);
+    sqlite3_reset(insertStmt);
+    if (flag != SQLITE_DONE)
+    {
+        Alert(std::vector<std::string> (1,"Error writing changes to database: " + std::string(sqlite3_errmsg(db))),"error");
+        return -1;
+    }
+    return 0;
+}
+
+// Internal ID of a GeckoID, or -1 if it is not followed
+int Persistence::id(const std::string &geckoID) const
+{
+    auto found = ids.find(geckoID);
+    return found == ids.end() ? -1 : found->second;
+}
+
+// Value of a row of the Settings table, or "fallback" if it isn't defined
+std::string Persistence::setting(const std::string &name, const std::string &fallback)
+{
+    std::string value = fallback;
+    sqlite3_bind_text(settingStmt,1,name.c_str(),name.size(),SQLITE_TRANSIENT);
+    if (sqlite3_step(settingStmt) == SQLITE_ROW)
+    {
+        value = reinterpret_cast<const char*>(sqlite3_column_text(settingStmt,0));
+    }
+    sqlite3_reset(settingStmt);
+    return value;
+}
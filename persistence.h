@@ -0,0 +1,46 @@
+#ifndef persistence_h
+#define persistence_h
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <sqlite3.h>
+
+// Latest row of Configs of every currency in a single query, the thresholds are NULL for the
+// currencies without one. Columns: ID, name, minimumData, timeWindow, gain, longGain, movingAvg, anomaly,
+// decoupling, GeckoID.
+constexpr const char* LatestConfigs = "SELECT Currencies.ID,Currencies.name,minimumData,timeWindow,gain,longGain,movingAvg,anomaly,decoupling,GeckoID FROM Currencies "
+                                      "LEFT JOIN (SELECT CurrencyID AS owner,MAX(alertID) AS latest FROM Configs GROUP BY CurrencyID) ON owner = Currencies.ID "
+                                      "LEFT JOIN Configs ON alertID = latest;";
+
+// Long lived connection to Crypto.db. Statements are prepared once and rebound for every row,
+// and the rows of an API call are written in a single transaction.
+class Persistence
+{
+public:
+    ~Persistence();
+    int open(const char* path);
+    void close();
+    int refresh();
+    int begin();
+    int commit();
+    void rollback();
+    int insert(int id, double time, double price);
+    int id(const std::string &geckoID) const;
+    const std::vector<std::string>& names() const { return geckoIDs; }
+    std::string setting(const std::string &name, const std::string &fallback);
+    sqlite3* handle() { return db; }
+
+private:
+    int migrate();
+
+    sqlite3* db = nullptr;
+    sqlite3_stmt* insertStmt = nullptr;
+    sqlite3_stmt* beginStmt = nullptr;
+    sqlite3_stmt* commitStmt = nullptr;
+    sqlite3_stmt* rollbackStmt = nullptr;
+    sqlite3_stmt* settingStmt = nullptr;
+    std::unordered_map<std::string, int> ids;   // GeckoID -> Currencies.ID
+    std::vector<std::string> geckoIDs;
+};
+
+#endif
@@ -0,0 +1,381 @@
+/** ========================================================================================
+
+    Filename:  pipeline.cpp
+
+    Description:  Runs the stages that follow an API call on their own threads, connected by
+                  bounded lock-free queues (queue.h), so a slow disk or e-mail server never
+                  delays the next price request:
+                    - writer: appends the prices to the storage (storage.cpp), Crypto.db in
+                      one transaction per batch or the binary journal (journal.cpp)
+                    - analytics: pushes them to the PriceStore, updates the metrics and
+                      checks the thresholds, then tells the scheduler the new volatilities.
+                      Now and then, and when it stops, it saves their snapshot (snapshot.cpp)
+                    - alert dispatcher: writes the alerts triggered, or sends them by e-mail
+                      in digests (mailer.cpp)
+                    - compaction: every few minutes moves the old prices into the OHLC
+                      rollups (rollup.cpp)
+                  A full queue refuses the batch instead of blocking the API calls. The depth,
+                  peak depth and refused batches of each queue are reported at shutdown.
+
+                  Settings: "queueCapacity", batches each queue can hold (default 64).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "pipeline.h"
+#include "analytics.h"
+#include "persistence.h"
+#include "scheduler.h"
+#include "mailer.h"
+#include "rollup.h"
+#include "config.h"
+#include "ipc.h"
+#include "metrics.h"
+#include "storage.h"
+#include "trace.h"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+Pipeline::Pipeline(PriceStore &store, Analytics &engine, Scheduler &schedule, size_t capacity)
+    : store(store), engine(engine), schedule(schedule), writes(capacity), analyses(capacity), alerts(capacity)
+{
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+// Start the threads. The store and the engine must be loaded already, from now on only the
+// analytics worker touches them.
+void Pipeline::start(const char* database)
+{
+    path = database;
+    last = store.latest();
+    stopping.store(false);
+    finished.store(false);
+    writeThread = std::thread(&Pipeline::write, this);
+    analyseThread = std::thread(&Pipeline::analyse, this);
+    dispatchThread = std::thread(&Pipeline::dispatch, this);
+    compactThread = std::thread(&Pipeline::compact, this);
+}
+
+// Let every stage drain its queue, then join them
+void Pipeline::stop()
+{
+    if (!dispatchThread.joinable())
+    {
+        return;
+    }
+    stopping.store(true);
+    writer.ring();
+    analyser.ring();
+    compactor.ring();
+    writeThread.join();
+    analyseThread.join();
+    compactThread.join();
+    finished.store(true);
+    dispatcher.ring();
+    dispatchThread.join();
+
+    std::string summary = "Pipeline queues (depth/peak/capacity/refused):";
+    for (const QueueMetrics &queue : metrics())
+    {
+        summary += " " + std::string(queue.name) + " " + std::to_string(queue.depth) + "/" + std::to_string(queue.peak) + "/"
+                 + std::to_string(queue.capacity) + "/" + std::to_string(queue.rejected);
+    }
+    Alert(std::vector<std::string> (1,summary),"local");
+}
+
+// Whether a price differs from the last one published for the currency
+bool Pipeline::changed(int id, double price) const
+{
+    auto found = last.find(id);
+    return found == last.end() || std::abs(price - found->second) >= 0.0000002;
+}
+
+// Hand the prices of an API call to the writer and the analytics worker. Only called by the fetch
+// stage. Returns false, without publishing anything, if either queue is full.
+bool Pipeline::publish(PriceBatch &&batch)
+{
+    if (writes.depth() >= writes.capacity() || analyses.depth() >= analyses.capacity())
+    {
+        return false;
+    }
+    PriceBatch copy = batch;
+    if (!writes.push(std::move(copy)))
+    {
+        return false;
+    }
+    writer.ring();
+    // Before the batch is moved to the analyses, the writer saves these prices in any case
+    for (size_t i = 0; i < batch.ids.size(); i++)
+    {
+        last[batch.ids[i]] = batch.prices[i];
+    }
+    if (!analyses.push(std::move(batch)))
+    {
+        return false;
+    }
+    analyser.ring();
+    return true;
+}
+
+std::vector<QueueMetrics> Pipeline::metrics() const
+{
+    return {{"writes", writes.depth(), writes.peak(), writes.capacity(), writes.rejected()},
+            {"analyses", analyses.depth(), analyses.peak(), analyses.capacity(), analyses.rejected()},
+            {"alerts", alerts.depth(), alerts.peak(), alerts.capacity(), alerts.rejected()}};
+}
+
+// Seconds spent by each stage on every batch, read after stop() when profiling was enabled
+std::vector<StageLatency> Pipeline::latencies() const
+{
+    return {{"write", writeTimes}, {"analyse", analyseTimes}, {"alert", alertTimes}};
+}
+
+static double since(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Writer thread, with its own connection to the database unless another storage was given. A
+// batch that can't be saved is kept and tried again, the next ones wait in the queue meanwhile
+// and publish() refuses the new prices once it is full. Only when stopping it gives up on them.
+void Pipeline::write()
+{
+    SqliteStorage prices;
+    Storage &history = storage != nullptr ? *storage : prices;
+    PriceBatch batch;
+    bool held = false;   // the batch was popped but not saved yet
+    int failures = 0;
+    bool open = history.open(path.c_str()) == 0;
+    tracer.name("writer");
+
+    while (true)
+    {
+        if (!held && !writes.pop(batch))
+        {
+            if (stopping.load())
+            {
+                break;
+            }
+            writer.wait(std::chrono::milliseconds(500));
+            continue;
+        }
+        held = true;
+        Trace span(Write);
+        auto begin = std::chrono::steady_clock::now();
+        if (!open)
+        {
+            open = history.open(path.c_str()) == 0;
+        }
+        if (open && history.append(batch) == 0)
+        {
+            ::metrics.ticks++;  // counters of metrics.cpp, not the queues of metrics()
+            ::metrics.rows += batch.ids.size();
+            ::metrics.lastRows = batch.ids.size();
+            held = false;
+            failures = 0;
+        }
+        else if (++failures >= 3 && stopping.load())
+        {
+            Alert(std::vector<std::string> (1,"The storage is not writable, " + std::to_string(batch.ids.size()) + " prices were not saved"),"error");
+            held = false;   // the next batches only get one try
+        }
+        else
+        {
+            if (failures == 1)
+            {
+                Alert(std::vector<std::string> (1,"Couldn't save " + std::to_string(batch.ids.size()) + " prices, they will be tried again"),"error");
+            }
+            writer.wait(std::chrono::milliseconds(1000));
+        }
+        if (profiling)
+        {
+            writeTimes.push_back(since(begin));
+        }
+    }
+}
+
+// Analytics thread, it reads the thresholds with its own connection before every pass
+void Pipeline::analyse()
+{
+    Persistence db;
+    PriceBatch batch;
+    std::vector<int> fresh;   // currencies of the rows written outside the pipeline
+    ConfigView view(config);
+    int count;
+    auto saved = std::chrono::steady_clock::now();
+    db.open(path.c_str());
+    tracer.name("analytics");
+
+    while (true)
+    {
+        if (!snapshotFile.empty() && since(saved) >= snapshotInterval)
+        {
+            engine.save(snapshotFile);
+            saved = std::chrono::steady_clock::now();
+        }
+        if (!analyses.pop(batch))
+        {
+            if (stopping.load())
+            {
+                break;
+            }
+            analyser.wait(std::chrono::milliseconds(500));
+            continue;
+        }
+        Trace span(Analyse);
+        auto begin = std::chrono::steady_clock::now();
+        if (view.update())
+        {
+            engine.configure(*view); // currencies or thresholds were changed in the GUI
+        }
+        for (size_t i = 0; i < batch.ids.size(); i++)
+        {
+            store.push(batch.ids[i],batch.times[i],batch.prices[i]);
+            engine.add(batch.ids[i]);
+        }
+        // After the batch: the writer may have saved it already, and sync() skips the rows that
+        // are not newer than the last price of their ring
+        if (db.handle() != nullptr)
+        {
+            fresh.clear();
+            store.sync(db.handle(),fresh);
+            for (int id : fresh)
+            {
+                engine.add(id);
+            }
+        }
+
+        auto wall = std::chrono::system_clock::now();
+        AlertBatch result = {engine.run(std::chrono::duration_cast<std::chrono::seconds>(wall.time_since_epoch()).count(), count), batch.mode};
+        schedule.adapt(engine.cvs());
+        ::metrics.analysisSeconds.observe(since(begin));
+        if (observer != nullptr)
+        {
+            observer->publish(batch, engine, result.lines);
+        }
+        if (profiling)
+        {
+            analyseTimes.push_back(since(begin));
+        }
+        if (count == 0)
+        {
+            result.lines.insert(result.lines.begin(), "The Database was updated but is still waiting for data");
+            result.mode = "local";
+        }
+        else if (!ready)
+        {
+            Alert(std::vector<std::string>(1,"There is now enough data for at least 1 currency to perform analyses from now on"),"local");
+            ready = true;
+        }
+        if (!result.lines.empty())
+        {
+            if (alerts.push(std::move(result)))
+            {
+                dispatcher.ring();
+            }
+            else
+            {
+                Alert(std::vector<std::string> (1,"The alert queue is full, " + std::to_string(result.lines.size()) + " alerts were dropped"),"error");
+            }
+        }
+    }
+    if (!snapshotFile.empty())
+    {
+        engine.save(snapshotFile);
+    }
+}
+
+// Alert dispatcher thread. E-mail alerts are collected in digests sent when their flush window
+// ends, or at shutdown, all of them on the SMTP session kept by the mailer.
+void Pipeline::dispatch()
+{
+    Persistence db;
+    Mailer mailer;
+    AlertBatch batch;
+    ConfigView view(config);
+    int account = 1;   // 1 until the account is read, then 0 or -1 if it can't be used
+    db.open(path.c_str());
+    tracer.name("alerts");
+
+    while (true)
+    {
+        if (mailer.due())
+        {
+            mailer.flush();
+        }
+        if (!alerts.pop(batch))
+        {
+            if (finished.load())
+            {
+                break;
+            }
+            std::chrono::milliseconds timeout(500);
+            if (mailer.pending() > 0)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(mailer.deadline() - Mailer::Clock::now());
+                timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, left));
+            }
+            dispatcher.wait(timeout);
+            continue;
+        }
+        Trace span(Dispatch);
+        auto begin = std::chrono::steady_clock::now();
+        if (batch.mode != "mail")
+        {
+            Alert(batch.lines,batch.mode.c_str());
+        }
+        else
+        {
+            if (view.update() || account > 0) // the account may have been changed in the GUI
+            {
+                account = mailer.configure(db, *view) == 0 ? 0 : -1;
+            }
+            if (account == 0)
+            {
+                mailer.add(batch.lines);
+            }
+        }
+        if (profiling)
+        {
+            alertTimes.push_back(since(begin));
+        }
+    }
+    mailer.flush();
+}
+
+// Compaction thread, with its own connection. The first pass runs right away.
+void Pipeline::compact()
+{
+    Persistence db;
+    Compactor rollups;
+    db.open(path.c_str());
+    tracer.name("compaction");
+
+    while (!stopping.load())
+    {
+        if (db.handle() != nullptr)
+        {
+            Trace span(Compact);
+            rollups.configure(db);
+            auto wall = std::chrono::system_clock::now();
+            int moved = rollups.compact(db, std::chrono::duration_cast<std::chrono::seconds>(wall.time_since_epoch()).count());
+            if (moved > 0)
+            {
+                Alert(std::vector<std::string> (1,std::to_string(moved) + " old prices were compacted into the rollups"),"local");
+            }
+        }
+        compactor.wait(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration<double>(rollups.interval())));
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef pipeline_h
+#define pipeline_h
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include "queue.h"
+
+class PriceStore;
+class Analytics;
+class Scheduler;
+class Channel;
+class Storage;
+
+// Prices that changed in one API call
+struct PriceBatch
+{
+    std::vector<int> ids;
+    std::vector<double> times;
+    std::vector<double> prices;
+    std::string mode;   // alert mode when they were fetched
+};
+
+// Alerts produced by one analysis pass
+struct AlertBatch
+{
+    std::vector<std::string> lines;
+    std::string mode;
+};
+
+// Depth metrics of a queue between two stages
+struct QueueMetrics
+{
+    const char* name;
+    size_t depth;
+    size_t peak;
+    size_t capacity;
+    size_t rejected;
+};
+
+// Seconds a stage spent on each batch
+struct StageLatency
+{
+    const char* name;
+    std::vector<double> seconds;
+};
+
+// Stages after the API call, each on its own thread: the writer persists the prices, the analytics
+// worker updates the PriceStore and the metrics, and the alert dispatcher sends what they trigger.
+// A fourth thread compacts the old prices into the rollups now and then.
+// The fetch stage (main thread) publishes batches without ever waiting on them: if a queue is full
+// the batch is refused and the prices are requested again on the next call.
+class Pipeline
+{
+public:
+    Pipeline(PriceStore &store, Analytics &engine, Scheduler &schedule, size_t capacity = 64);
+    ~Pipeline();
+    void start(const char* path);
+    void stop();
+    bool changed(int id, double price) const;
+    bool known(int id) const { return last.count(id) > 0; }  // some price of the currency was published or loaded
+    bool publish(PriceBatch &&batch);
+    std::vector<QueueMetrics> metrics() const;
+    void profile(bool enabled) { profiling = enabled; }
+    void attach(Channel *channel) { observer = channel; }  // before start(), GUI sees prices and alerts live
+    void persist(Storage *backend) { storage = backend; }  // before start(), Prices of the database if not called
+    void snapshot(const std::string &file, double seconds) { snapshotFile = file; snapshotInterval = seconds; }  // before start()
+    std::vector<StageLatency> latencies() const;
+
+private:
+    void write();
+    void analyse();
+    void dispatch();
+    void compact();
+
+    PriceStore &store;
+    Analytics &engine;
+    Scheduler &schedule;
+    std::string path;
+    std::unordered_map<int, double> last;   // last price published for each currency
+    BoundedQueue<PriceBatch> writes;
+    BoundedQueue<PriceBatch> analyses;
+    BoundedQueue<AlertBatch> alerts;
+    Doorbell writer, analyser, dispatcher, compactor;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> finished{false};
+    std::thread writeThread, analyseThread, dispatchThread, compactThread;
+    bool ready = false;   // some currency had enough data, only used by the analytics worker
+    bool profiling = false;                                // set before start()
+    Channel *observer = nullptr;                           // set before start()
+    Storage *storage = nullptr;                            // set before start(), then only used by the writer
+    std::string snapshotFile;                              // set before start(), empty saves none
+    double snapshotInterval = 600;
+    std::vector<double> writeTimes, analyseTimes, alertTimes; // each one only touched by its stage
+};
+
+#endif
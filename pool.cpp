@@ -0,0 +1,152 @@
+/** ========================================================================================
+
+    Filename:  pool.cpp
+
+    Description:  Work stealing thread pool for the analyses. Analytics splits the currencies
+                  in shards and runs one task per shard; with more shards than threads a thread
+                  that finishes its own shards steals the ones left in the queues of the others,
+                  so a slow shard does not keep the rest of the cores waiting.
+
+                  Setting: "analysisThreads", threads of the pool (default 0, every hardware thread).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "pool.h"
+#include "trace.h"
+#include <algorithm>
+
+WorkPool::WorkPool(size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; i++)
+    {
+        queues.emplace_back(new Queue);
+    }
+    for (size_t i = 1; i < threads; i++)
+    {
+        workers.emplace_back(&WorkPool::work, this, i);
+    }
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(state);
+        stopping = true;
+    }
+    started.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+// Run task(0) .. task(count - 1) on every thread and wait for all of them
+void WorkPool::run(size_t count, const std::function<void(size_t)> &task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (workers.empty() || count == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    // The job is set before the tasks, a thread still stealing from the last job may take them
+    {
+        std::lock_guard<std::mutex> lock(state);
+        job = &task;
+    }
+    remaining.store(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        Queue &queue = *queues[i % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.tasks.push_back(i);
+    }
+    {
+        std::lock_guard<std::mutex> lock(state);
+        generation++;
+    }
+    started.notify_all();
+
+    execute(0);
+    std::unique_lock<std::mutex> lock(state);
+    finished.wait(lock, [this] { return remaining.load() == 0; });
+}
+
+// Threads wait for a new job, run tasks until every queue is empty and wait again
+void WorkPool::work(size_t self)
+{
+    tracer.name("analysis");
+    size_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(state);
+            started.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+        }
+        execute(self);
+    }
+}
+
+void WorkPool::execute(size_t self)
+{
+    size_t task;
+    while (take(self, task))
+    {
+        (*job)(task);
+        if (remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(state);
+            finished.notify_all();
+        }
+    }
+}
+
+// Newest task of its own queue, or the oldest one of another queue
+bool WorkPool::take(size_t self, size_t &task)
+{
+    {
+        Queue &own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        Queue &other = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(other.lock);
+        if (!other.tasks.empty())
+        {
+            task = other.tasks.front();
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
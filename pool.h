@@ -0,0 +1,45 @@
+#ifndef pool_h
+#define pool_h
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// Fixed set of threads that run the tasks 0..count-1 of one job at a time. Tasks are dealt
+// round robin to a queue per thread; a thread takes the newest task of its own queue and, when
+// it is empty, steals the oldest one of the others, so uneven tasks still keep every thread busy.
+// The thread calling run() works too and returns when every task is done.
+class WorkPool
+{
+public:
+    explicit WorkPool(size_t threads = 0);  // 0 uses every hardware thread
+    ~WorkPool();
+    size_t size() const { return queues.size(); }
+    void run(size_t count, const std::function<void(size_t)> &task);
+
+private:
+    struct alignas(64) Queue
+    {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+    void work(size_t self);
+    bool take(size_t self, size_t &task);
+    void execute(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues;   // queues[0] belongs to the caller of run()
+    std::vector<std::thread> workers;
+    std::mutex state;                             // job, generation and stopping
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t generation = 0;
+    std::atomic<size_t> remaining{0};
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,370 @@
+/** ========================================================================================
+
+    Filename:  pricestore.cpp
+
+    Description:  In memory time series of the prices of each currency. Every currency owns a
+                  ring buffer sized from its "timeWindow" and the refresh interval, so it holds
+                  about every price the analyses need without reallocating. The store is warmed
+                  up from Crypto.db once at startup; after that, the last price of each
+                  currency is used to detect changes instead of querying the last row of Prices,
+                  and rows written by other programs are read incrementally by PriceID.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "pricestore.h"
+#include "persistence.h"
+#include "storage.h"
+#include "snapshot.h"
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+PriceRing::PriceRing(size_t capacity)
+{
+    size_t size = 16;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    times.resize(size);
+    prices.resize(size);
+    mask = size - 1;
+}
+
+void PriceRing::push(double time, double price)
+{
+    if (count == times.size())
+    {
+        grow();
+    }
+    times[(start + count) & mask] = time;
+    prices[(start + count) & mask] = price;
+    count++;
+    latest = price;
+    newest = time;
+    saved = true;
+}
+
+// Drop every price before the absolute position given
+void PriceRing::discard(size_t position)
+{
+    if (position > end())
+    {
+        position = end();
+    }
+    if (position > start)
+    {
+        count -= position - start;
+        start = position;
+    }
+}
+
+// Prices of the positions [from, to) as at most two contiguous spans, for the kernels
+Window PriceRing::window(size_t from, size_t to) const
+{
+    Window spans;
+    size_t offset = from & mask;
+    size_t head = std::min(to - from, times.size() - offset);
+    spans.first = {prices.data() + offset, head};
+    spans.second = {prices.data(), to - from - head};
+    return spans;
+}
+
+// Capacity, positions and the prices held, in the order of their positions (snapshot.cpp)
+void PriceRing::save(SnapshotWriter &out) const
+{
+    size_t offset = start & mask;
+    size_t head = std::min(count, times.size() - offset);
+    out.put(static_cast<uint64_t>(times.size()));
+    out.put(static_cast<uint64_t>(start));
+    out.put(static_cast<uint64_t>(count));
+    out.put(latest);
+    out.put(newest);
+    out.put(saved);
+    out.put(times.data() + offset, head*sizeof(double));
+    out.put(times.data(), (count - head)*sizeof(double));
+    out.put(prices.data() + offset, head*sizeof(double));
+    out.put(prices.data(), (count - head)*sizeof(double));
+}
+
+bool PriceRing::restore(SnapshotReader &in)
+{
+    uint64_t size, first, held;
+    if (!in.get(size) || !in.get(first) || !in.get(held) || size < 16 || (size & (size - 1)) != 0 || held > size
+        || !in.get(latest) || !in.get(newest) || !in.get(saved))
+    {
+        return false;
+    }
+    times.assign(size, 0);
+    prices.assign(size, 0);
+    mask = size - 1;
+    start = first;
+    count = held;
+    size_t offset = start & mask;
+    size_t head = std::min(count, times.size() - offset);
+    return in.get(times.data() + offset, head*sizeof(double)) && in.get(times.data(), (count - head)*sizeof(double))
+           && in.get(prices.data() + offset, head*sizeof(double)) && in.get(prices.data(), (count - head)*sizeof(double));
+}
+
+// Only happens if a currency gets more prices in its window than expected from the refresh interval
+void PriceRing::grow()
+{
+    std::vector<double> newTimes(2*times.size());
+    std::vector<double> newPrices(2*prices.size());
+    size_t newMask = newTimes.size() - 1;
+    for (size_t i = start; i < end(); i++)
+    {
+        newTimes[i & newMask] = time(i);
+        newPrices[i & newMask] = price(i);
+    }
+    times.swap(newTimes);
+    prices.swap(newPrices);
+    mask = newMask;
+}
+
+// Read the refresh interval, the time window of each currency and its prices inside it. The part
+// of the window already compacted (rollup.cpp) is read from the closes of the minute buckets, or
+// of the hour buckets past the retention of the minutes. The last price of each currency is
+// always read to detect changes, even if it is older. Every read is a range of the index
+// PricesByCurrency (persistence.cpp), never a scan of Prices. Another storage adds what it holds
+// after the prices of Crypto.db (storage.cpp). The rings restored from a snapshot are not read
+// again, they only receive the prices saved after it: the rows of Prices after its PriceID, read
+// by sync(), or the end of the other storage.
+int PriceStore::load(sqlite3 *db, Storage *history)
+{
+    const char* modeQuery = "SELECT updateFreq FROM Mode ORDER BY key DESC LIMIT 1;";
+    const char* compactedQuery = "SELECT CAST(value AS REAL) FROM Settings WHERE name = 'compactedUntil';";
+    const char* rollupQuery = "SELECT bucket,close FROM PricesHour WHERE CurrencyID = ?1 AND bucket >= ?2 AND bucket < ?3 "
+                              "AND bucket + 3600 <= (SELECT COALESCE(MIN(bucket),?3) FROM PricesMinute WHERE CurrencyID = ?1) "
+                              "UNION ALL SELECT bucket,close FROM PricesMinute WHERE CurrencyID = ?1 AND bucket >= ?2 AND bucket < ?3 ORDER BY 1;";
+    const char* markQuery = "SELECT COALESCE(MAX(PriceID),0) FROM Prices;";
+    const char* priceQuery = "SELECT time,price FROM Prices WHERE CurrencyID = ?1 AND time >= (SELECT MIN(MAX(time),?2) FROM Prices WHERE CurrencyID = ?1) ORDER BY time;";
+    sqlite3_stmt* mode = nullptr;
+    sqlite3_stmt* windows = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_stmt* compacted = nullptr;
+    sqlite3_stmt* rollups = nullptr;
+    sqlite3_stmt* highest = nullptr;
+    double until = 0;
+    double now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    if (sqlite3_prepare_v2(db,modeQuery,-1,&mode,nullptr) != SQLITE_OK || sqlite3_prepare_v2(db,LatestConfigs,-1,&windows,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,priceQuery,-1,&stmt,nullptr) != SQLITE_OK || sqlite3_prepare_v2(db,compactedQuery,-1,&compacted,nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db,rollupQuery,-1,&rollups,nullptr) != SQLITE_OK || sqlite3_prepare_v2(db,markQuery,-1,&highest,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error reading prices into memory: " + std::string(sqlite3_errmsg(db))),"error");
+        sqlite3_finalize(mode);
+        sqlite3_finalize(windows);
+        sqlite3_finalize(stmt);
+        sqlite3_finalize(compacted);
+        sqlite3_finalize(rollups);
+        sqlite3_finalize(highest);
+        return -1;
+    }
+    // Rows inserted while the windows are read are seen again by sync() and skipped by time
+    bool restored = mark >= 0;
+    if (!restored && sqlite3_step(highest) == SQLITE_ROW)
+    {
+        mark = sqlite3_column_int64(highest,0);
+    }
+    if (sqlite3_step(mode) == SQLITE_ROW && sqlite3_column_double(mode,0) > 0)
+    {
+        refresh = sqlite3_column_double(mode,0);
+    }
+    if (sqlite3_step(compacted) == SQLITE_ROW)
+    {
+        until = sqlite3_column_double(compacted,0);
+    }
+    while (sqlite3_step(windows) == SQLITE_ROW)
+    {
+        int id = sqlite3_column_int(windows,0);
+        double timeWindow = sqlite3_column_type(windows,3) == SQLITE_NULL ? 5 : sqlite3_column_double(windows,3);
+        auto found = rings.find(id);
+        if (restored && found != rings.end())
+        {
+            if (history != nullptr)
+            {
+                history->replay(id, found->second.seen() ? found->second.lastTime() : now - 3600*timeWindow, found->second);
+            }
+            continue;
+        }
+        PriceRing &prices = ring(id, timeWindow);
+
+        if (now - 3600*timeWindow < until)
+        {
+            sqlite3_bind_int(rollups,1,id);
+            sqlite3_bind_double(rollups,2,now - 3600*timeWindow);
+            sqlite3_bind_double(rollups,3,until);
+            while (sqlite3_step(rollups) == SQLITE_ROW)
+            {
+                prices.push(sqlite3_column_double(rollups,0),sqlite3_column_double(rollups,1));
+            }
+            sqlite3_reset(rollups);
+        }
+        sqlite3_bind_int(stmt,1,id);
+        sqlite3_bind_double(stmt,2,now - 3600*timeWindow);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            prices.push(sqlite3_column_double(stmt,0),sqlite3_column_double(stmt,1));
+        }
+        sqlite3_reset(stmt);
+        if (history != nullptr)
+        {
+            history->replay(id, now - 3600*timeWindow, prices);
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(windows);
+    sqlite3_finalize(mode);
+    sqlite3_finalize(compacted);
+    sqlite3_finalize(rollups);
+    sqlite3_finalize(highest);
+    std::vector<int> pushed;
+    return restored && sync(db, pushed) < 0 ? -1 : 0;
+}
+
+// Push the rows of Prices after the highest PriceID read, newer than the last price of their
+// ring, and append their currencies to "pushed". Rows the pipeline already pushed are skipped
+// by time. Returns the number of prices pushed or -1 with errors.
+int PriceStore::sync(sqlite3 *db, std::vector<int> &pushed)
+{
+    const char* markQuery = "SELECT COALESCE(MAX(PriceID),0) FROM Prices;";
+    const char* rowQuery = "SELECT PriceID,CurrencyID,time,price FROM Prices WHERE PriceID > ?1 ORDER BY PriceID;";
+    sqlite3_stmt* stmt = nullptr;
+    int count = 0;
+
+    // Without load() the store starts from the rows written from now on
+    if (sqlite3_prepare_v2(db,mark < 0 ? markQuery : rowQuery,-1,&stmt,nullptr) != SQLITE_OK)
+    {
+        Alert(std::vector<std::string> (1,"Error reading new prices into memory: " + std::string(sqlite3_errmsg(db))),"error");
+        return -1;
+    }
+    if (mark < 0)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            mark = sqlite3_column_int64(stmt,0);
+        }
+        sqlite3_finalize(stmt);
+        return 0;
+    }
+    sqlite3_bind_int64(stmt,1,mark);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        mark = sqlite3_column_int64(stmt,0);
+        auto found = rings.find(sqlite3_column_int(stmt,1));
+        double time = sqlite3_column_double(stmt,2);
+        if (found != rings.end() && (!found->second.seen() || time > found->second.lastTime()))
+        {
+            found->second.push(time,sqlite3_column_double(stmt,3));
+            pushed.push_back(found->first);
+            count++;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+// Rings of every currency with the highest PriceID read, for the next restore()
+void PriceStore::save(SnapshotWriter &out) const
+{
+    out.put(static_cast<double>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+    out.put(mark);
+    out.put(refresh);
+    out.put(static_cast<uint64_t>(rings.size()));
+    for (const auto &entry : rings)
+    {
+        out.put(entry.first);
+        entry.second.save(out);
+    }
+}
+
+// Rings of a snapshot, before load(). It is refused if Crypto.db doesn't have its rows anymore:
+// the database was replaced, or rows saved after it were already compacted into the rollups.
+// Returns 0, or -1 with the store left empty.
+int PriceStore::restore(SnapshotReader &in, sqlite3 *db)
+{
+    const char* checkQuery = "SELECT (SELECT COALESCE(MAX(PriceID),0) FROM Prices),"
+                             "(SELECT COALESCE(CAST(value AS REAL),0) FROM Settings WHERE name = 'compactedUntil');";
+    sqlite3_stmt* stmt = nullptr;
+    double time = 0;
+    uint64_t count = 0;
+    clear();
+    if (!in.get(time) || !in.get(mark) || !in.get(refresh) || !in.get(count) || mark < 0)
+    {
+        clear();
+        return -1;
+    }
+    if (sqlite3_prepare_v2(db,checkQuery,-1,&stmt,nullptr) != SQLITE_OK || sqlite3_step(stmt) != SQLITE_ROW
+        || sqlite3_column_int64(stmt,0) < mark || sqlite3_column_double(stmt,1) > time)
+    {
+        Alert(std::vector<std::string> (1,"The snapshot doesn't match the prices of Crypto.db, they are read again"),"local");
+        sqlite3_finalize(stmt);
+        clear();
+        return -1;
+    }
+    sqlite3_finalize(stmt);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        int id;
+        PriceRing prices;
+        if (!in.get(id) || !prices.restore(in))
+        {
+            clear();
+            return -1;
+        }
+        rings.emplace(id, std::move(prices));
+    }
+    return 0;
+}
+
+void PriceStore::clear()
+{
+    rings.clear();
+    refresh = 1;
+    mark = -1;
+}
+
+// Ring of a currency, created with room for the prices expected in its time window
+PriceRing& PriceStore::ring(int id, double timeWindow)
+{
+    auto found = rings.find(id);
+    if (found != rings.end())
+    {
+        return found->second;
+    }
+    size_t expected = static_cast<size_t>(std::ceil(60*timeWindow/refresh)) + 1;
+    return rings.emplace(id, PriceRing(expected)).first->second;
+}
+
+// Last price saved for each currency, to detect changes in the prices received
+std::unordered_map<int, double> PriceStore::latest() const
+{
+    std::unordered_map<int, double> prices;
+    for (const auto &entry : rings)
+    {
+        if (entry.second.seen())
+        {
+            prices[entry.first] = entry.second.last();
+        }
+    }
+    return prices;
+}
+
+void PriceStore::push(int id, double time, double price)
+{
+    ring(id).push(time, price);
+}
+
+void PriceStore::erase(int id)
+{
+    rings.erase(id);
+}
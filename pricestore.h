@@ -0,0 +1,72 @@
+#ifndef pricestore_h
+#define pricestore_h
+#include <vector>
+#include <unordered_map>
+#include <sqlite3.h>
+#include "kernels.h"
+
+class Storage;
+class SnapshotWriter;
+class SnapshotReader;
+
+// Ring buffer of (time, price) for a single currency, in struct of arrays layout. Prices are
+// addressed by an absolute position that keeps increasing, so positions stay valid when the
+// oldest prices are discarded or the buffer grows.
+class PriceRing
+{
+public:
+    explicit PriceRing(size_t capacity = 16);
+    void push(double time, double price);
+    void discard(size_t position);
+    size_t first() const { return start; }
+    size_t end() const { return start + count; }
+    size_t size() const { return count; }
+    size_t capacity() const { return times.size(); }
+    double time(size_t position) const { return times[position & mask]; }
+    double price(size_t position) const { return prices[position & mask]; }
+    bool seen() const { return saved; }
+    double last() const { return latest; }
+    double lastTime() const { return newest; }
+    Window window(size_t from, size_t to) const;
+    void save(SnapshotWriter &out) const;
+    bool restore(SnapshotReader &in);
+
+private:
+    void grow();
+
+    std::vector<double> times;
+    std::vector<double> prices;
+    size_t mask;
+    size_t start = 0;
+    size_t count = 0;
+    double latest = 0;   // last price saved, kept even after it is discarded
+    double newest = 0;   // and its time
+    bool saved = false;
+};
+
+// Resident copy of the recent prices of every currency, keyed by Currencies.ID. It is read from
+// SQLite once at startup and from then on it is the source of truth for update() and the analyses,
+// while the database only receives new rows. Only the analytics worker uses it once the pipeline runs.
+// Rows written to Prices by anything else than the pipeline are picked up by sync(), which only
+// reads the rows after the highest PriceID seen. restore() takes the rings of a snapshot instead,
+// then load() only reads the windows of the other currencies and the rows saved after it.
+class PriceStore
+{
+public:
+    int load(sqlite3 *db, Storage *history = nullptr);
+    int sync(sqlite3 *db, std::vector<int> &pushed);
+    void save(SnapshotWriter &out) const;
+    int restore(SnapshotReader &in, sqlite3 *db);
+    void clear();
+    PriceRing& ring(int id, double timeWindow = 5);
+    std::unordered_map<int, double> latest() const;
+    void push(int id, double time, double price);
+    void erase(int id);
+
+private:
+    std::unordered_map<int, PriceRing> rings;
+    double refresh = 1;  // minutes between API calls, from Mode
+    long long mark = -1; // highest PriceID read, -1 until it is known
+};
+
+#endif
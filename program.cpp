@@ -3,9 +3,22 @@
     Filename:  program.cpp
     
     Description:  This is the main program that controls the flow of execution. While the GUI
-                  is open, the API will be called (program.cpp) after the time defined by the 
-                  user has passed. If the database gets updated, calls the python analysis
-                  program. Finally, SendAlerts.cpp handles the action to be taken. 
+                  is open, the API will be called (program.cpp) when the scheduler
+                  (scheduler.cpp) finds currencies due, based on the time defined by the
+                  user. New prices go through the pipeline (pipeline.cpp), whose threads save
+                  them, run the analyses kept in process by analytics.cpp and hand the alerts
+                  to SendAlerts.cpp, which handles the action to be taken. The GUI sends its
+                  changes and follows the prices through the socket of ipc.cpp.
+
+                  With --headless the GUI isn't started and the program runs until SIGTERM or
+                  SIGINT, then saves, analyses and sends what is still queued. In both modes
+                  metrics.cpp serves the counters of the stages to Prometheus. With --export it
+                  only copies the prices of the binary journal (journal.cpp) into Crypto.db, and
+                  with --backtest it replays the stored prices with a grid of thresholds
+                  (backtest.cpp) and reports the alerts each combination would have sent.
+                  At startup the analyses resume from their last snapshot (snapshot.cpp).
+                  When tracing is on, the spans of every stage (trace.cpp) are written as a
+                  Chrome trace at the end.
 
     Version:  1.0 Changes:
     Created:  01/30/2025
@@ -17,108 +30,355 @@
 */
 
 #include "headers.h"
+#include "analytics.h"
+#include "persistence.h"
+#include "fetch.h"
+#include "scheduler.h"
+#include "pipeline.h"
+#include "logger.h"
+#include "config.h"
+#include "ipc.h"
+#include "metrics.h"
+#include "journal.h"
+#include "backtest.h"
+#include "trace.h"
 #include <sqlite3.h>
 #include <iostream>
 #include <thread>
-#include <future>
+#include <functional>
 #include <atomic>
-#include <cstdio>
-#include <memory>
 #include <vector>
-#include <array>
 #include <cstdlib>
 #include <chrono>
 #include <cstring>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <csignal>
+#include <cerrno>
+#include <unistd.h>
 
-// Atomic flag to indicate if the GUI is still running
-std::atomic<bool> isGuiRunning(true);
+// Atomic flag cleared when the GUI is closed or a SIGTERM/SIGINT arrives
+std::atomic<bool> isRunning(true);
+static int signals[2] = {-1, -1};  // self pipe written by the signal handler
+
+// Function to run the Python GUI, wakes up the main loop when it is closed. The GUI finds the
+// socket of the core (ipc.cpp) in CRYPTO_SOCKET.
+void runPythonGUI(Scheduler &schedule) {
+    system("python3 GUI.py");
+    isRunning.store(false); 
+    schedule.notify();
+}
 
-// Function to run a Python script and capture its output in real-time
-std::vector<std::string> Analyze(const std::string &command) {
-    std::array<char, 256> buffer;
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
+// Only async-signal-safe calls are allowed here, watchSignals() does the rest
+extern "C" void onSignal(int)
+{
+    char byte = 1;
+    if (write(signals[1], &byte, 1) < 0)
+    {
+        // the pipe is full, the watcher is already waking up
+    }
+}
 
-    if (!pipe) {
-        return std::vector<std::string> (1,"Error: Failed to start python process");
+// Stops the main loop on SIGTERM or SIGINT, or when the pipe is written at the end of the run
+void watchSignals(Scheduler &schedule)
+{
+    char byte;
+    while (read(signals[0], &byte, 1) < 0 && errno == EINTR)
+    {
     }
-    std::vector<std::string> output;
-    // Read and print output line by line
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        output.push_back( buffer.data() );
-        // Check if the GUI is no longer running and stop the task
-        if (!isGuiRunning.load()) {
-            return output;
+    isRunning.store(false);
+    schedule.notify();
+}
+
+// Journal of the prices with the settings of Crypto.db (journal.cpp), nullptr if it cannot be used
+static std::unique_ptr<Journal> openJournal(Persistence &db)
+{
+    double interval = 60;
+    try
+    {
+        interval = std::max(1.0, std::stod(db.setting("journalCheckpoint", std::to_string(interval))));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid journalCheckpoint setting, using 60"), "error");
+    }
+    std::unique_ptr<Journal> journal(new Journal(db.setting("journalDirectory", "journal"), interval));
+    if (journal->open("Crypto.db") != 0)
+    {
+        return nullptr;
+    }
+    return journal;
+}
+
+// --export: copy the prices of the journal that Prices does not have into Crypto.db
+static int exportJournal()
+{
+    Persistence db;
+    if (db.open("Crypto.db") != 0)
+    {
+        return 1;
+    }
+    std::unique_ptr<Journal> journal = openJournal(db);
+    long long rows = journal ? journal->exportPrices(db) : -1;
+    if (rows < 0)
+    {
+        return 1;
+    }
+    std::cout << "Exported " << rows << " prices from the journal to Crypto.db" << std::endl;
+    return 0;
+}
+
+// How the alert rules re-arm after they fire (rules.cpp), from the alertHysteresis and
+// alertCooldown settings
+static Hysteresis rearming(Persistence &db)
+{
+    Hysteresis rearm;
+    try
+    {
+        rearm.band = std::stod(db.setting("alertHysteresis", "0.1"));
+        rearm.cooldown = 60*std::stod(db.setting("alertCooldown", "0"));
+        if (rearm.band < 0 || rearm.cooldown < 0)
+        {
+            throw std::invalid_argument("hysteresis");
         }
     }
-    return output;
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid alertHysteresis or alertCooldown setting, using 0.1 and 0 minutes"), "error");
+        rearm = Hysteresis();
+    }
+    return rearm;
 }
 
-// Function to run the Python GUI
-void runPythonGUI() {
-    system("python3 GUI.py");
-    isGuiRunning.store(false); 
+// --backtest: replay the stored prices with every combination of the thresholds given, see backtest.cpp
+static int backtestThresholds(const std::vector<std::string> &arguments)
+{
+    Persistence db;
+    Grid grid;
+    int threads = 0;
+    if (grid.parse(arguments) != 0 || db.open("Crypto.db") != 0)
+    {
+        return 1;
+    }
+    try
+    {
+        threads = std::max(0, std::stoi(db.setting("analysisThreads", "0")));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid analysisThreads setting, using every hardware thread"), "error");
+    }
+    std::unique_ptr<Journal> journal = db.setting("storage", "sqlite") == "journal" ? openJournal(db) : nullptr;
+    return backtest(db, journal.get(), grid, rearming(db), threads, std::cout) == 0 ? 0 : 1;
 }
 
-int main() {
-    int updates;
-    int count = 0;
-    int count2 = 0;
-    std::thread guiThread(runPythonGUI);
+int main(int argc, char* argv[]) {
+    bool headless = argc == 2 && std::strcmp(argv[1], "--headless") == 0;
+    bool exporting = argc == 2 && std::strcmp(argv[1], "--export") == 0;
+    bool backtesting = argc >= 2 && std::strcmp(argv[1], "--backtest") == 0;
+    if (argc > 1 && !headless && !exporting && !backtesting)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--headless | --export | --backtest [days=N] [threshold=value,value,...]...]" << std::endl;
+        return 1;
+    }
+    if (exporting)
+    {
+        return exportJournal();
+    }
+    if (backtesting)
+    {
+        return backtestThresholds(std::vector<std::string>(argv + 2, argv + argc));
+    }
+
+    Persistence db;
+    Fetcher api;
+    Scheduler schedule;
+    PriceStore store;
+    Analytics engine(store);
+    Channel channel(schedule);
     //std::thread outputThread;
 
-    const std::string Check = "SELECT * FROM Mode ORDER BY key DESC LIMIT 1;";
-    std::string mode = "local";
-    double timing = 60;
-    std::vector<std::string> alerts;
+    size_t capacity = 64;
+    int port = 9464;
+    std::string socket = "crypto.sock";
+    std::unique_ptr<Storage> history;   // nullptr keeps the prices in Crypto.db
+    std::string snapshot = "analytics.snap";
+    double snapshotMinutes = 10;
 
-    // Main loop to keep running while the GUI is open
-    auto before = std::chrono::steady_clock::now();
-    while (isGuiRunning.load()) {
-        sqlite3* db;
-        if (sqlite3_open("Crypto.db",&db) != SQLITE_OK)
+    // Prices in the time window of each currency are read once, then kept up to date by the pipeline
+    if (db.open("Crypto.db") == 0)
+    {
+        logger.configure(db);
+        tracer.configure(db);
+        std::string backend = db.setting("storage", "sqlite");
+        if (backend == "journal")
         {
-            Alert(std::vector<std::string> (1,sqlite3_errmsg(db)), "error");
+            history = openJournal(db);
         }
-        sqlite3_stmt* chck;
-        if (sqlite3_prepare_v2(db,Check.c_str(),-1,&chck,nullptr) == SQLITE_OK)
+        else if (backend != "sqlite")
         {
-            if (sqlite3_step(chck) == SQLITE_ROW)
+            Alert(std::vector<std::string> (1,"Invalid storage setting, using sqlite"), "error");
+        }
+        snapshot = db.setting("snapshotFile", snapshot);
+        try
+        {
+            snapshotMinutes = std::stod(db.setting("snapshotMinutes", "10"));
+        }
+        catch (const std::exception &)
+        {
+            Alert(std::vector<std::string> (1,"Invalid snapshotMinutes setting, using 10"), "error");
+        }
+        // Currencies every currency is compared with to detect decoupling, "all" for the market
+        std::vector<std::string> references;
+        std::string list = db.setting("correlationReferences", "bitcoin");
+        for (size_t begin = 0, comma = 0; comma != std::string::npos; begin = comma + 1)
+        {
+            comma = list.find(',', begin);
+            std::string reference = list.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+            reference.erase(0, reference.find_first_not_of(' '));
+            reference.erase(reference.find_last_not_of(' ') + 1);
+            if (!reference.empty())
             {
-                timing = 60*sqlite3_column_double(chck,1);
-                mode = reinterpret_cast<const char*>(sqlite3_column_text(chck,2));
+                references.push_back(reference);
             }
         }
-        else
+        size_t samples = 48;
+        double minutes = 5;
+        try
         {
-            Alert(std::vector<std::string> (1,sqlite3_errmsg(db)), "error");
-        }
-        sqlite3_finalize(chck);
-        sqlite3_close(db);
-        auto now = std::chrono::steady_clock::now();
-        std::chrono::duration<double> elapsed = now - before;
-        if (elapsed.count() >= timing || count == 0)
-        {   
-            count = 1;
-            updates = database();
-            if(updates > 0)
+            samples = std::stoul(db.setting("correlationSamples", "48"));
+            minutes = std::stod(db.setting("correlationMinutes", "5"));
+            if (samples < 4 || minutes <= 0)
             {
-                std::future<std::vector<std::string>> output = std::async(std::launch::async, Analyze, "python3 Analysis.py");
-                std::vector<std::string> result = output.get();
-                if ( strcmp(result[0].c_str(),".\n") == 0 && count2 == 0)
-                {
-                    Alert(std::vector<std::string>(1,"There is now enough data for at least 1 currency to perform analyses from now on"),"local");
-                    count2 = 1;
-                }
-                Alert(result,mode.c_str());
+                throw std::invalid_argument("correlation window");
             }
-            before = now;
+        }
+        catch (const std::exception &)
+        {
+            Alert(std::vector<std::string> (1,"Invalid correlationSamples or correlationMinutes setting, using 48 samples every 5 minutes"), "error");
+            samples = 48;
+            minutes = 5;
+        }
+        engine.correlate(references, samples, minutes);
+        engine.hysteresis(rearming(db));
+
+        // The state of the last snapshot is mapped back, then only the prices saved after it are read
+        auto begin = std::chrono::steady_clock::now();
+        bool configured = config.refresh(db) >= 0;
+        bool restored = configured && !snapshot.empty() && engine.restore(snapshot, *config.get(), db.handle()) == 0;
+        if (!configured || store.load(db.handle(), history.get()) != 0)
+        {
+            Alert(std::vector<std::string> (1,"Error loading prices for the analyses: " + std::string(sqlite3_errmsg(db.handle()))), "error");
+        }
+        engine.configure(*config.get());
+        if (restored)
+        {
+            Alert(std::vector<std::string> (1,"The analyses were restored from " + snapshot + " in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count()) + " ms"), "local");
+        }
+        try
+        {
+            capacity = std::max(1, std::stoi(db.setting("queueCapacity", std::to_string(capacity))));
+        }
+        catch (const std::exception &)
+        {
+            Alert(std::vector<std::string> (1,"Invalid queueCapacity setting, using " + std::to_string(capacity)), "error");
+        }
+        try
+        {
+            engine.parallel(std::max(0, std::stoi(db.setting("analysisThreads", "0"))));
+        }
+        catch (const std::exception &)
+        {
+            Alert(std::vector<std::string> (1,"Invalid analysisThreads setting, using every hardware thread"), "error");
+        }
+        try
+        {
+            port = std::stoi(db.setting("metricsPort", std::to_string(port)));
+        }
+        catch (const std::exception &)
+        {
+            Alert(std::vector<std::string> (1,"Invalid metricsPort setting, using " + std::to_string(port)), "error");
+        }
+        socket = db.setting("ipcSocket", socket);
+    }
+    Pipeline pipeline(store, engine, schedule, capacity);
+    pipeline.persist(history.get());
+    pipeline.snapshot(snapshot, 60*std::max(1.0, snapshotMinutes));
+    if (!socket.empty() && channel.start(socket, "Crypto.db") == 0)
+    {
+        pipeline.attach(&channel);
+        setenv("CRYPTO_SOCKET", socket.c_str(), 1);
+    }
+    pipeline.start("Crypto.db");
+    Exporter exporter(pipeline);
+    if (port > 0)
+    {
+        exporter.start(port, "Crypto.db");
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;
+    std::thread watcher;
+    if (pipe(signals) == 0)
+    {
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+        watcher = std::thread(watchSignals, std::ref(schedule));
+    }
+    std::thread guiThread;
+    if (headless)
+    {
+        Alert(std::vector<std::string> (1,"Running headless, stop with SIGTERM"),"local");
+    }
+    else
+    {
+        guiThread = std::thread(runPythonGUI, std::ref(schedule));
+    }
+    ConfigView view(config);
+
+    // Main loop to keep running while the GUI is open or until a signal arrives when headless. The
+    // first call happens right away since every currency starts due, then it sleeps until the
+    // scheduler has currencies to request.
+    while (isRunning.load()) {
+        if (db.handle() == nullptr && db.open("Crypto.db") != 0)
+        {
+            db.close();
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+            continue;
+        }
+        // Mode, Configs and Currencies are only read again after the GUI saved changes, which
+        // may also have been published by the GUI socket. If they can't be read the currencies due
+        // stay due, so the next try waits 5 seconds instead of spinning.
+        if (config.refresh(db) >= 0 && (!view.update() || db.refresh() == 0))
+        {
+            schedule.configure(db,view->updateFreq);
+            database(db,api,schedule,pipeline,view->mode);
+        }
+        else
+        {
+            schedule.postpone(5);
         }
 
-        std::this_thread::sleep_for(std::chrono::seconds(5));  // Sleep to prevent busy-wait
+        schedule.wait(isRunning);  // Sleep until the next currency is due
     }
 
+    pipeline.stop();  // Save and analyse what is still queued
+    channel.stop();
+    exporter.stop();
+    tracer.stop();    // Trace file and p50/p99 of every stage, if tracing was on
     Alert(std::vector<std::string> (1,""),"kill");
-    guiThread.join();  // Wait for the GUI thread to finish
+    if (watcher.joinable())
+    {
+        onSignal(0);
+        watcher.join();
+    }
+    if (guiThread.joinable())
+    {
+        guiThread.join();  // Wait for the GUI thread to finish
+    }
 
 
     return 0;
@@ -0,0 +1,359 @@
+/** ========================================================================================
+
+    Filename:  quantiles.cpp
+
+    Description:  Order statistics of the prices in the time window of a currency, for the
+                  percentile anomaly test. anomaly() in Analysis.py sorts the whole window with
+                  describe() twice per currency on every run; here every price is inserted and
+                  evicted once in O(log n) and the two percentiles of "anomaly" are markers that
+                  move at most a couple of steps per change, so the check of a new price costs
+                  the same whatever the length of the window.
+
+                  The skip list is indexable: every link stores how many prices it skips, which
+                  gives the rank of any price on the way down.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "quantiles.h"
+#include "snapshot.h"
+#include <cmath>
+#include <algorithm>
+
+SlidingQuantiles::SlidingQuantiles()
+{
+    nodes.push_back({0, 0, 0, 0, MaxLevel});
+    next.assign(MaxLevel, -1);
+    width.assign(MaxLevel, 0);
+    free.resize(MaxLevel + 1);
+}
+
+// Forget every price but keep the memory, and the markers
+void SlidingQuantiles::clear()
+{
+    nodes.resize(1);
+    next.assign(MaxLevel, -1);
+    width.assign(MaxLevel, 0);
+    for (std::vector<int> &unused : free)
+    {
+        unused.clear();
+    }
+    for (Marker &marker : markers)
+    {
+        marker.node = 0;
+        marker.rank = 0;
+    }
+    count = 0;
+    levels = 1;
+}
+
+bool SlidingQuantiles::less(int node, double price, size_t position) const
+{
+    return nodes[node].price < price || (nodes[node].price == price && nodes[node].position < position);
+}
+
+// Last node before the key at each level and its rank (1 based, the head is 0). Returns the first
+// node that is not before the key, or -1.
+int SlidingQuantiles::find(double price, size_t position, int update[], size_t rank[]) const
+{
+    int node = 0;
+    size_t traversed = 0;
+    for (int level = levels - 1; level >= 0; level--)
+    {
+        int link = nodes[node].links + level;
+        while (next[link] != -1 && less(next[link], price, position))
+        {
+            traversed += width[link];
+            node = next[link];
+            link = nodes[node].links + level;
+        }
+        update[level] = node;
+        rank[level] = traversed;
+    }
+    return next[nodes[node].links];
+}
+
+int SlidingQuantiles::allocate(int height)
+{
+    if (!free[height].empty())
+    {
+        int node = free[height].back();
+        free[height].pop_back();
+        return node;
+    }
+    nodes.push_back({0, 0, 0, static_cast<int>(next.size()), height});
+    next.resize(next.size() + height, -1);
+    width.resize(width.size() + height, 0);
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+// One more level with probability 1/4, from a xorshift generator
+int SlidingQuantiles::randomHeight()
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    uint64_t bits = state;
+    int height = 1;
+    while (height < MaxLevel && (bits & 3) == 0)
+    {
+        height++;
+        bits >>= 2;
+    }
+    return height;
+}
+
+void SlidingQuantiles::insert(double price, size_t position)
+{
+    int update[MaxLevel];
+    size_t rank[MaxLevel];
+    find(price, position, update, rank);
+
+    int height = randomHeight();
+    for (int level = levels; level < height; level++)
+    {
+        update[level] = 0;
+        rank[level] = 0;
+        width[level] = static_cast<int>(count);   // links of the head that were not used
+    }
+    levels = std::max(levels, height);
+
+    int created = allocate(height);
+    nodes[created].price = price;
+    nodes[created].position = position;
+    nodes[created].prev = update[0];
+    for (int level = 0; level < height; level++)
+    {
+        int from = nodes[update[level]].links + level;
+        int to = nodes[created].links + level;
+        next[to] = next[from];
+        width[to] = width[from] - static_cast<int>(rank[0] - rank[level]);
+        next[from] = created;
+        width[from] = static_cast<int>(rank[0] - rank[level]) + 1;
+    }
+    for (int level = height; level < levels; level++)
+    {
+        width[nodes[update[level]].links + level]++;
+    }
+    int after = next[nodes[created].links];
+    if (after != -1)
+    {
+        nodes[after].prev = created;
+    }
+    count++;
+
+    for (Marker &marker : markers)
+    {
+        if (count == 1)
+        {
+            marker.node = created;
+            marker.rank = 0;
+        }
+        else if (rank[0] <= marker.rank)
+        {
+            marker.rank++;
+        }
+        settle(marker);
+    }
+}
+
+// Remove a price inserted before, nothing happens if it is not there
+void SlidingQuantiles::erase(double price, size_t position)
+{
+    int update[MaxLevel];
+    size_t rank[MaxLevel];
+    int erased = find(price, position, update, rank);
+    if (erased == -1 || nodes[erased].price != price || nodes[erased].position != position)
+    {
+        return;
+    }
+
+    int after = next[nodes[erased].links];
+    for (Marker &marker : markers)
+    {
+        if (marker.node == erased)
+        {
+            // The next price takes its rank, or the previous one if it was the last
+            if (after != -1)
+            {
+                marker.node = after;
+            }
+            else
+            {
+                marker.node = nodes[erased].prev;
+                marker.rank -= marker.rank > 0;
+            }
+        }
+        else if (rank[0] < marker.rank)
+        {
+            marker.rank--;
+        }
+    }
+
+    for (int level = 0; level < levels; level++)
+    {
+        int from = nodes[update[level]].links + level;
+        if (next[from] == erased)
+        {
+            width[from] += width[nodes[erased].links + level] - 1;
+            next[from] = next[nodes[erased].links + level];
+        }
+        else
+        {
+            width[from]--;
+        }
+    }
+    if (after != -1)
+    {
+        nodes[after].prev = nodes[erased].prev;
+    }
+    free[nodes[erased].height].push_back(erased);
+    count--;
+    while (levels > 1 && next[levels - 1] == -1)
+    {
+        levels--;
+    }
+
+    for (Marker &marker : markers)
+    {
+        settle(marker);
+    }
+}
+
+// Node of the price at a rank (0 based), which must be below size()
+int SlidingQuantiles::node(size_t rank) const
+{
+    size_t target = rank + 1;
+    size_t traversed = 0;
+    int node = 0;
+    for (int level = levels - 1; level >= 0; level--)
+    {
+        int link = nodes[node].links + level;
+        while (next[link] != -1 && traversed + width[link] <= target)
+        {
+            traversed += width[link];
+            node = next[link];
+            link = nodes[node].links + level;
+        }
+    }
+    return node;
+}
+
+double SlidingQuantiles::at(size_t rank) const
+{
+    return nodes[node(rank)].price;
+}
+
+// Linearly interpolated percentile (0 <= q <= 1), same as pandas describe()
+double SlidingQuantiles::percentile(double q) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    double position = q*(count - 1);
+    size_t below = static_cast<size_t>(std::floor(position));
+    size_t above = std::min(below + 1, count - 1);
+    double low = at(below);
+    double high = at(above);
+    return low + (position - below)*(high - low);
+}
+
+// Keep these percentiles up to date, replacing the ones tracked before
+void SlidingQuantiles::track(const std::vector<double> &quantiles)
+{
+    markers.clear();
+    for (double q : quantiles)
+    {
+        Marker marker = {std::min(1.0, std::max(0.0, q)), 0, 0};
+        if (count > 0)
+        {
+            marker.rank = static_cast<size_t>(std::floor(marker.q*(count - 1)));
+            marker.node = node(marker.rank);
+        }
+        markers.push_back(marker);
+    }
+}
+
+// Move a marker to the rank of its percentile, one or two steps after a change
+void SlidingQuantiles::settle(Marker &marker)
+{
+    if (count == 0)
+    {
+        marker.node = 0;
+        marker.rank = 0;
+        return;
+    }
+    size_t target = static_cast<size_t>(std::floor(marker.q*(count - 1)));
+    while (marker.rank < target)
+    {
+        marker.node = next[nodes[marker.node].links];
+        marker.rank++;
+    }
+    while (marker.rank > target)
+    {
+        marker.node = nodes[marker.node].prev;
+        marker.rank--;
+    }
+}
+
+// Percentile of the marker in the order given to track(), same value as percentile()
+double SlidingQuantiles::tracked(size_t marker) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const Marker &current = markers[marker];
+    double position = current.q*(count - 1);
+    double low = nodes[current.node].price;
+    int above = next[nodes[current.node].links];
+    double high = above != -1 ? nodes[above].price : low;
+    return low + (position - current.rank)*(high - low);
+}
+
+// Sizes of the structures save() writes whole, for the layout of the snapshot
+uint32_t SlidingQuantiles::layout()
+{
+    return ::layout({sizeof(Node), sizeof(Marker)});
+}
+
+// The arrays as they are, with the free lists and the markers (snapshot.cpp)
+void SlidingQuantiles::save(SnapshotWriter &out) const
+{
+    out.put(nodes);
+    out.put(next);
+    out.put(width);
+    for (const std::vector<int> &unused : free)
+    {
+        out.put(unused);
+    }
+    out.put(markers);
+    out.put(static_cast<uint64_t>(count));
+    out.put(levels);
+    out.put(state);
+}
+
+bool SlidingQuantiles::restore(SnapshotReader &in)
+{
+    uint64_t saved = 0;
+    bool read = in.get(nodes) && in.get(next) && in.get(width);
+    for (std::vector<int> &unused : free)
+    {
+        read = read && in.get(unused);
+    }
+    read = read && in.get(markers) && in.get(saved) && in.get(levels) && in.get(state);
+    count = saved;
+    if (!read || nodes.empty() || next.size() != width.size() || next.size() < MaxLevel || levels < 1 || levels > MaxLevel)
+    {
+        *this = SlidingQuantiles();
+        return false;
+    }
+    return true;
+}
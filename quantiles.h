@@ -0,0 +1,65 @@
+#ifndef quantiles_h
+#define quantiles_h
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// Prices of a sliding window ordered by value, as an indexable skip list. Keys are (price, position)
+// so equal prices stay distinct. Insert and erase are O(log n), the value at any rank is O(log n),
+// and the percentiles given to track() are kept up to date on every change so reading them is O(1).
+// Nodes live in arrays reused through free lists, a window that slides does not allocate.
+class SlidingQuantiles
+{
+public:
+    SlidingQuantiles();
+    void insert(double price, size_t position);
+    void erase(double price, size_t position);
+    void clear();
+    size_t size() const { return count; }
+    double at(size_t rank) const;
+    double percentile(double q) const;
+    void track(const std::vector<double> &quantiles);
+    double tracked(size_t marker) const;
+    void save(SnapshotWriter &out) const;
+    bool restore(SnapshotReader &in);
+    static uint32_t layout();
+
+private:
+    static constexpr int MaxLevel = 16;   // 4^16 prices
+
+    struct Node
+    {
+        double price;
+        size_t position;
+        int prev;      // level 0, 0 is the head
+        int links;     // first of its "height" entries in next and width
+        int height;
+    };
+    struct Marker
+    {
+        double q;
+        int node;      // the price at rank floor(q*(count - 1)), 0 if empty
+        size_t rank;
+    };
+
+    bool less(int node, double price, size_t position) const;
+    int find(double price, size_t position, int update[], size_t rank[]) const;
+    int allocate(int height);
+    int randomHeight();
+    int node(size_t rank) const;
+    void settle(Marker &marker);
+
+    std::vector<Node> nodes;              // nodes[0] is the head
+    std::vector<int> next;                // -1 after the last price
+    std::vector<int> width;               // prices skipped by each link
+    std::vector<std::vector<int>> free;   // unused nodes by height
+    std::vector<Marker> markers;
+    size_t count = 0;
+    int levels = 1;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+};
+
+#endif
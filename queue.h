@@ -0,0 +1,143 @@
+#ifndef queue_h
+#define queue_h
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Bounded lock-free queue (Vyukov's algorithm) for any number of producers and consumers.
+// push() never blocks, it returns false when the queue is full so the producer decides what to do.
+// Depth, peak depth and rejected pushes are kept for the metrics of each pipeline stage.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(T &&value)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            long difference = static_cast<long>(sequence) - static_cast<long>(position);
+            if (difference == 0 && tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+            else if (difference < 0)
+            {
+                refused.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else if (difference > 0)
+            {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+
+        size_t current = depth();
+        size_t highest = highWater.load(std::memory_order_relaxed);
+        while (current > highest && !highWater.compare_exchange_weak(highest, current, std::memory_order_relaxed))
+        {
+        }
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            long difference = static_cast<long>(sequence) - static_cast<long>(position + 1);
+            if (difference == 0 && head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else if (difference > 0)
+            {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t depth() const
+    {
+        size_t in = tail.load(std::memory_order_relaxed);
+        size_t out = head.load(std::memory_order_relaxed);
+        return in > out ? in - out : 0;
+    }
+    size_t capacity() const { return mask + 1; }
+    size_t peak() const { return highWater.load(std::memory_order_relaxed); }
+    size_t rejected() const { return refused.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> highWater{0};
+    std::atomic<size_t> refused{0};
+};
+
+// Lets a consumer sleep while its queue is empty. Only used to wait, the data goes through the queue.
+class Doorbell
+{
+public:
+    void ring()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            rung = true;
+        }
+        bell.notify_one();
+    }
+
+    void wait(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        bell.wait_for(guard, timeout, [this]{ return rung; });
+        rung = false;
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable bell;
+    bool rung = false;
+};
+
+#endif
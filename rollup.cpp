@@ -0,0 +1,217 @@
+/** ========================================================================================
+
+    Filename:  rollup.cpp
+
+    Description:  Keeps Crypto.db bounded. Prices used to be appended forever; now the ones
+                  older than the raw horizon are folded into open/high/low/close/count buckets
+                  of one minute, one hour and one day, keyed by (CurrencyID, bucket), and
+                  deleted from Prices. Minute and hour buckets are dropped in turn after their
+                  retention, day buckets are kept. Prices are moved in short transactions so
+                  the writer of the pipeline never waits long for the database.
+
+                  Settings: "rawHours" (default 48), "minuteDays" (default 30), "hourDays"
+                  (default 365) and "compactMinutes", time between compactions (default 10).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "rollup.h"
+#include "persistence.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <array>
+
+static const char* Levels[3] = {"PricesMinute", "PricesHour", "PricesDay"};
+static const long long Sizes[3] = {60, 3600, 86400};
+
+// Read the horizons, they may be changed while the program runs
+void Compactor::configure(Persistence &db)
+{
+    try
+    {
+        rawHours = std::max(0.0, std::stod(db.setting("rawHours", std::to_string(rawHours))));
+        minuteDays = std::max(0.0, std::stod(db.setting("minuteDays", std::to_string(minuteDays))));
+        hourDays = std::max(0.0, std::stod(db.setting("hourDays", std::to_string(hourDays))));
+        minutes = std::max(1.0, std::stod(db.setting("compactMinutes", std::to_string(minutes))));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid rawHours, minuteDays, hourDays or compactMinutes setting, keeping the previous values"),"error");
+    }
+}
+
+// Move the prices older than the raw horizon into the rollups and apply the retention of the
+// minute and hour buckets. Returns the number of prices moved or -1 with errors.
+int Compactor::compact(Persistence &db, double now)
+{
+    const char* selectQuery = "SELECT PriceID,CurrencyID,time,price FROM (SELECT PriceID,CurrencyID,time,price FROM Prices WHERE PriceID > ?1 AND time < ?2 "
+                              "ORDER BY PriceID LIMIT ?3) ORDER BY CurrencyID,time;";
+    const char* removeQuery = "DELETE FROM Prices WHERE PriceID <= ?1 AND time < ?2;";
+    const char* markQuery = "INSERT OR REPLACE INTO Settings (name,value) VALUES ('compactedUntil',?1);";
+    sqlite3* handle = db.handle();
+    sqlite3_stmt* select = nullptr;
+    sqlite3_stmt* remove = nullptr;
+    sqlite3_stmt* mark = nullptr;
+    sqlite3_stmt* upserts[3] = {nullptr, nullptr, nullptr};
+    sqlite3_stmt* expire[2] = {nullptr, nullptr};
+    long long cutoff = static_cast<long long>(std::floor((now - 3600*rawHours)/60))*60;
+    long long last = 0;
+    int moved = 0;
+    bool failed = handle == nullptr;
+
+    if (!failed)
+    {
+        failed = sqlite3_prepare_v2(handle,selectQuery,-1,&select,nullptr) != SQLITE_OK || sqlite3_prepare_v2(handle,removeQuery,-1,&remove,nullptr) != SQLITE_OK
+                 || sqlite3_prepare_v2(handle,markQuery,-1,&mark,nullptr) != SQLITE_OK;
+    }
+    for (int level = 0; level < 3 && !failed; level++)
+    {
+        const std::string upsert = "INSERT INTO " + std::string(Levels[level]) + " (CurrencyID,bucket,open,high,low,close,count,openTime,closeTime) "
+                                   "VALUES (?,?,?,?,?,?,?,?,?) ON CONFLICT(CurrencyID,bucket) DO UPDATE SET "
+                                   "open = CASE WHEN excluded.openTime < openTime THEN excluded.open ELSE open END, high = MAX(high,excluded.high), "
+                                   "low = MIN(low,excluded.low), close = CASE WHEN excluded.closeTime >= closeTime THEN excluded.close ELSE close END, "
+                                   "count = count + excluded.count, openTime = MIN(openTime,excluded.openTime), closeTime = MAX(closeTime,excluded.closeTime);";
+        failed = sqlite3_prepare_v2(handle,upsert.c_str(),-1,&upserts[level],nullptr) != SQLITE_OK;
+        if (level < 2 && !failed)
+        {
+            const std::string drop = "DELETE FROM " + std::string(Levels[level]) + " WHERE bucket < ?1;";
+            failed = sqlite3_prepare_v2(handle,drop.c_str(),-1,&expire[level],nullptr) != SQLITE_OK;
+        }
+    }
+
+    // Prices are taken in insertion order and each batch is read by currency and time, the buckets
+    // of a currency are written when the next price falls in a new one. Buckets split between
+    // transactions are merged by the upsert, which keeps the open of the earliest price and the
+    // close of the latest, so the history backfilled after newer prices doesn't change them.
+    while (!failed)
+    {
+        std::unordered_map<int, std::array<Bucket, 3>> open;
+        long long rows = 0;
+        if (sqlite3_exec(handle,"BEGIN IMMEDIATE;",nullptr,nullptr,nullptr) != SQLITE_OK)
+        {
+            failed = true;
+            break;
+        }
+        sqlite3_bind_int64(select,1,last);
+        sqlite3_bind_int64(select,2,cutoff);
+        sqlite3_bind_int64(select,3,batch);
+        while (!failed && sqlite3_step(select) == SQLITE_ROW)
+        {
+            last = std::max(last, static_cast<long long>(sqlite3_column_int64(select,0)));
+            int id = sqlite3_column_int(select,1);
+            double time = sqlite3_column_double(select,2);
+            double price = sqlite3_column_double(select,3);
+            rows++;
+            for (int level = 0; level < 3 && !failed; level++)
+            {
+                Bucket &bucket = open[id][level];
+                long long start = static_cast<long long>(std::floor(time/Sizes[level]))*Sizes[level];
+                if (bucket.count > 0 && bucket.start != start)
+                {
+                    failed = flush(upserts[level], id, bucket) != 0;
+                }
+                if (bucket.count == 0)
+                {
+                    bucket.start = start;
+                    bucket.open = bucket.high = bucket.low = price;
+                    bucket.openTime = time;
+                }
+                bucket.high = std::max(bucket.high, price);
+                bucket.low = std::min(bucket.low, price);
+                bucket.close = price;
+                bucket.closeTime = time;
+                bucket.count++;
+            }
+        }
+        sqlite3_reset(select);
+        for (auto &entry : open)
+        {
+            for (int level = 0; level < 3 && !failed; level++)
+            {
+                failed = entry.second[level].count > 0 && flush(upserts[level], entry.first, entry.second[level]) != 0;
+            }
+        }
+        sqlite3_bind_int64(remove,1,last);
+        sqlite3_bind_int64(remove,2,cutoff);
+        failed = failed || sqlite3_step(remove) != SQLITE_DONE;
+        sqlite3_reset(remove);
+        if (failed || sqlite3_exec(handle,"COMMIT;",nullptr,nullptr,nullptr) != SQLITE_OK)
+        {
+            failed = true;
+            break;
+        }
+        moved += rows;
+        if (rows < batch)
+        {
+            break;
+        }
+    }
+
+    // Retention of the rollups and the time up to which Prices was compacted
+    if (!failed && sqlite3_exec(handle,"BEGIN IMMEDIATE;",nullptr,nullptr,nullptr) == SQLITE_OK)
+    {
+        double until = cutoff;
+        try
+        {
+            until = std::max(until, std::stod(db.setting("compactedUntil","0")));
+        }
+        catch (const std::exception &)
+        {
+            // not a number, the cutoff of this pass is used
+        }
+        sqlite3_bind_int64(expire[0],1,static_cast<long long>(now - 86400*minuteDays));
+        sqlite3_bind_int64(expire[1],1,static_cast<long long>(now - 86400*hourDays));
+        sqlite3_bind_text(mark,1,std::to_string(static_cast<long long>(until)).c_str(),-1,SQLITE_TRANSIENT);
+        failed = sqlite3_step(expire[0]) != SQLITE_DONE || sqlite3_step(expire[1]) != SQLITE_DONE || sqlite3_step(mark) != SQLITE_DONE
+                 || sqlite3_exec(handle,"COMMIT;",nullptr,nullptr,nullptr) != SQLITE_OK;
+    }
+    else
+    {
+        failed = true;
+    }
+
+    if (failed)
+    {
+        Alert(std::vector<std::string> (1,"Error compacting old prices: " + std::string(handle ? sqlite3_errmsg(handle) : "the database is not open")),"error");
+        if (handle != nullptr && !sqlite3_get_autocommit(handle))
+        {
+            sqlite3_exec(handle,"ROLLBACK;",nullptr,nullptr,nullptr);
+        }
+    }
+    sqlite3_finalize(select);
+    sqlite3_finalize(remove);
+    sqlite3_finalize(mark);
+    for (int level = 0; level < 3; level++)
+    {
+        sqlite3_finalize(upserts[level]);
+    }
+    sqlite3_finalize(expire[0]);
+    sqlite3_finalize(expire[1]);
+    return failed ? -1 : moved;
+}
+
+// Write a bucket and start a new one
+int Compactor::flush(sqlite3_stmt* upsert, int id, Bucket &bucket)
+{
+    sqlite3_bind_int(upsert,1,id);
+    sqlite3_bind_int64(upsert,2,bucket.start);
+    sqlite3_bind_double(upsert,3,bucket.open);
+    sqlite3_bind_double(upsert,4,bucket.high);
+    sqlite3_bind_double(upsert,5,bucket.low);
+    sqlite3_bind_double(upsert,6,bucket.close);
+    sqlite3_bind_int64(upsert,7,bucket.count);
+    sqlite3_bind_double(upsert,8,bucket.openTime);
+    sqlite3_bind_double(upsert,9,bucket.closeTime);
+    int flag = sqlite3_step(upsert);
+    sqlite3_reset(upsert);
+    bucket.count = 0;
+    return flag == SQLITE_DONE ? 0 : -1;
+}
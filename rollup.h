@@ -0,0 +1,38 @@
+#ifndef rollup_h
+#define rollup_h
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <sqlite3.h>
+
+class Persistence;
+
+// Moves the prices older than the raw horizon out of Prices into per-minute, per-hour and
+// per-day OHLC tables (PricesMinute, PricesHour, PricesDay), and drops the minute and hour
+// buckets past their own retention. The time up to which Prices was compacted is kept in the
+// "compactedUntil" setting.
+class Compactor
+{
+public:
+    void configure(Persistence &db);
+    int compact(Persistence &db, double now);
+    double interval() const { return 60*minutes; }
+
+private:
+    struct Bucket
+    {
+        long long start = -1;
+        double open, high, low, close;
+        double openTime, closeTime;
+        long long count = 0;
+    };
+    int flush(sqlite3_stmt* upsert, int id, Bucket &bucket);
+
+    double rawHours = 48;      // raw prices kept
+    double minuteDays = 30;    // minute buckets kept
+    double hourDays = 365;     // hour buckets kept, day buckets are never dropped
+    double minutes = 10;       // between compactions
+    long long batch = 20000;   // prices moved per transaction
+};
+
+#endif
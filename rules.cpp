@@ -0,0 +1,585 @@
+/** ========================================================================================
+
+    Filename:  rules.cpp
+
+    Description:  Alert rules of the analyses. A rule is an expression over the metrics of a
+                  pass (see MeasureNames) and the thresholds of the currency (see
+                  ThresholdNames), like "abs(instant) > gain and volatility > 2*mean/100".
+                  It is compiled once per currency, when its thresholds change, into a flat
+                  postfix program: thresholds become constants, constant parts are folded, and
+                  every pass only runs a few steps over an array of doubles. The built in rules
+                  skip the stack: every pass runs the comparisons their programs come to as
+                  straight-line code, so only the rules of the user are interpreted.
+
+                  The built in alerts of the GUI are rules too, and each rule keeps its
+                  state: it fires when its condition becomes true and not again until the
+                  condition resets, so a price that stays above a threshold is reported once
+                  instead of on every pass. While a rule is waiting to reset, comparisons with
+                  a constant are relaxed by a fraction of it (the hysteresis band), so a value
+                  moving around the threshold does not fire again on every crossing.
+
+                  Grammar, lowest precedence first:
+                    or, and, not, comparison (> < >= <=), + -, * /, unary -, numbers,
+                    names, abs(...) and parentheses
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "rules.h"
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+enum Op { Load, Constant, Abs, Negate, Not, Add, Subtract, Multiply, Divide, Greater, Less, GreaterEqual, LessEqual, And, Or };
+
+// Names of the metrics in the expressions, by Measure. Returns are in percentage like the
+// thresholds, variation is mean/volatility (0 without volatility), recent and hour are the means of
+// the last 20 and 70 minutes, high and low the percentiles of "anomaly" (0 if it is 0).
+static const char* MeasureNames[Measures] = {"count", "first", "last", "instant", "return", "mean", "volatility", "variation", "recent", "hour", "high", "low"};
+static const char* ThresholdNames[] = {"minimumData", "timeWindow", "gain", "longGain", "movingAvg", "anomaly", "decoupling"};
+
+// Built in alerts, by Signal, and whether the thresholds enable them
+static const char* Builtin[Signals] = {"abs(instant) > gain", "abs(return) > longGain", "recent > hour", "last > high or last < low", "variation > 1.5"};
+
+static bool enabled(int signal, const Thresholds &limits)
+{
+    switch (signal)
+    {
+        case InstantGain:
+            return limits.gain != 0;
+        case LongGain:
+            return limits.longGain != 0;
+        case MovingAverage:
+            return limits.movingAvg;
+        case Anomaly:
+            return limits.anomaly != 0;
+        default:
+            return true;
+    }
+}
+
+// One step on the stack, comparisons relaxed by "slack" times their threshold
+static void apply(const Step &step, double* stack, size_t &top, double slack)
+{
+    double margin = slack*step.value;
+    switch (step.op)
+    {
+        case Abs:
+            stack[top - 1] = std::abs(stack[top - 1]);
+            return;
+        case Negate:
+            stack[top - 1] = -stack[top - 1];
+            return;
+        case Not:
+            stack[top - 1] = stack[top - 1] == 0;
+            return;
+        default:
+            break;
+    }
+    double a = stack[top - 2], b = stack[top - 1];
+    top--;
+    switch (step.op)
+    {
+        case Add:
+            stack[top - 1] = a + b;
+            break;
+        case Subtract:
+            stack[top - 1] = a - b;
+            break;
+        case Multiply:
+            stack[top - 1] = a*b;
+            break;
+        case Divide:
+            stack[top - 1] = a/b;
+            break;
+        case Greater:
+            stack[top - 1] = a > b - margin;
+            break;
+        case Less:
+            stack[top - 1] = a < b + margin;
+            break;
+        case GreaterEqual:
+            stack[top - 1] = a >= b - margin;
+            break;
+        case LessEqual:
+            stack[top - 1] = a <= b + margin;
+            break;
+        case And:
+            stack[top - 1] = a != 0 && b != 0;
+            break;
+        default:
+            stack[top - 1] = a != 0 || b != 0;
+            break;
+    }
+}
+
+// Recursive descent over the expression, one function per precedence level. Errors are thrown as
+// std::invalid_argument with the position.
+class Compiler
+{
+public:
+    Compiler(const std::string &text, const Thresholds &limits) : text(text), limits(limits) {}
+
+    std::vector<Step> run()
+    {
+        disjunction();
+        space();
+        if (at != text.size())
+        {
+            fail("unexpected text");
+        }
+        return steps;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string &what)
+    {
+        throw std::invalid_argument(what + " at character " + std::to_string(at + 1));
+    }
+
+    void space()
+    {
+        while (at < text.size() && std::isspace(static_cast<unsigned char>(text[at])))
+        {
+            at++;
+        }
+    }
+
+    // Skip "token" if it comes next, words only as whole words
+    bool accept(const char* token)
+    {
+        space();
+        size_t length = std::strlen(token);
+        if (text.compare(at, length, token) != 0)
+        {
+            return false;
+        }
+        bool word = std::isalpha(static_cast<unsigned char>(token[0]));
+        if (word && at + length < text.size() && (std::isalnum(static_cast<unsigned char>(text[at + length])) || text[at + length] == '_'))
+        {
+            return false;
+        }
+        at += length;
+        return true;
+    }
+
+    void constant(double value)
+    {
+        steps.push_back({Constant, 0, value});
+    }
+
+    bool isConstant(size_t from, size_t to) const
+    {
+        return to - from == 1 && steps[from].op == Constant;
+    }
+
+    // Append the operation on the two operands on top, or fold it if both are constants
+    void binary(Op op, size_t left, size_t right)
+    {
+        if (isConstant(left, right) && isConstant(right, steps.size()))
+        {
+            double a = steps[left].value, b = steps[right].value;
+            steps.resize(left);
+            double stack[2] = {a, b};
+            size_t top = 2;
+            Step step = {static_cast<unsigned char>(op), 0, 0};
+            apply(step, stack, top, 0);
+            constant(stack[0]);
+            return;
+        }
+        // A comparison with a constant is relaxed around it while the rule waits to reset
+        double band = 0;
+        if (op >= Greater && op <= LessEqual)
+        {
+            band = isConstant(right, steps.size()) ? std::abs(steps[right].value) : isConstant(left, right) ? std::abs(steps[left].value) : 0;
+        }
+        steps.push_back({static_cast<unsigned char>(op), 0, band});
+    }
+
+    void disjunction()
+    {
+        size_t left = steps.size();
+        conjunction();
+        while (accept("or"))
+        {
+            size_t right = steps.size();
+            conjunction();
+            binary(Or, left, right);
+        }
+    }
+
+    void conjunction()
+    {
+        size_t left = steps.size();
+        negation();
+        while (accept("and"))
+        {
+            size_t right = steps.size();
+            negation();
+            binary(And, left, right);
+        }
+    }
+
+    void negation()
+    {
+        if (accept("not"))
+        {
+            negation();
+            steps.push_back({Not, 0, 0});
+            return;
+        }
+        comparison();
+    }
+
+    void comparison()
+    {
+        size_t left = steps.size();
+        sum();
+        Op op;
+        if (accept(">="))
+        {
+            op = GreaterEqual;
+        }
+        else if (accept("<="))
+        {
+            op = LessEqual;
+        }
+        else if (accept(">"))
+        {
+            op = Greater;
+        }
+        else if (accept("<"))
+        {
+            op = Less;
+        }
+        else
+        {
+            return;
+        }
+        size_t right = steps.size();
+        sum();
+        binary(op, left, right);
+    }
+
+    void sum()
+    {
+        size_t left = steps.size();
+        product();
+        while (true)
+        {
+            Op op = accept("+") ? Add : accept("-") ? Subtract : Load;
+            if (op == Load)
+            {
+                return;
+            }
+            size_t right = steps.size();
+            product();
+            binary(op, left, right);
+        }
+    }
+
+    void product()
+    {
+        size_t left = steps.size();
+        unary();
+        while (true)
+        {
+            Op op = accept("*") ? Multiply : accept("/") ? Divide : Load;
+            if (op == Load)
+            {
+                return;
+            }
+            size_t right = steps.size();
+            unary();
+            binary(op, left, right);
+        }
+    }
+
+    void unary()
+    {
+        if (accept("-"))
+        {
+            unary();
+            if (steps.back().op == Constant)
+            {
+                steps.back().value = -steps.back().value;
+            }
+            else
+            {
+                steps.push_back({Negate, 0, 0});
+            }
+            return;
+        }
+        primary();
+    }
+
+    void primary()
+    {
+        space();
+        if (accept("("))
+        {
+            disjunction();
+            if (!accept(")"))
+            {
+                fail("missing )");
+            }
+            return;
+        }
+        if (accept("abs"))
+        {
+            if (!accept("("))
+            {
+                fail("missing ( after abs");
+            }
+            disjunction();
+            if (!accept(")"))
+            {
+                fail("missing )");
+            }
+            if (steps.back().op == Constant)
+            {
+                steps.back().value = std::abs(steps.back().value);
+            }
+            else
+            {
+                steps.push_back({Abs, 0, 0});
+            }
+            return;
+        }
+        if (at < text.size() && (std::isdigit(static_cast<unsigned char>(text[at])) || text[at] == '.'))
+        {
+            char* end = nullptr;
+            double value = std::strtod(text.c_str() + at, &end);
+            at = end - text.c_str();
+            constant(value);
+            return;
+        }
+        size_t begin = at;
+        while (at < text.size() && (std::isalnum(static_cast<unsigned char>(text[at])) || text[at] == '_'))
+        {
+            at++;
+        }
+        const std::string name = text.substr(begin, at - begin);
+        if (name.empty())
+        {
+            fail(at < text.size() ? "unexpected " + std::string(1, text[at]) : "missing value at the end");
+        }
+        for (int metric = 0; metric < Measures; metric++)
+        {
+            if (name == MeasureNames[metric])
+            {
+                steps.push_back({Load, static_cast<unsigned char>(metric), 0});
+                return;
+            }
+        }
+        const double values[] = {static_cast<double>(limits.minimumData), limits.timeWindow, limits.gain, limits.longGain, limits.movingAvg ? 1.0 : 0.0,
+                                 limits.anomaly, limits.decoupling};
+        for (size_t i = 0; i < sizeof(values)/sizeof(values[0]); i++)
+        {
+            if (name == ThresholdNames[i])
+            {
+                constant(values[i]);
+                return;
+            }
+        }
+        at = begin;
+        fail("unknown name " + name);
+    }
+
+private:
+    const std::string &text;
+    const Thresholds &limits;
+    size_t at = 0;
+    std::vector<Step> steps;
+};
+
+// Compile "expression" with the thresholds "limits" into "steps". Returns the error, or "" if it
+// compiled.
+std::string compile(const std::string &expression, const Thresholds &limits, std::vector<Step> &steps)
+{
+    try
+    {
+        steps = Compiler(expression, limits).run();
+    }
+    catch (const std::invalid_argument &error)
+    {
+        return error.what();
+    }
+    size_t depth = 0, deepest = 0;
+    for (const Step &step : steps)
+    {
+        depth += step.op == Load || step.op == Constant ? 1 : step.op == Abs || step.op == Negate || step.op == Not ? 0 : -1;
+        deepest = std::max(deepest, depth);
+    }
+    if (deepest > Plan::MaxDepth)
+    {
+        return "too many nested operations";
+    }
+    return "";
+}
+
+// The rules that compile, the others are reported
+std::vector<RuleConfig> validate(const std::vector<RuleConfig> &rules)
+{
+    std::vector<RuleConfig> valid;
+    for (const RuleConfig &rule : rules)
+    {
+        std::vector<Step> steps;
+        std::string error = compile(rule.expression, Thresholds(), steps);
+        if (!error.empty())
+        {
+            Alert(std::vector<std::string> (1,"The rule " + rule.name + " (" + rule.expression + ") is ignored: " + error),"error");
+            continue;
+        }
+        valid.push_back(rule);
+    }
+    return valid;
+}
+
+// Conditions of the built in rules enabled, one bit per Signal, as the comparisons their programs
+// come to: "abs(instant) > gain" is Load, Abs, Constant, Greater relaxed around the constant. Those
+// in "relaxed" wait to reset and are relaxed by "band". rules_bench checks them against the steps.
+unsigned Plan::conditions(const double* metrics, unsigned relaxed, double band) const
+{
+    double slack[Signals];
+    for (int signal = 0; signal < Signals; signal++)
+    {
+        slack[signal] = (relaxed >> signal & 1) ? band : 0;
+    }
+    unsigned met = (std::abs(metrics[Instant]) > gain - slack[InstantGain]*std::abs(gain)) << InstantGain
+                 | (std::abs(metrics[Return]) > longGain - slack[LongGain]*std::abs(longGain)) << LongGain
+                 | (metrics[Recent] > metrics[Hour]) << MovingAverage
+                 | ((metrics[Last] > metrics[High]) | (metrics[Last] < metrics[Low])) << Anomaly
+                 | (metrics[Coefficient] > 1.5 - slack[Variation]*1.5) << Variation;
+    return met & enabled;
+}
+
+// Whether the condition of one of the rules holds, comparisons relaxed by "slack" times their
+// threshold
+bool Plan::met(const Rule &rule, const double* metrics, double slack) const
+{
+    return rule.signal >= 0 ? (conditions(metrics, ~0u, slack) >> rule.signal & 1) : rule.interpret(metrics, slack);
+}
+
+// Whether the condition holds, running the steps on the stack
+bool Rule::interpret(const double* metrics, double slack) const
+{
+    double stack[Plan::MaxDepth];
+    size_t top = 0;
+    for (const Step &step : steps)
+    {
+        if (step.op == Load)
+        {
+            stack[top++] = metrics[step.metric];
+        }
+        else if (step.op == Constant)
+        {
+            stack[top++] = step.value;
+        }
+        else
+        {
+            apply(step, stack, top, slack);
+        }
+    }
+    return top > 0 && stack[0] != 0;
+}
+
+// Rules of the currency "id" with the thresholds "limits", the enabled built in alerts first. Rules
+// whose program didn't change keep their state.
+void Plan::compile(const Thresholds &limits, const std::vector<RuleConfig> &custom, int id)
+{
+    std::vector<Rule> rules;
+    enabled = 0;
+    gain = limits.gain;
+    longGain = limits.longGain;
+    for (int signal = 0; signal < Signals; signal++)
+    {
+        if (::enabled(signal, limits))
+        {
+            enabled |= 1u << signal;
+            Rule rule;
+            rule.expression = Builtin[signal];
+            rule.signal = signal;
+            ::compile(rule.expression, limits, rule.steps);
+            rules.push_back(std::move(rule));
+        }
+    }
+    builtins = rules.size();
+    for (const RuleConfig &config : custom)
+    {
+        Rule rule;
+        rule.name = config.name;
+        rule.expression = config.expression;
+        if ((config.currency == 0 || config.currency == id) && ::compile(rule.expression, limits, rule.steps).empty())
+        {
+            rules.push_back(std::move(rule));
+        }
+    }
+    waiting = 0;
+    for (Rule &rule : rules)
+    {
+        for (const Rule &before : compiled)
+        {
+            if (before.name == rule.name && before.signal == rule.signal && before.steps == rule.steps)
+            {
+                rule.armed = before.armed;
+                rule.fired = before.fired;
+                break;
+            }
+        }
+        waiting |= rule.signal >= 0 && !rule.armed ? 1u << rule.signal : 0;
+    }
+    compiled = std::move(rules);
+}
+
+// Run every rule on the metrics of a pass at "now" and add those that fire to "fired"
+void Plan::evaluate(const double* metrics, double now, const Hysteresis &rearm, std::vector<const Rule*> &fired)
+{
+    // The built in rules only look at their Rule when they may fire or they reset
+    unsigned met = conditions(metrics, waiting, rearm.band);
+    unsigned rising = met & ~waiting, reset = waiting & ~met;
+    waiting &= met;
+    while (rising != 0)
+    {
+        int signal = __builtin_ctz(rising);
+        Rule &rule = compiled[__builtin_popcount(enabled & ((1u << signal) - 1))];
+        if (rule.fired == 0 || now - rule.fired >= rearm.cooldown)
+        {
+            rule.armed = false;
+            rule.fired = now;
+            waiting |= 1u << signal;
+            fired.push_back(&rule);
+        }
+        rising &= rising - 1;
+    }
+    while (reset != 0)
+    {
+        compiled[__builtin_popcount(enabled & ((1u << __builtin_ctz(reset)) - 1))].armed = true;
+        reset &= reset - 1;
+    }
+
+    for (size_t i = builtins; i < compiled.size(); i++)
+    {
+        Rule &rule = compiled[i];
+        bool met = rule.interpret(metrics, rule.armed ? 0 : rearm.band);
+        if (!rule.armed)
+        {
+            rule.armed = !met;
+        }
+        else if (met && (rule.fired == 0 || now - rule.fired >= rearm.cooldown))
+        {
+            rule.armed = false;
+            rule.fired = now;
+            fired.push_back(&rule);
+        }
+    }
+}
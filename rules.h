@@ -0,0 +1,71 @@
+#ifndef rules_h
+#define rules_h
+#include <vector>
+#include <string>
+#include "config.h"
+
+// Alerts of the analyses, the built in rules of every currency
+enum Signal { InstantGain, LongGain, MovingAverage, Anomaly, Variation, Signals };
+
+// Values of one pass of the analyses the rules read, by the names of MeasureNames in rules.cpp
+enum Measure { Count, First, Last, Instant, Return, Mean, Volatility, Coefficient, Recent, Hour, High, Low, Measures };
+
+// When a rule that fired may fire again: once its condition is false with the thresholds it
+// compares with relaxed by "band" (a fraction of each), and "cooldown" seconds after it fired
+struct Hysteresis
+{
+    double band = 0.1;
+    double cooldown = 0;
+};
+
+// One step of a compiled rule, run on a stack of doubles where booleans are 0 or 1
+struct Step
+{
+    unsigned char op;
+    unsigned char metric;
+    double value;          // of a constant, or the threshold a comparison is relaxed around
+
+    bool operator==(const Step &other) const { return op == other.op && metric == other.metric && value == other.value; }
+};
+
+// A rule compiled for the thresholds of one currency, with its state
+struct Rule
+{
+    std::string name;
+    std::string expression;
+    int signal = -1;       // Signal of the built in rules, -1 for those of the user
+    std::vector<Step> steps;
+    bool armed = true;
+    double fired = 0;      // time of the last alert, 0 if it never fired
+
+    bool interpret(const double* metrics, double slack) const;
+};
+
+// The rules of one currency: the built in alerts of its thresholds, then those of the Rules
+// table that apply to it, as flat programs run once per pass. The built in rules run as the
+// comparisons their programs come to, without the stack.
+class Plan
+{
+public:
+    static constexpr size_t MaxDepth = 16;   // of the stack of a rule
+
+    void compile(const Thresholds &limits, const std::vector<RuleConfig> &custom, int id);
+    void evaluate(const double* metrics, double now, const Hysteresis &rearm, std::vector<const Rule*> &fired);
+    bool met(const Rule &rule, const double* metrics, double slack) const;
+    const std::vector<Rule>& rules() const { return compiled; }
+
+private:
+    unsigned conditions(const double* metrics, unsigned relaxed, double band) const;
+
+    std::vector<Rule> compiled;
+    size_t builtins = 0;      // the first rules, in the order of Signal
+    unsigned enabled = 0;     // one bit per Signal
+    unsigned waiting = 0;     // built in rules that are not armed, the Rule is only told when it changes
+    double gain = 0;
+    double longGain = 0;
+};
+
+std::string compile(const std::string &expression, const Thresholds &limits, std::vector<Step> &steps);
+std::vector<RuleConfig> validate(const std::vector<RuleConfig> &rules);
+
+#endif
@@ -0,0 +1,243 @@
+/** ========================================================================================
+
+    Filename:  scheduler.cpp
+
+    Description:  Replaces the fixed polling of the main loop. Every currency is refreshed at
+                  the interval defined by the user in Mode, scaled by its coefficient of
+                  variation: volatile currencies are requested up to 4 times as often and quiet
+                  ones down to 4 times less often. Requests spend tokens from a bucket refilled
+                  with the API budget, and when the API answers that the rate limit was exceeded
+                  calls stop for an exponentially growing time. Between calls the main thread
+                  sleeps on a condition variable until the next currency is due.
+
+                  New currencies are held back until their history was requested, those
+                  requests spend tokens of the same bucket.
+
+                  Settings: "callsPerMinute" (default 30), "volatilityReference", the
+                  coefficient of variation refreshed at the interval of Mode (default 0.01)
+                  and "backfill", 0 to follow new currencies without their history (default 1).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "scheduler.h"
+#include "persistence.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Read the budget and set the interval of every currency followed. New currencies are due now.
+void Scheduler::configure(Persistence &db, double minutes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<int, Slot> current;
+
+    base = 60*minutes;
+    try
+    {
+        capacity = std::max(1.0, std::stod(db.setting("callsPerMinute", std::to_string(capacity))));
+        reference = std::stod(db.setting("volatilityReference", std::to_string(reference)));
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid callsPerMinute or volatilityReference setting, keeping the previous values"),"error");
+    }
+    backfill = db.setting("backfill", "1") != "0";
+    tokens = std::min(tokens, capacity);
+
+    for (const std::string &name : db.names())
+    {
+        int id = db.id(name);
+        auto found = slots.find(id);
+        Slot &slot = current[id];
+        if (found != slots.end())
+        {
+            slot = found->second;
+        }
+        else
+        {
+            slot.next = Clock::now();
+            slot.history = backfill;
+        }
+        double cv = variation.count(id) ? variation[id] : 0;
+        double factor = cv > 0 && reference > 0 ? std::min(4.0, std::max(0.25, reference/cv)) : 1;
+        Clock::time_point last = slot.next - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(slot.interval));
+        slot.interval = base*factor;
+        if (found != slots.end())
+        {
+            slot.next = last + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(slot.interval));
+        }
+    }
+    slots.swap(current);
+}
+
+// Latest coefficients of variation, published by the analytics worker after every pass
+void Scheduler::adapt(const std::vector<std::pair<int, double>> &cvs)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (const auto &cv : cvs)
+    {
+        variation[cv.first] = cv.second;
+    }
+}
+
+// GeckoIDs to request now, the most overdue first, as many as the tokens left allow
+std::vector<std::string> Scheduler::due(const Persistence &db, size_t chunkSize)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::pair<Clock::time_point, const std::string*>> ready;
+    std::vector<std::string> names;
+    Clock::time_point now = Clock::now();
+
+    if (now < blocked)
+    {
+        return names;
+    }
+    refill(now);
+    for (const std::string &name : db.names())
+    {
+        auto found = slots.find(db.id(name));
+        if (found != slots.end() && found->second.next <= now && !found->second.history)
+        {
+            ready.emplace_back(found->second.next, &name);
+        }
+    }
+    std::sort(ready.begin(), ready.end());
+
+    size_t allowed = static_cast<size_t>(std::floor(tokens))*chunkSize;
+    for (size_t i = 0; i < ready.size() && i < allowed; i++)
+    {
+        names.push_back(*ready[i].second);
+    }
+    tokens -= (names.size() + chunkSize - 1)/chunkSize;
+    return names;
+}
+
+// GeckoIDs of the currencies waiting for their history, no tokens are spent
+std::vector<std::string> Scheduler::newcomers(const Persistence &db)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::string> names;
+    for (const std::string &name : db.names())
+    {
+        auto found = slots.find(db.id(name));
+        if (found != slots.end() && found->second.history)
+        {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+// Take the tokens of that many requests, or as many as are left. Returns the requests allowed.
+size_t Scheduler::spend(size_t requests)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Clock::time_point now = Clock::now();
+    if (now < blocked)
+    {
+        return 0;
+    }
+    refill(now);
+    size_t allowed = std::min(requests, static_cast<size_t>(std::max(0.0, std::floor(tokens))));
+    tokens -= allowed;
+    return allowed;
+}
+
+// The price of a currency was received
+void Scheduler::fetched(int id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = slots.find(id);
+    if (found != slots.end())
+    {
+        found->second.next = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(found->second.interval));
+    }
+}
+
+// The history of a currency was saved, or can't be requested: its regular calls start now
+void Scheduler::backfilled(int id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = slots.find(id);
+    if (found != slots.end())
+    {
+        found->second.history = false;
+        found->second.next = Clock::now();
+    }
+}
+
+// The API said the rate limit was exceeded: wait 30 seconds, doubling up to 15 minutes
+void Scheduler::limited()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    backoff = backoff == 0 ? 30 : std::min(2*backoff, 900.0);
+    blocked = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(backoff));
+    tokens = 0;
+    Alert(std::vector<std::string> (1,"Rate limited, waiting " + std::to_string(static_cast<int>(backoff)) + " seconds before calling the API again"),"error");
+}
+
+// A call went through without being rate limited
+void Scheduler::recovered()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    backoff = 0;
+}
+
+// The calls can't be made for now, as when the database can't be read: none for that many seconds,
+// or until the rate limit ends if it is later
+void Scheduler::postpone(double seconds)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    blocked = std::max(blocked, Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+}
+
+// Sleep until the next currency is due and the budget allows a request, or until notify()
+void Scheduler::wait(const std::atomic<bool> &running)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait_until(guard, wakeup(), [&]{ return woken || !running.load(); });
+    woken = false;
+}
+
+void Scheduler::notify()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        woken = true;
+    }
+    wake.notify_all();
+}
+
+// Time of the next API call, called with the lock held
+Scheduler::Clock::time_point Scheduler::wakeup()
+{
+    Clock::time_point now = Clock::now();
+    Clock::time_point next = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(base));
+    for (const auto &slot : slots)
+    {
+        next = std::min(next, slot.second.next);
+    }
+    next = std::max(next, blocked);
+    refill(now);
+    if (tokens < 1)
+    {
+        next = std::max(next, now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(60*(1 - tokens)/capacity)));
+    }
+    return next;
+}
+
+// Tokens regained since the last refill, "capacity" per minute
+void Scheduler::refill(Clock::time_point now)
+{
+    std::chrono::duration<double> elapsed = now - refilled;
+    tokens = std::min(capacity, tokens + elapsed.count()*capacity/60);
+    refilled = now;
+}
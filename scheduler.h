@@ -0,0 +1,61 @@
+#ifndef scheduler_h
+#define scheduler_h
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+class Persistence;
+
+// Decides which currencies are requested on every API call and when the next call happens.
+// Each currency has its own refresh interval, shorter for the volatile ones, and requests are
+// limited by a token bucket with the API budget. Rate limits make the calls back off exponentially.
+// Currencies added while the program runs first wait for their history (backfill() in database.cpp),
+// which is requested with the same budget, and only then join the regular calls.
+class Scheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    void configure(Persistence &db, double minutes);
+    void adapt(const std::vector<std::pair<int, double>> &cvs);
+    std::vector<std::string> due(const Persistence &db, size_t chunkSize);
+    std::vector<std::string> newcomers(const Persistence &db);
+    size_t spend(size_t requests);
+    void fetched(int id);
+    void backfilled(int id);
+    void limited();
+    void recovered();
+    void postpone(double seconds);
+    void wait(const std::atomic<bool> &running);
+    void notify();
+
+private:
+    struct Slot
+    {
+        Clock::time_point next;
+        double interval = 60;  // seconds
+        bool history = false;  // waiting for backfilled() before its first regular call
+    };
+    Clock::time_point wakeup();
+    void refill(Clock::time_point now);
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool woken = false;
+    std::unordered_map<int, Slot> slots;  // by Currencies.ID
+    std::unordered_map<int, double> variation;  // coefficient of variation by Currencies.ID
+    double base = 60;                     // seconds, from Mode.updateFreq
+    double reference = 0.01;              // coefficient of variation refreshed at the base interval
+    bool backfill = true;                 // new currencies get their history first
+    double capacity = 30;                 // requests per minute allowed by the API
+    double tokens = 30;
+    Clock::time_point refilled = Clock::now();
+    double backoff = 0;                   // seconds, 0 if not rate limited
+    Clock::time_point blocked = Clock::now();
+};
+
+#endif
@@ -0,0 +1,147 @@
+/** ========================================================================================
+
+    Filename:  snapshot.cpp
+
+    Description:  Snapshot of the state of the analyses, so a restart does not have to read
+                  the windows of every currency from Prices again and push them through the
+                  rolling sums and the order statistics. The analytics worker of the pipeline
+                  saves the rings of the PriceStore, the rolling windows and the skip lists of
+                  every currency and the highest PriceID read; at startup the file is mapped,
+                  copied back and only the prices saved after it are read (pricestore.cpp).
+
+                  The file starts with a header holding the length and the CRC32 of the rest.
+                  It is written to a temporary file renamed over the previous one, so a crash
+                  leaves either snapshot complete; a file that was cut short, does not match
+                  its CRC or comes from a build with another layout is ignored and the windows
+                  are read from the database as before. The layout is a hash of the sizes of
+                  the plain types and of every structure saved whole (layout()), and the
+                  version in the magic goes up when what is saved changes in any other way.
+
+                  Settings: "snapshotFile" (default analytics.snap, empty disables it),
+                  "snapshotMinutes", minutes between snapshots (default 10). A snapshot is
+                  also saved when the program stops.
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "snapshot.h"
+#include "journal.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cerrno>
+
+namespace
+{
+    struct Header
+    {
+        char magic[8];
+        uint32_t layout;    // of the plain types and of the structures saved, a build where they differ can't read it
+        uint32_t crc;       // of the "length" bytes after the header
+        uint64_t length;
+    };
+    // The version goes up whenever what is saved changes without changing the size of a structure
+    const char Magic[8] = {'C','R','Y','P','T','S','0','2'};
+    const uint32_t Plain = layout({sizeof(size_t), sizeof(long long), sizeof(int), sizeof(double), sizeof(bool), sizeof(Header)});
+}
+
+// FNV-1a of the sizes, in order
+uint32_t layout(std::initializer_list<size_t> sizes)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t size : sizes)
+    {
+        for (int byte = 0; byte < 8; byte++)
+        {
+            hash = (hash ^ ((static_cast<uint64_t>(size) >> 8*byte) & 0xFF))*16777619u;
+        }
+    }
+    return hash;
+}
+
+// Header and buffer into "path".tmp, then renamed over "path". "structures" is the layout() of the
+// structures the caller saved.
+int SnapshotWriter::save(const std::string &path, uint32_t structures) const
+{
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.layout = layout({Plain, structures});
+    header.crc = crc32(0, reinterpret_cast<const unsigned char*>(buffer.data()), buffer.size());
+    header.length = buffer.size();
+
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    bool written = file != nullptr && std::fwrite(&header, sizeof(header), 1, file) == 1
+                   && (buffer.empty() || std::fwrite(buffer.data(), buffer.size(), 1, file) == 1);
+    if (file != nullptr && std::fclose(file) != 0)
+    {
+        written = false;
+    }
+    if (!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Error saving the snapshot " + path + ": " + std::string(std::strerror(errno))),"error");
+        std::remove(temporary.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    if (mapping != nullptr)
+    {
+        munmap(mapping, length);
+    }
+}
+
+// Map the snapshot and check its header, with the layout() of the structures the caller reads, and
+// its CRC. Returns 1 if there is none, -1 if it can't be used.
+int SnapshotReader::open(const std::string &path, uint32_t structures)
+{
+    struct stat info;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return errno == ENOENT ? 1 : -1;
+    }
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header))
+    {
+        close(fd);
+        Alert(std::vector<std::string> (1,"The snapshot " + path + " is incomplete, it is ignored"),"error");
+        return -1;
+    }
+    length = info.st_size;
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        Alert(std::vector<std::string> (1,"Error mapping the snapshot " + path + ": " + std::string(std::strerror(errno))),"error");
+        length = 0;
+        return -1;
+    }
+    mapping = mapped;
+    madvise(mapping, length, MADV_SEQUENTIAL);
+
+    Header header;
+    std::memcpy(&header, mapping, sizeof(header));
+    const unsigned char* data = static_cast<const unsigned char*>(mapping) + sizeof(Header);
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.layout != layout({Plain, structures}) || header.length != length - sizeof(Header)
+        || header.crc != crc32(0, data, header.length))
+    {
+        Alert(std::vector<std::string> (1,"The snapshot " + path + " is damaged or from another version, it is ignored"),"error");
+        return -1;
+    }
+    memory = data;
+    size = header.length;
+    offset = 0;
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef snapshot_h
+#define snapshot_h
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <initializer_list>
+
+// Tag of the sizes of the structures a snapshot holds, a build where one of them differs can't
+// read the snapshots of another one (snapshot.cpp)
+uint32_t layout(std::initializer_list<size_t> sizes);
+
+// Image of the state of the analyses being written: values are appended to a buffer in the memory
+// layout of this build, then save() writes it after a header with its length and CRC.
+class SnapshotWriter
+{
+public:
+    template <typename T> void put(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be saved");
+        put(&value, sizeof(T));
+    }
+    template <typename T> void put(const std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be saved");
+        put(static_cast<uint64_t>(values.size()));
+        put(values.data(), values.size()*sizeof(T));
+    }
+    void put(const void* data, size_t bytes)
+    {
+        if (bytes > 0)
+        {
+            buffer.append(static_cast<const char*>(data), bytes);
+        }
+    }
+    int save(const std::string &path, uint32_t structures) const;
+    size_t size() const { return buffer.size(); }
+
+private:
+    std::string buffer;
+};
+
+// Snapshot mapped in memory and read in the order it was written. Every get() fails once the end
+// is passed, so a file cut short or from another layout is refused instead of read.
+class SnapshotReader
+{
+public:
+    ~SnapshotReader();
+    int open(const std::string &path, uint32_t structures);
+    template <typename T> bool get(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be restored");
+        return get(&value, sizeof(T));
+    }
+    template <typename T> bool get(std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be restored");
+        uint64_t count;
+        if (!get(count) || count > (size - offset)/sizeof(T))
+        {
+            return false;
+        }
+        values.resize(count);
+        return get(values.data(), count*sizeof(T));
+    }
+    bool get(void* data, size_t bytes)
+    {
+        if (bytes > size - offset)
+        {
+            offset = size;
+            return false;
+        }
+        if (bytes == 0)
+        {
+            return true;
+        }
+        std::memcpy(data, memory + offset, bytes);
+        offset += bytes;
+        return true;
+    }
+    bool done() const { return offset == size; }
+
+private:
+    void* mapping = nullptr;
+    size_t length = 0;                // of the mapping, header included
+    const unsigned char* memory = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+};
+
+#endif
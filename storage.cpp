@@ -0,0 +1,51 @@
+/** ========================================================================================
+
+    Filename:  storage.cpp
+
+    Description:  Backends of the price history behind the writer of the pipeline. SQLite keeps
+                  every price as a row of Prices (default); the journal (journal.cpp) appends
+                  them to a compact binary file per currency instead.
+
+                  Setting: "storage", "sqlite" or "journal" (default sqlite).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "storage.h"
+#include "pipeline.h"
+
+// Nothing to add, PriceStore::load() already read the Prices table
+int Storage::replay(int, double, PriceRing &)
+{
+    return 0;
+}
+
+int SqliteStorage::open(const char* database)
+{
+    return db.open(database);
+}
+
+// Every price of the batch in one transaction, nothing is kept if one of them fails
+int SqliteStorage::append(const PriceBatch &batch)
+{
+    if (db.begin() != 0)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < batch.ids.size(); i++)
+    {
+        if (db.insert(batch.ids[i],batch.times[i],batch.prices[i]) != 0)
+        {
+            db.rollback();
+            return -1;
+        }
+    }
+    return db.commit();
+}
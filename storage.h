@@ -0,0 +1,31 @@
+#ifndef storage_h
+#define storage_h
+#include "persistence.h"
+
+struct PriceBatch;
+class PriceRing;
+
+// Where the history of the prices is kept. The writer thread of the pipeline opens it and appends
+// every batch; at startup, once PriceStore::load() read Crypto.db, replay() adds the prices
+// the backend holds. The tables of the configuration always stay in Crypto.db.
+class Storage
+{
+public:
+    virtual ~Storage() {}
+    virtual int open(const char* database) = 0;
+    virtual int append(const PriceBatch &batch) = 0;
+    virtual int replay(int id, double since, PriceRing &ring);
+};
+
+// Prices table of Crypto.db, one transaction per batch
+class SqliteStorage : public Storage
+{
+public:
+    int open(const char* database) override;
+    int append(const PriceBatch &batch) override;
+
+private:
+    Persistence db;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/** ========================================================================================
+
+    Filename:  trace.cpp
+
+    Description:  Spans of the hot path, to tell where a slow refresh spent its time: the
+                  API calls (curl and parsing), update(), the writes of the prices, the
+                  analyses and each of their tasks, the correlations, the snapshots, the alert
+                  dispatcher and SMTP, and the compaction. A Trace at the top of a scope reads
+                  the clock twice and writes one event to the buffer of its thread, which only
+                  that thread touches; with tracing off it only loads a flag.
+
+                  Each thread keeps its last "traceEvents" spans in a ring, and the duration of
+                  every span in a histogram with 8 buckets per power of 2 (at most 6.25% off).
+                  When the program stops the spans kept are written as Chrome trace events
+                  (chrome://tracing or ui.perfetto.dev) and the p50/p99/max of every stage go to
+                  the log. The times are CLOCK_MONOTONIC like "perf record -k CLOCK_MONOTONIC",
+                  and the threads are named with pthread_setname_np, so the trace lines up with
+                  the samples and thread names of perf.
+
+                  Settings: "trace" (1 traces from the start, default 0, the GUI socket turns
+                  it on and off with "trace on|off"), "traceFile" (default trace.json, empty
+                  writes none) and "traceEvents" (spans kept per thread, default 65536).
+
+    Version:  1.0 Changes:
+    Created:  10/18/2026
+    Revision:  10/18/2026
+    Compiler:  g++
+    Author:  Covariant Joe
+
+    ========================================================================================
+*/
+
+#include "headers.h"
+#include "trace.h"
+#include "persistence.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cmath>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+Tracer tracer;
+
+static const char* StageNames[Stages] = {"api", "fetch", "history", "update", "write", "analyse", "task", "correlate", "snapshot", "dispatch", "smtp", "compact"};
+
+// Histogram bucket of a duration: the exponent and the next 3 bits of the mantissa
+int Tracer::bucket(uint64_t nanoseconds)
+{
+    if (nanoseconds < 8)
+    {
+        return static_cast<int>(nanoseconds);
+    }
+    int exponent = 63 - __builtin_clzll(nanoseconds);
+    return std::min(TraceBuffer::Buckets - 1, 8*(exponent - 2) + static_cast<int>((nanoseconds >> (exponent - 3)) & 7));
+}
+
+// Middle of a bucket, in nanoseconds
+double Tracer::value(int bucket)
+{
+    if (bucket < 8)
+    {
+        return bucket;
+    }
+    double width = std::ldexp(1.0, bucket/8 - 1);
+    return (8 + bucket%8)*width + width/2;
+}
+
+void Tracer::configure(Persistence &db)
+{
+    path = db.setting("traceFile", path);
+    try
+    {
+        long events = std::stol(db.setting("traceEvents", "65536"));
+        if (events < 1)
+        {
+            throw std::invalid_argument("traceEvents");
+        }
+        capacity = 1;
+        while (capacity < static_cast<size_t>(events))
+        {
+            capacity *= 2;
+        }
+    }
+    catch (const std::exception &)
+    {
+        Alert(std::vector<std::string> (1,"Invalid traceEvents setting, using 65536"), "error");
+        capacity = 65536;
+    }
+    enable(db.setting("trace", "0") == "1");
+}
+
+// Buffer of the current thread, registered the first time the thread names itself or records
+TraceBuffer& Tracer::buffer()
+{
+    static thread_local TraceBuffer* mine = nullptr;
+    if (mine == nullptr)
+    {
+        std::unique_ptr<TraceBuffer> created(new TraceBuffer);
+        created->tid = static_cast<long>(syscall(SYS_gettid));
+        created->name = created->tid == getpid() ? "main" : "thread " + std::to_string(created->tid);
+        mine = created.get();
+        std::lock_guard<std::mutex> lock(registry);
+        buffers.push_back(std::move(created));
+    }
+    return *mine;
+}
+
+// Name of the current thread in the trace and in perf, top and ps (15 characters at most)
+void Tracer::name(const char* thread)
+{
+    buffer().name = thread;
+    pthread_setname_np(pthread_self(), thread);
+}
+
+void Tracer::record(Stage stage, uint64_t begin, uint64_t end)
+{
+    TraceBuffer &mine = buffer();
+    if (mine.events.empty())
+    {
+        mine.events.resize(capacity);
+    }
+    uint64_t head = mine.head.load(std::memory_order_relaxed);
+    mine.events[head & (mine.events.size() - 1)] = {begin, end, stage};
+    mine.head.store(head + 1, std::memory_order_release);
+    mine.counts[stage][bucket(end - begin)]++;
+    mine.longest[stage] = std::max(mine.longest[stage], end - begin);
+}
+
+// p50/p99/max in milliseconds and count of every stage that was traced, "" if none was. Only
+// called once the threads that trace are done.
+std::string Tracer::summary() const
+{
+    std::string text;
+    char line[128];
+    std::lock_guard<std::mutex> lock(registry);
+    for (int stage = 0; stage < Stages; stage++)
+    {
+        std::vector<uint64_t> counts(TraceBuffer::Buckets, 0);
+        uint64_t total = 0, longest = 0;
+        for (const std::unique_ptr<TraceBuffer> &buffer : buffers)
+        {
+            for (int b = 0; b < TraceBuffer::Buckets; b++)
+            {
+                counts[b] += buffer->counts[stage][b];
+                total += buffer->counts[stage][b];
+            }
+            longest = std::max(longest, buffer->longest[stage]);
+        }
+        if (total == 0)
+        {
+            continue;
+        }
+        double quantiles[2] = {0.5, 0.99}, values[2] = {0, 0};
+        for (int q = 0; q < 2; q++)
+        {
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantiles[q]*total))), seen = 0;
+            int b = 0;
+            while ((seen += counts[b]) < rank)
+            {
+                b++;
+            }
+            values[q] = std::min(value(b), static_cast<double>(longest));
+        }
+        std::snprintf(line, sizeof(line), " %s %.3f/%.3f/%.3f (%llu)", StageNames[stage], values[0]/1e6, values[1]/1e6, longest/1e6, static_cast<unsigned long long>(total));
+        text += line;
+    }
+    return text.empty() ? text : "Trace spans (p50/p99/max ms, count):" + text;
+}
+
+// Chrome trace events of the spans kept by every thread. Returns 0 or -1 with errors.
+int Tracer::write(const std::string &file) const
+{
+    std::FILE* out = std::fopen(file.c_str(), "w");
+    if (out == nullptr)
+    {
+        Alert(std::vector<std::string> (1,"Couldn't write the trace to " + file),"error");
+        return -1;
+    }
+    long pid = static_cast<long>(getpid());
+    std::lock_guard<std::mutex> lock(registry);
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"CryptoAnalysis\"}}", pid, pid);
+    for (const std::unique_ptr<TraceBuffer> &buffer : buffers)
+    {
+        std::fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}", pid, buffer->tid, buffer->name.c_str());
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > buffer->events.size() ? head - buffer->events.size() : 0;
+        for (uint64_t i = first; i < head; i++)
+        {
+            const TraceEvent &event = buffer->events[i & (buffer->events.size() - 1)];
+            std::fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"crypto\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}", StageNames[event.stage], pid,
+                         buffer->tid, event.begin/1e3, (event.end - event.begin)/1e3);
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    if (std::fclose(out) != 0)
+    {
+        Alert(std::vector<std::string> (1,"Couldn't write the trace to " + file),"error");
+        return -1;
+    }
+    return 0;
+}
+
+// Stop tracing, write the trace file and log the summary, if anything was traced. Called when the
+// threads that trace have stopped.
+void Tracer::stop()
+{
+    enable(false);
+    std::string text = summary();
+    if (text.empty())
+    {
+        return;
+    }
+    if (!path.empty() && write(path) == 0)
+    {
+        text += ". Written to " + path;
+    }
+    Alert(std::vector<std::string> (1,text),"local");
+}
@@ -0,0 +1,94 @@
+#ifndef trace_h
+#define trace_h
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+
+class Persistence;
+
+// Stages of a refresh timed by the spans, by the names of StageNames in trace.cpp
+enum Stage { Api, Fetch, History, Update, Write, Analyse, Task, Correlate, Snapshot, Dispatch, Smtp, Compact, Stages };
+
+// One span, in nanoseconds of CLOCK_MONOTONIC
+struct TraceEvent
+{
+    uint64_t begin;
+    uint64_t end;
+    int stage;
+};
+
+// Spans of one thread: the last ones in a ring for the trace file, and the durations of all of
+// them in a log scale histogram for the summary. Only its thread writes to it.
+struct TraceBuffer
+{
+    static constexpr int Buckets = 344;    // 8 per power of 2 up to 2^44 ns, about 5 hours
+
+    long tid = 0;
+    std::string name;
+    std::vector<TraceEvent> events;        // allocated with the first span
+    std::atomic<uint64_t> head{0};         // spans written, the ring keeps the last events.size()
+    uint64_t counts[Stages][Buckets] = {};
+    uint64_t longest[Stages] = {};
+};
+
+// Scoped spans written to per thread buffers without locks. When tracing is off a span costs one
+// relaxed load. stop() writes the spans kept as a Chrome trace (chrome://tracing, Perfetto) and
+// logs the p50/p99 of every stage.
+class Tracer
+{
+public:
+    static uint64_t now()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec)*1000000000 + time.tv_nsec;
+    }
+    static int bucket(uint64_t nanoseconds);
+    static double value(int bucket);
+
+    void configure(Persistence &db);
+    void enable(bool enabled) { on.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+    void name(const char* thread);
+    void record(Stage stage, uint64_t begin, uint64_t end);
+    std::string summary() const;
+    int write(const std::string &path) const;
+    void stop();
+
+private:
+    TraceBuffer& buffer();
+
+    std::atomic<bool> on{false};
+    mutable std::mutex registry;           // buffers
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    size_t capacity = 65536;               // spans kept per thread
+    std::string path = "trace.json";
+};
+
+extern Tracer tracer;
+
+// Times the scope it lives in as a span of "stage", if tracing was on when it began
+class Trace
+{
+public:
+    explicit Trace(Stage stage) : stage(stage), begin(tracer.enabled() ? Tracer::now() : 0) {}
+    ~Trace()
+    {
+        if (begin != 0)
+        {
+            tracer.record(stage, begin, Tracer::now());
+        }
+    }
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+private:
+    Stage stage;
+    uint64_t begin;
+};
+
+#endif